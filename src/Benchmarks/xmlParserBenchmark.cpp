@@ -0,0 +1,123 @@
+// *************************************************************************************************
+//
+// Horde3D Physics
+//
+// XML Parser Benchmark
+// --------------------------------------
+//
+// Compares the heap, arena and in situ modes of utXMLParser on a scene file. The benchmark is not
+// part of the solution, build it from this directory with
+//
+//   g++ -O2 -std=c++11 -I../Horde3DPhysics xmlParserBenchmark.cpp ../Horde3DPhysics/utXMLParser.cpp
+//
+// and run it with the scene file and the number of iterations, e.g.
+//
+//   ./a.out ../../bin/content/models/Domino.scene.xml 2000
+//
+// This source file is not covered by the LGPL as the rest of the SDK and may be used without any
+// restrictions
+//
+// *************************************************************************************************
+
+#include "utXMLParser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	enum Mode { Heap, Arena, InSitu, NumModes };
+	const char* modeNames[NumModes] = { "malloc", "arena", "in situ" };
+
+	bool readFile(const char* fileName, string& content)
+	{
+		FILE* file = fopen(fileName, "rb");
+		if (!file)
+			return false;
+		fseek(file, 0, SEEK_END);
+		const long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		content.resize(size > 0 ? size : 0);
+		const bool read = size <= 0 || fread(&content[0], 1, size, file) == (size_t) size;
+		fclose(file);
+		return read;
+	}
+
+	/// The in situ parser modifies its input, so it gets a fresh copy for every document
+	XMLNode parse(Mode mode, const string& source, vector<char>& buffer, XMLResults* results = 0)
+	{
+		switch (mode)
+		{
+		case Arena:
+			return XMLNode::parseStringArena(source.c_str(), 0, results);
+		case InSitu:
+			buffer.assign(source.begin(), source.end());
+			buffer.push_back(0);
+			return XMLNode::parseStringInSitu(&buffer[0], 0, results);
+		default:
+			return XMLNode::parseString(source.c_str(), 0, results);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s <file.xml> [iterations]\n", argv[0]);
+		return 1;
+	}
+	string source;
+	if (!readFile(argv[1], source))
+	{
+		printf("Couldn't read %s\n", argv[1]);
+		return 1;
+	}
+	const int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+
+	// all modes have to produce the same document before their timings mean anything
+	vector<char> buffer;
+	char* reference = 0;
+	for (int mode = 0; mode < NumModes; ++mode)
+	{
+		XMLResults results;
+		XMLNode document = parse(static_cast<Mode>(mode), source, buffer, &results);
+		if (results.error != eXMLErrorNone)
+		{
+			printf("%s: %s at line %d\n", modeNames[mode], XMLNode::getError(results.error), results.nLine);
+			return 1;
+		}
+		char* xml = document.createXMLString();
+		if (!reference)
+			reference = xml;
+		else
+		{
+			const bool equal = strcmp(reference, xml) == 0;
+			free(xml);
+			if (!equal)
+			{
+				printf("%s: parsed document differs from the malloc mode\n", modeNames[mode]);
+				free(reference);
+				return 1;
+			}
+		}
+	}
+	free(reference);
+
+	printf("%s, %d bytes, %d iterations\n", argv[1], (int) source.size(), iterations);
+	for (int mode = 0; mode < NumModes; ++mode)
+	{
+		const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i)
+			parse(static_cast<Mode>(mode), source, buffer);
+		const double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+		printf("%-8s %10.2f us per document\n", modeNames[mode], us / (iterations > 0 ? iterations : 1));
+	}
+	return 0;
+}
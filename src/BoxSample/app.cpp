@@ -83,7 +83,7 @@ bool Application::init()
 	H3DNode sky = h3dAddNodes( H3DRootNode, skyBoxRes );
 	h3dSetNodeTransform( sky, 0, 0, 0, 0, 0, 0, 500, 500, 500 );
 	// Add pyhsics demo
-	h3dAddNodes( H3DRootNode, physicsDemoRes );
+	H3DNode physicsDemo = h3dAddNodes( H3DRootNode, physicsDemoRes );
 	// Add light source
 	H3DNode light = h3dAddLightNode( H3DRootNode, "Light1", 0, "LIGHTING", "SHADOWMAP" );
 	h3dSetNodeTransform( light, 0, 90, -25, -120, 0, 0, 1, 1, 1 );
@@ -107,12 +107,12 @@ bool Application::init()
 	h3dSetNodeParamF( light, H3DLight::ColorF3, 1, 0.7f );
 	h3dSetNodeParamF( light, H3DLight::ColorF3, 2, 0.75f );
 	
-	// Init attachments
-	int nodes = h3dFindNodes( H3DRootNode, "", H3DNodeTypes::Undefined );
-	for (int i = 0; i < nodes; ++i)
+	// Init attachments from the baked physics blob, bake it if it is missing or out of date
+	const string physicsBlob = _content + "/models/domino.physics";
+	if( !Horde3DPhysics::loadPhysicsNodes( physicsDemo, physicsBlob.c_str() ) )
 	{
-		H3DNode node = h3dGetNodeFindResult(i);
-		Horde3DPhysics::createPhysicsNode( h3dGetNodeParamStr(node, 2), node );
+		Horde3DPhysics::createPhysicsNodes( physicsDemo );
+		Horde3DPhysics::bakePhysicsNodes( physicsDemo, physicsBlob.c_str() );
 	}
 
 	return true;
@@ -29,9 +29,9 @@
 namespace Horde3DPhysics
 {
 
-	HORDEPHYSICS_API void initPhysics()
+	HORDEPHYSICS_API void initPhysics( ITaskScheduler* scheduler )
 	{
-		Physics::instance();
+		Physics::instance()->setScheduler( scheduler );
 	}
 
 	HORDEPHYSICS_API void releasePhysics()
@@ -51,11 +51,243 @@ namespace Horde3DPhysics
 
 	HORDEPHYSICS_API void createPhysicsNode( const char* xmlData, int hordeID )
 	{
-		Physics::createPhysicsNode( hordeID, xmlData );
+		Physics* physics = Physics::instance();
+		if( physics->isOwnerThread() )
+			Physics::createPhysicsNode( hordeID, xmlData );
+		else
+		{
+			PhysicsCommand* command = new PhysicsCommand( PhysicsCommand::CreateNode, hordeID );
+			command->xmlText = xmlData ? xmlData : "";
+			physics->submitCommand( command );
+		}
+	}
+
+	HORDEPHYSICS_API void createPhysicsNodes( int rootID )
+	{
+		Physics::instance()->submitCommand( new PhysicsCommand( PhysicsCommand::CreateNodes, rootID ) );
+	}
+
+	HORDEPHYSICS_API bool bakePhysicsNodes( int rootID, const char* fileName )
+	{
+		return Physics::bakePhysicsNodes( rootID, fileName );
+	}
+
+	HORDEPHYSICS_API bool loadPhysicsNodes( int rootID, const char* fileName )
+	{
+		return Physics::loadPhysicsNodes( rootID, fileName );
 	}
 
 	HORDEPHYSICS_API void removePhysicsNode( int hordeID )
 	{
-		Physics::removePhysicsNode( hordeID );
+		Physics::instance()->submitCommand( new PhysicsCommand( PhysicsCommand::RemoveNode, hordeID ) );
+	}
+
+	HORDEPHYSICS_API void applyImpulse( int hordeID, float x, float y, float z, float relX, float relY, float relZ )
+	{
+		PhysicsCommand* command = new PhysicsCommand( PhysicsCommand::ApplyImpulse, hordeID );
+		command->values[0] = x; command->values[1] = y; command->values[2] = z;
+		command->values[3] = relX; command->values[4] = relY; command->values[5] = relZ;
+		Physics::instance()->submitCommand( command );
+	}
+
+	HORDEPHYSICS_API void teleportPhysicsNode( int hordeID, const float* transformation )
+	{
+		PhysicsCommand* command = new PhysicsCommand( PhysicsCommand::Teleport, hordeID );
+		memcpy( command->values, transformation, sizeof( command->values ) );
+		Physics::instance()->submitCommand( command );
+	}
+
+	HORDEPHYSICS_API void setAsyncCooking( bool enable )
+	{
+		Physics::instance()->setAsyncCooking( enable );
+	}
+
+	HORDEPHYSICS_API float getCookingProgress()
+	{
+		return Physics::instance()->cookingProgress();
+	}
+
+	HORDEPHYSICS_API void setParallelSimulation( bool enable )
+	{
+		Physics::instance()->setParallelSimulation( enable );
+	}
+
+	HORDEPHYSICS_API void setSimulationLOD( float nearDistance, float farDistance, int midInterval )
+	{
+		Physics::instance()->setSimulationLOD( nearDistance, farDistance, midInterval );
+	}
+
+	HORDEPHYSICS_API void setLODViewpoint( float x, float y, float z )
+	{
+		Physics::instance()->setLODViewpoint( x, y, z );
+	}
+
+	HORDEPHYSICS_API void setWorldPartition( float cellSize, int activeCells, int loadedCells )
+	{
+		Physics::instance()->setWorldPartition( cellSize, activeCells, loadedCells );
+	}
+
+	HORDEPHYSICS_API void setPartitionFocus( float x, float /*y*/, float z )
+	{
+		// the partition cells span the whole height, only the XZ position selects a cell
+		Physics::instance()->setPartitionFocus( x, z );
+	}
+
+	HORDEPHYSICS_API int getEvictedBodyCount()
+	{
+		return Physics::instance()->numEvictedBodies();
+	}
+
+	HORDEPHYSICS_API void shiftOrigin( float x, float y, float z )
+	{
+		Physics::instance()->shiftOrigin( x, y, z );
+	}
+
+	HORDEPHYSICS_API void setOriginShiftThreshold( float distance )
+	{
+		Physics::instance()->setOriginShiftThreshold( distance );
+	}
+
+	HORDEPHYSICS_API void setOriginFocus( float x, float y, float z )
+	{
+		Physics::instance()->setOriginFocus( x, y, z );
+	}
+
+	HORDEPHYSICS_API void getOriginOffset( double* x, double* y, double* z )
+	{
+		Physics::instance()->originOffset( x, y, z );
+	}
+
+	HORDEPHYSICS_API void setVisibilityCamera( int cameraID )
+	{
+		Physics::instance()->setVisibilityCamera( cameraID );
+	}
+
+	HORDEPHYSICS_API void flushTransforms()
+	{
+		Physics::instance()->flushTransforms();
+	}
+
+	HORDEPHYSICS_API void flushTransform( int hordeID )
+	{
+		PhysicsNode* node = Physics::instance()->findNode( hordeID );
+		if( node ) node->flush();
+	}
+
+	HORDEPHYSICS_API void setSceneSync( bool enable )
+	{
+		Physics::instance()->setSceneSync( enable );
+	}
+
+	HORDEPHYSICS_API void setPoseExport( bool enable )
+	{
+		Physics::instance()->setPoseExport( enable );
+	}
+
+	HORDEPHYSICS_API const PhysicsPose* getPhysicsPoses( int* count )
+	{
+		return Physics::instance()->poses( *count );
+	}
+
+	HORDEPHYSICS_API const TriggerEvent* getTriggerEvents( int* count )
+	{
+		return Physics::instance()->triggerEvents( *count );
+	}
+
+	HORDEPHYSICS_API void setTriggerEventCapacity( int capacity )
+	{
+		Physics::instance()->setTriggerEventCapacity( capacity );
+	}
+
+	HORDEPHYSICS_API int defineCollisionLayer( const char* name )
+	{
+		return (unsigned short) CollisionLayers::define( name );
+	}
+
+	HORDEPHYSICS_API void setOverlapFilter( OverlapFilter filter, void* userData )
+	{
+		Physics::instance()->setOverlapFilter( filter, userData );
+	}
+
+	HORDEPHYSICS_API void setDebugDraw( int cameraID, int categories, int materialRes, int maxLines )
+	{
+		Physics::instance()->setDebugDraw( cameraID, categories, materialRes, maxLines );
+	}
+
+	HORDEPHYSICS_API int getDebugDrawSkippedLines()
+	{
+		return Physics::instance()->debugDrawSkippedLines();
+	}
+
+	HORDEPHYSICS_API void setSceneWrites( bool enable )
+	{
+		Physics::instance()->setSceneWrites( enable );
+	}
+
+	HORDEPHYSICS_API void setQuerySnapshots( bool enable )
+	{
+		Physics::instance()->setQuerySnapshots( enable );
+	}
+
+	HORDEPHYSICS_API int castRay( const float* from, const float* to, float* hitPoint, float* hitNormal )
+	{
+		std::shared_ptr<const WorldSnapshot> snapshot = Physics::instance()->snapshot();
+		return snapshot ? snapshot->castRay( from, to, hitPoint, hitNormal ) : 0;
+	}
+
+	HORDEPHYSICS_API int queryAabb( const float* aabbMin, const float* aabbMax, int* hordeIDs, int maxIDs )
+	{
+		std::shared_ptr<const WorldSnapshot> snapshot = Physics::instance()->snapshot();
+		return snapshot ? snapshot->queryAabb( aabbMin, aabbMax, hordeIDs, maxIDs ) : 0;
+	}
+
+	HORDEPHYSICS_API void createCharacter( int hordeID, float radius, float height, float stepHeight )
+	{
+		PhysicsCommand* command = new PhysicsCommand( PhysicsCommand::CreateCharacter, hordeID );
+		command->values[0] = radius; command->values[1] = height; command->values[2] = stepHeight;
+		Physics::instance()->submitCommand( command );
+	}
+
+	HORDEPHYSICS_API void removeCharacter( int hordeID )
+	{
+		Physics::instance()->submitCommand( new PhysicsCommand( PhysicsCommand::RemoveCharacter, hordeID ) );
+	}
+
+	HORDEPHYSICS_API void setCharacterVelocity( int hordeID, float x, float y, float z )
+	{
+		PhysicsCommand* command = new PhysicsCommand( PhysicsCommand::MoveCharacter, hordeID );
+		command->values[0] = x; command->values[1] = y; command->values[2] = z;
+		Physics::instance()->submitCommand( command );
+	}
+
+	HORDEPHYSICS_API void setCharacterVelocities( const int* hordeIDs, const float* velocities, int count )
+	{
+		Physics* physics = Physics::instance();
+		for( int i = 0; i < count; ++i )
+		{
+			const float* velocity = velocities + i * 3;
+			if( !physics->isOwnerThread() )
+				setCharacterVelocity( hordeIDs[i], velocity[0], velocity[1], velocity[2] );
+			else if( Character* character = physics->character( hordeIDs[i] ) )
+				character->setVelocity( btVector3( velocity[0], velocity[1], velocity[2] ) );
+		}
+	}
+
+	HORDEPHYSICS_API void jumpCharacter( int hordeID )
+	{
+		Physics::instance()->submitCommand( new PhysicsCommand( PhysicsCommand::JumpCharacter, hordeID ) );
+	}
+
+	HORDEPHYSICS_API bool isCharacterOnGround( int hordeID )
+	{
+		Character* character = Physics::instance()->character( hordeID );
+		return character && character->controller()->onGround();
+	}
+
+	HORDEPHYSICS_API void setVehicleControls( int hordeID, float engineForce, float brake, float steering )
+	{
+		PhysicsCommand* command = new PhysicsCommand( PhysicsCommand::VehicleControls, hordeID );
+		command->values[0] = engineForce; command->values[1] = brake; command->values[2] = steering;
+		Physics::instance()->submitCommand( command );
 	}
 }
\ No newline at end of file
@@ -22,6 +22,8 @@
 //
 // *************************************************************************************************
 
+#pragma once
+
 #ifdef HORDEPHYSICS_EXPORTS
 #define HORDEPHYSICS_API extern "C" __declspec(dllexport)
 #else
@@ -33,10 +35,106 @@
  */
 namespace Horde3DPhysics
 {
+	/**
+	 * \brief Interface to a job system running the parallel work of the physics integration
+	 *
+	 * Cooking, the simulation step and the transformation sync run through the scheduler passed to 
+	 * initPhysics, so an engine can share its own worker threads with the physics. The implementation 
+	 * has to stay alive until releasePhysics has been called.
+	 */
+	class ITaskScheduler
+	{
+	public:
+		/// Function executed by submit
+		typedef void (*TaskFunction)( void* data );
+		/// Function executed by parallelFor for the indices [begin, end)
+		typedef void (*RangeFunction)( int begin, int end, int threadIndex, void* data );
+
+		virtual ~ITaskScheduler() {}
+
+		/**
+		 * Returns the number of different values threadIndex() may return
+		 */
+		virtual int numThreadIndices() const = 0;
+
+		/**
+		 * Returns a value between 0 and numThreadIndices() - 1 that is unique among all threads executing
+		 * tasks at the same time, including threads calling parallelFor
+		 */
+		virtual int threadIndex() const = 0;
+
+		/**
+		 * Executes the function asynchronously on a worker thread
+		 */
+		virtual void submit( TaskFunction function, void* data ) = 0;
+
+		/**
+		 * Splits the indices [0, count) into ranges of at most grainSize indices and executes the function 
+		 * for all of them in parallel, passing threadIndex() of the executing thread. Returns after all 
+		 * ranges have been processed
+		 */
+		virtual void parallelFor( int count, int grainSize, RangeFunction function, void* data ) = 0;
+	};
+
+	/**
+	 * \brief Pose of a rigid body exported by updatePhysics
+	 */
+	struct PhysicsPose
+	{
+		/// Id of the Horde3D node the body belongs to
+		int		hordeID;
+		/// Position of the body in world space
+		float	position[3];
+		/// Rotation of the body as quaternion (x, y, z, w)
+		float	rotation[4];
+	};
+
+	/**
+	 * \brief Node entering or leaving a trigger volume, reported by updatePhysics
+	 */
+	struct TriggerEvent
+	{
+		/// Id of the Horde3D node with the trigger attachment
+		int		trigger;
+		/// Id of the Horde3D node whose body, ragdoll or character overlaps the trigger
+		int		other;
+		/// true if the overlap has begun, false if it has ended
+		bool	entered;
+	};
+
+	/**
+	 * \brief Parts of the physics world shown by the debug view
+	 */
+	struct DebugDrawCategories
+	{
+		enum List
+		{
+			/// Wireframes of all collision shapes, white if active, green if sleeping, vehicles and characters
+			Shapes = 1,
+			/// Bounding boxes of all collision objects
+			Aabbs = 2,
+			/// Contact points and their normals
+			Contacts = 4,
+			/// Frames and limits of the constraints
+			Constraints = 8
+		};
+	};
+
+	/**
+	 * Decides if two objects whose collision filters match may collide, called by updatePhysics on the thread
+	 * that called initPhysics when the bounding boxes of the objects begin to overlap
+	 * @param hordeID0 the node of the first object, 0 for objects that don't belong to a node
+	 * @param hordeID1 the node of the second object
+	 * @param userData the value passed to setOverlapFilter
+	 * @return false to skip the pair
+	 */
+	typedef bool (*OverlapFilter)( int hordeID0, int hordeID1, void* userData );
+
 	/**
 	 * initializes the physics world
+	 * @param scheduler job system used for all parallel work, 0 uses a built-in work stealing thread pool
 	 */
-	HORDEPHYSICS_API void initPhysics();
+	HORDEPHYSICS_API void initPhysics( ITaskScheduler* scheduler = 0 );
 	/**
 	 * releases the physics instance (delete from memory)
 	 */
@@ -51,11 +149,248 @@ namespace Horde3DPhysics
 	HORDEPHYSICS_API void reset();
 	/** 
 	 * Creates a new PhysicsNode based on the data provided to this function
+	 * May be called from any thread: calls from other threads than the one that called initPhysics are 
+	 * queued and executed at the beginning of the next updatePhysics call.
+	 * Constraint elements of the attachment are created by the next updatePhysics call, so their target
+	 * nodes may be created after this node. The targets are searched by name below the closest ancestor
+	 * containing such a node. A Vehicle element turns a dynamic body into the chassis of a raycast vehicle, 
+	 * its Wheel elements name the wheel nodes below the chassis node. The function doesn't use h3dFindNodes,
+	 * so it may be called while iterating over the results of a search
 	 */
 	HORDEPHYSICS_API void createPhysicsNode( const char* xmlData, int hordeID );
+	/**
+	 * Creates the PhysicsNodes for all nodes with a physics attachment below and including the given node
+	 * in one batch (shared primitive shapes, single sorted broadphase insertion)
+	 * May be called from any thread like createPhysicsNode
+	 */
+	HORDEPHYSICS_API void createPhysicsNodes( int rootID );
+	/**
+	 * Compiles the physics attachments below and including the given node into a versioned binary blob.
+	 * Attachments are validated while baking, invalid ones are reported and make the function return false
+	 */
+	HORDEPHYSICS_API bool bakePhysicsNodes( int rootID, const char* fileName );
+	/**
+	 * Same as createPhysicsNodes, but reads the attachments from a memory mapped blob written by
+	 * bakePhysicsNodes instead of parsing them. Returns false without creating any node if the blob
+	 * can't be loaded, doesn't match the scene or any attachment string has changed since baking
+	 */
+	HORDEPHYSICS_API bool loadPhysicsNodes( int rootID, const char* fileName );
 	/**
 	 * Removes a physics node
+	 * May be called from any thread like createPhysicsNode
 	 */
 	HORDEPHYSICS_API void removePhysicsNode( int hordeID );
+	/**
+	 * Applies an impulse to the rigid body of a physics node, the relative position is the point of application
+	 * relative to the center of mass. May be called from any thread like createPhysicsNode
+	 */
+	HORDEPHYSICS_API void applyImpulse( int hordeID, float x, float y, float z, float relX = 0, float relY = 0, float relZ = 0 );
+	/**
+	 * Moves the rigid body of a physics node to the given absolute transformation (16 floats, the scale
+	 * is ignored) keeping its velocities. May be called from any thread like createPhysicsNode
+	 */
+	HORDEPHYSICS_API void teleportPhysicsNode( int hordeID, const float* transformation );
+	/**
+	 * Enables cooking of collision meshes on the task scheduler. Nodes created afterwards are registered
+	 * immediately, their rigid bodies are added to the world by the first updatePhysics call after cooking
+	 */
+	HORDEPHYSICS_API void setAsyncCooking( bool enable );
+	/**
+	 * Returns the cooking progress between 0 and 1 of all nodes created since cooking was last idle
+	 */
+	HORDEPHYSICS_API float getCookingProgress();
+	/**
+	 * Runs the narrowphase, the island solver and the transformation sync on the task scheduler. Bullet's profiler
+	 * is not thread safe, so the narrowphase and the solver stay serial unless the library is built with the
+	 * HORDEPHYSICS_BULLET_NO_PROFILE option against Bullet libraries built with BT_NO_PROFILE. The Bullet libraries
+	 * of the SDK are built with the profiler, with them only the transformation sync and the triggers run in parallel
+	 */
+	HORDEPHYSICS_API void setParallelSimulation( bool enable );
+	/**
+	 * Enables the distance based simulation LOD. Dynamic bodies within nearDistance of the LOD viewpoint are
+	 * simulated every step, bodies within farDistance every midInterval-th step with extrapolated transformations
+	 * in between, bodies further away are frozen. A farDistance of 0 disables the LOD
+	 */
+	HORDEPHYSICS_API void setSimulationLOD( float nearDistance, float farDistance, int midInterval );
+	/**
+	 * Sets the position the simulation LOD distances are measured from, usually the camera position
+	 */
+	HORDEPHYSICS_API void setLODViewpoint( float x, float y, float z );
+	/**
+	 * Divides the XZ plane into cells of cellSize around the partition focus. Rigid bodies within activeCells 
+	 * cells of the focus cell are simulated, bodies within loadedCells are put to sleep and the bodies of all 
+	 * other cells are evicted: their transformations and velocities are stored in a buffer of their cell and 
+	 * their physics nodes are deleted. Once the focus comes close again, the nodes are recreated from their
+	 * attachments and continue with the stored state. Ragdolls, characters and triggers are not affected. 
+	 * Constraints are removed with either of their bodies and created again in the current pose once both 
+	 * bodies are loaded, no matter which of the two attachments defines them. A cellSize of 0 restores all 
+	 * evicted bodies. Has to be called by the thread that called initPhysics
+	 */
+	HORDEPHYSICS_API void setWorldPartition( float cellSize, int activeCells, int loadedCells );
+	/**
+	 * Sets the position the partition cells are loaded around, usually the player position. The cells are
+	 * updated by the next updatePhysics call after the focus has entered another cell. The cells form a grid
+	 * in the XZ plane, y is ignored. Has to be called by the thread that called initPhysics
+	 */
+	HORDEPHYSICS_API void setPartitionFocus( float x, float y, float z );
+	/**
+	 * Returns the number of bodies evicted by the world partition
+	 */
+	HORDEPHYSICS_API int getEvictedBodyCount();
+	/**
+	 * Moves the origin of the world to the given position, keeping Bullet's single precision and the fixed 
+	 * broadphase bounds accurate around it. With the next updatePhysics call all bodies, broadphase proxies 
+	 * and cached positions are translated in one pass and the Horde3D root node is moved by the same offset 
+	 * on top of its own transformation, so the local transformations of the scene nodes stay unchanged. 
+	 * Afterwards all absolute positions passed to and returned by the library are relative to the new origin. 
+	 * Shifts requested before the same updatePhysics call add up. Has to be called by the thread that called initPhysics
+	 */
+	HORDEPHYSICS_API void shiftOrigin( float x, float y, float z );
+	/**
+	 * Shifts the origin automatically to the origin focus once it is further away from the origin than 
+	 * distance, 0 disables the automatic shift. Has to be called by the thread that called initPhysics
+	 */
+	HORDEPHYSICS_API void setOriginShiftThreshold( float distance );
+	/**
+	 * Sets the position checked against the origin shift threshold, usually the player or camera position 
+	 * relative to the current origin. Has to be called by the thread that called initPhysics
+	 */
+	HORDEPHYSICS_API void setOriginFocus( float x, float y, float z );
+	/**
+	 * Returns the current origin relative to the initial one, the Horde3D root node has been moved by its 
+	 * negation. Pointers may be 0
+	 */
+	HORDEPHYSICS_API void getOriginOffset( double* x, double* y, double* z );
+	/**
+	 * Sets the camera used to skip the transfer of physics transformations to nodes outside its frustum.
+	 * Skipped transformations are transferred once the nodes become visible, 0 disables the culling
+	 */
+	HORDEPHYSICS_API void setVisibilityCamera( int cameraID );
+	/**
+	 * Transfers all skipped transformations, has to be called before reading the transformation of a
+	 * node that may be outside the visibility camera's frustum
+	 */
+	HORDEPHYSICS_API void flushTransforms();
+	/**
+	 * Transfers the skipped transformation of a single physics node
+	 */
+	HORDEPHYSICS_API void flushTransform( int hordeID );
+	/**
+	 * Enables or disables transferring transformations set in Horde3D (by the application or the animation
+	 * system) to the physics world at the beginning of updatePhysics. Moved nodes are detected by their
+	 * transformation flag, dynamic and static bodies are teleported. Enabled by default.
+	 * Kinematic bodies always follow their nodes smoothly and may sleep while their nodes rest
+	 */
+	HORDEPHYSICS_API void setSceneSync( bool enable );
+	/**
+	 * Enables or disables the export of the poses of all bodies that have moved during updatePhysics
+	 */
+	HORDEPHYSICS_API void setPoseExport( bool enable );
+	/**
+	 * Returns the poses of the bodies that have moved during the last updatePhysics call. The array is
+	 * owned by the physics and overwritten by the next updatePhysics call
+	 * @param count receives the number of poses
+	 */
+	HORDEPHYSICS_API const PhysicsPose* getPhysicsPoses( int* count );
+	/**
+	 * Returns the nodes that have entered or left a trigger volume during the last updatePhysics call. 
+	 * Triggers are created by attachments with trigger="1", overlaps are those of the bounding boxes of the
+	 * dynamic bodies, ragdolls and characters. The array is owned by the physics and overwritten by the next
+	 * updatePhysics call
+	 * @param count receives the number of events
+	 */
+	HORDEPHYSICS_API const TriggerEvent* getTriggerEvents( int* count );
+	/**
+	 * Sets the size of the trigger event buffer, 1024 by default. Events that don't fit into the buffer
+	 * are reported by the following updatePhysics calls
+	 */
+	HORDEPHYSICS_API void setTriggerEventCapacity( int capacity );
+	/**
+	 * Defines a collision layer that may be used by the group and mask attributes of BulletPhysics elements.
+	 * Default, Static, Kinematic, Debris, Trigger and Character are predefined, ten further layers may be
+	 * defined. Baked blobs store the resulting bits, so layers have to be defined in the same order when
+	 * baking and loading. Has to be called by the thread that called initPhysics
+	 * @return the filter bit of the layer, 0 if no bit is left
+	 */
+	HORDEPHYSICS_API int defineCollisionLayer( const char* name );
+	/**
+	 * Sets a callback deciding about the pairs that pass the collision filters of their objects, 0 removes
+	 * the callback. Pairs that already overlap are not affected. Has to be called by the thread that called
+	 * initPhysics
+	 */
+	HORDEPHYSICS_API void setOverlapFilter( OverlapFilter filter, void* userData );
+	/**
+	 * Enables the debug view, each updatePhysics call shows the physics world as overlays projected by the camera.
+	 * All lines of a category are shown by a single overlay batch, the application removes them with
+	 * h3dClearOverlays like any other overlay. Objects outside the camera frustum are skipped, lines beyond
+	 * the budget are not drawn. Has to be called by the thread that called initPhysics
+	 * @param cameraID camera node, 0 disables the debug view
+	 * @param categories combination of DebugDrawCategories flags, 0 disables the debug view
+	 * @param materialRes overlay material resource
+	 * @param maxLines number of lines drawn at most per updatePhysics call
+	 */
+	HORDEPHYSICS_API void setDebugDraw( int cameraID, int categories, int materialRes, int maxLines = 65536 );
+	/**
+	 * Returns the number of lines the last updatePhysics call couldn't draw within the budget of the debug view
+	 */
+	HORDEPHYSICS_API int getDebugDrawSkippedLines();
+	/**
+	 * Enables or disables transferring the simulated transformations to the Horde3D scene graph. 
+	 * Applications reading the exported poses only may disable it to avoid the per node API calls.
+	 * Enabled by default
+	 */
+	HORDEPHYSICS_API void setSceneWrites( bool enable );
+	/**
+	 * Enables a snapshot of all collision objects that is built at the end of each updatePhysics call.
+	 * castRay and queryAabb read from the snapshot, so they may be called from any thread at any time
+	 * and return the state of the last completed frame
+	 */
+	HORDEPHYSICS_API void setQuerySnapshots( bool enable );
+	/**
+	 * Returns the id of the closest node hit by the line segment from - to, 0 if nothing has been hit.
+	 * hitPoint and hitNormal (3 floats each, may be 0) receive the intersection
+	 */
+	HORDEPHYSICS_API int castRay( const float* from, const float* to, float* hitPoint, float* hitNormal );
+	/**
+	 * Writes the ids of up to maxIDs nodes whose bounding boxes overlap the given box to hordeIDs and
+	 * returns their number
+	 */
+	HORDEPHYSICS_API int queryAabb( const float* aabbMin, const float* aabbMax, int* hordeIDs, int maxIDs );
+	/**
+	 * Creates a kinematic character controller moving the given node. The character is an upright capsule
+	 * of the given radius and total height standing on the origin of the node, it climbs steps up to 
+	 * stepHeight. An existing character of the node is replaced. May be called from any thread like createPhysicsNode
+	 */
+	HORDEPHYSICS_API void createCharacter( int hordeID, float radius, float height, float stepHeight );
+	/**
+	 * Removes the character of a node. May be called from any thread like createPhysicsNode
+	 */
+	HORDEPHYSICS_API void removeCharacter( int hordeID );
+	/**
+	 * Sets the velocity a character walks with until it is changed again. May be called from any thread 
+	 * like createPhysicsNode
+	 */
+	HORDEPHYSICS_API void setCharacterVelocity( int hordeID, float x, float y, float z );
+	/**
+	 * Sets the velocities of many characters at once, velocities contains 3 floats for each of the count nodes.
+	 * May be called from any thread, calls from the thread that called initPhysics are applied directly 
+	 * without queueing a command for each character
+	 */
+	HORDEPHYSICS_API void setCharacterVelocities( const int* hordeIDs, const float* velocities, int count );
+	/**
+	 * Lets a character jump if it is standing on the ground. May be called from any thread like createPhysicsNode
+	 */
+	HORDEPHYSICS_API void jumpCharacter( int hordeID );
+	/**
+	 * Returns true if the character of the node stands on the ground. Has to be called by the thread that
+	 * called initPhysics
+	 */
+	HORDEPHYSICS_API bool isCharacterOnGround( int hordeID );
+	/**
+	 * Sets the engine force of the rear wheels, the brake force of all wheels and the steering angle (in radians)
+	 * of the front wheels of the vehicle whose chassis is the given node. May be called from any thread like 
+	 * createPhysicsNode
+	 */
+	HORDEPHYSICS_API void setVehicleControls( int hordeID, float engineForce, float brake, float steering );
 	
 }
\ No newline at end of file
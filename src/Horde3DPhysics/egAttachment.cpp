@@ -0,0 +1,604 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+#include "egAttachment.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+	inline bool isSpace( char c )
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	inline bool isNameChar( char c )
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+			c == '_' || c == '-' || c == ':' || c == '.';
+	}
+
+	inline char toLower( char c )
+	{
+		return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+	}
+
+	/// Moves the position behind the next occurence of the given text, or to the end of the string
+	inline const char* skipPast( const char* pos, const char* text )
+	{
+		const char* found = strstr( pos, text );
+		return found ? found + strlen( text ) : pos + strlen( pos );
+	}
+
+	/// Names of the collision layers, indexed by their bit
+	char layerNames[16][ConstraintDefinition::MaxNameLength] = { "Default", "Static", "Kinematic", "Debris", "Trigger", "Character" };
+
+	/// Exactly representable powers of ten
+	const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+}
+
+short CollisionLayers::define( const char* name )
+{
+	if( short bit = find( name, name + strlen( name ) ) )
+		return bit;
+	if( strlen( name ) >= ConstraintDefinition::MaxNameLength )
+		return 0;
+	for( int i = 0; i < 16; ++i )
+	{
+		if( layerNames[i][0] == 0 )
+		{
+			strcpy( layerNames[i], name );
+			return (short) ( 1 << i );
+		}
+	}
+	return 0;
+}
+
+short CollisionLayers::find( const char* begin, const char* end )
+{
+	for( int i = 0; i < 16; ++i )
+	{
+		if( layerNames[i][0] != 0 && (size_t) ( end - begin ) == strlen( layerNames[i] ) && 
+			strncmp( layerNames[i], begin, end - begin ) == 0 )
+			return (short) ( 1 << i );
+	}
+	return 0;
+}
+
+bool AttachmentParser::Token::equals( const char* text ) const
+{
+	const char* c = begin;
+	while( c != end && *text && *c == *text ) { ++c; ++text; }
+	return c == end && *text == 0;
+}
+
+bool AttachmentParser::Token::equalsNoCase( const char* text ) const
+{
+	const char* c = begin;
+	while( c != end && *text && toLower( *c ) == toLower( *text ) ) { ++c; ++text; }
+	return c == end && *text == 0;
+}
+
+bool AttachmentParser::Token::equalsNoCase( const Token& other ) const
+{
+	if( end - begin != other.end - other.begin )
+		return false;
+	for( const char *c = begin, *o = other.begin; c != end; ++c, ++o )
+	{
+		if( toLower( *c ) != toLower( *o ) )
+			return false;
+	}
+	return true;
+}
+
+float AttachmentParser::parseFloat( const char* begin, const char* end )
+{
+	const char* c = begin;
+	while( c != end && isSpace( *c ) ) ++c;
+
+	bool negative = false;
+	if( c != end && ( *c == '-' || *c == '+' ) )
+		negative = *c++ == '-';
+
+	// Up to 19 significant digits fit into the mantissa, further digits only change the exponent
+	unsigned long long mantissa = 0;
+	int digits = 0, exponent = 0;
+	for( ; c != end && *c >= '0' && *c <= '9'; ++c )
+	{
+		if( digits < 19 ) { mantissa = mantissa * 10 + ( *c - '0' ); if( mantissa ) ++digits; }
+		else ++exponent;
+	}
+	if( c != end && *c == '.' )
+	{
+		for( ++c; c != end && *c >= '0' && *c <= '9'; ++c )
+		{
+			if( digits < 19 ) { mantissa = mantissa * 10 + ( *c - '0' ); --exponent; if( mantissa ) ++digits; }
+		}
+	}
+	if( c != end && ( *c == 'e' || *c == 'E' ) )
+	{
+		++c;
+		bool negativeExp = false;
+		if( c != end && ( *c == '-' || *c == '+' ) )
+			negativeExp = *c++ == '-';
+		int exp = 0;
+		for( ; c != end && *c >= '0' && *c <= '9'; ++c )
+			if( exp < 10000 ) exp = exp * 10 + ( *c - '0' );
+		exponent += negativeExp ? -exp : exp;
+	}
+
+	double value = (double) mantissa;
+	if( mantissa != 0 && exponent != 0 )
+	{
+		if( exponent > 0 )
+			value *= exponent <= 22 ? powersOf10[exponent] : pow( 10.0, exponent );
+		else
+			value /= exponent >= -22 ? powersOf10[-exponent] : pow( 10.0, -exponent );
+	}
+	return (float) ( negative ? -value : value );
+}
+
+void AttachmentParser::skipMisc()
+{
+	for(;;)
+	{
+		while( isSpace( *m_pos ) ) ++m_pos;
+		if( strncmp( m_pos, "<!--", 4 ) == 0 )
+			m_pos = skipPast( m_pos + 4, "-->" );
+		else if( strncmp( m_pos, "<?", 2 ) == 0 )
+			m_pos = skipPast( m_pos + 2, "?>" );
+		else if( strncmp( m_pos, "<!", 2 ) == 0 )
+			m_pos = skipPast( m_pos + 2, ">" );
+		else
+			break;
+	}
+}
+
+bool AttachmentParser::readName( Token& name )
+{
+	name.begin = m_pos;
+	while( isNameChar( *m_pos ) ) ++m_pos;
+	name.end = m_pos;
+	return name.begin != name.end;
+}
+
+bool AttachmentParser::readAttribute( Token& name, Token& value )
+{
+	while( isSpace( *m_pos ) ) ++m_pos;
+	if( m_pos[0] == '/' && m_pos[1] == '>' )
+	{
+		m_emptyElement = true;
+		m_pos += 2;
+		return false;
+	}
+	if( *m_pos == '>' )
+	{
+		m_emptyElement = false;
+		++m_pos;
+		return false;
+	}
+	if( !readName( name ) )
+	{
+		m_error = true;
+		return false;
+	}
+	while( isSpace( *m_pos ) ) ++m_pos;
+	if( *m_pos++ != '=' )
+	{
+		m_error = true;
+		return false;
+	}
+	while( isSpace( *m_pos ) ) ++m_pos;
+	const char quote = *m_pos;
+	if( quote != '"' && quote != '\'' )
+	{
+		m_error = true;
+		return false;
+	}
+	value.begin = ++m_pos;
+	while( *m_pos && *m_pos != quote ) ++m_pos;
+	value.end = m_pos;
+	if( *m_pos == 0 )
+	{
+		m_error = true;
+		return false;
+	}
+	++m_pos;
+	return true;
+}
+
+bool AttachmentParser::skipContent( const Token& elementName )
+{
+	int depth = 1;
+	while( *m_pos )
+	{
+		if( *m_pos != '<' )
+			++m_pos;
+		else if( strncmp( m_pos, "<!--", 4 ) == 0 )
+			m_pos = skipPast( m_pos + 4, "-->" );
+		else if( strncmp( m_pos, "<![CDATA[", 9 ) == 0 )
+			m_pos = skipPast( m_pos + 9, "]]>" );
+		else if( m_pos[1] == '?' || m_pos[1] == '!' )
+			m_pos = skipPast( m_pos + 2, ">" );
+		else if( m_pos[1] == '/' )
+		{
+			m_pos += 2;
+			Token name;
+			readName( name );
+			m_pos = skipPast( m_pos, ">" );
+			if( --depth == 0 )
+				return name.equals( "" ) || name.equalsNoCase( elementName );
+		}
+		else
+		{
+			++m_pos;
+			Token name, attribName, attribValue;
+			if( !readName( name ) )
+				return false;
+			while( readAttribute( attribName, attribValue ) ) {}
+			if( m_error )
+				return false;
+			if( !m_emptyElement )
+				++depth;
+		}
+	}
+	return false;
+}
+
+bool AttachmentParser::readBulletPhysics( CollisionShape& shape )
+{
+	Token name, value, shapeName = { 0, 0 };
+	float extents[3] = { 0.0f, 0.0f, 0.0f }, radius = 0.0f;
+	while( readAttribute( name, value ) )
+	{
+		if( name.equalsNoCase( "shape" ) )
+			shapeName = value;
+		else if( name.equalsNoCase( "x" ) )
+			extents[0] = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "y" ) )
+			extents[1] = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "z" ) )
+			extents[2] = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "radius" ) )
+			radius = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "mass" ) )
+			shape.mass = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "friction" ) )
+			shape.friction = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "restitution" ) )
+			shape.restitution = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "kinematic" ) )
+			shape.kinematic = value.equalsNoCase( "true" ) || value.equals( "1" );
+		else if( name.equalsNoCase( "compound" ) )
+			shape.compound = value.equalsNoCase( "true" ) || value.equals( "1" );
+		else if( name.equalsNoCase( "trigger" ) )
+			shape.trigger = value.equalsNoCase( "true" ) || value.equals( "1" );
+		else if( name.equalsNoCase( "limit" ) )
+			shape.jointLimit = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "motor" ) )
+			shape.jointMotor = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "group" ) )
+			shape.group = readLayers( value );
+		else if( name.equalsNoCase( "mask" ) )
+			shape.mask = readLayers( value );
+	}
+	if( m_error )
+		return false;
+
+	if( shapeName.begin && shapeName.equalsNoCase( "box" ) )
+	{
+		shape.type = CollisionShape::Box;
+		shape.extents[0] = extents[0];
+		shape.extents[1] = extents[1];
+		shape.extents[2] = extents[2];
+	}
+	else if( shapeName.begin && shapeName.equalsNoCase( "sphere" ) )
+	{
+		shape.type = CollisionShape::Sphere;
+		shape.radius = radius;
+	}
+	else if( shapeName.begin && shapeName.equalsNoCase( "ragdoll" ) )
+	{
+		shape.type = CollisionShape::Ragdoll;
+		shape.radius = radius;
+	}
+	else
+		shape.type = CollisionShape::Mesh;
+
+	Token elementName = { "BulletPhysics", 0 };
+	elementName.end = elementName.begin + 13;
+	return m_emptyElement || skipContent( elementName );
+}
+
+bool AttachmentParser::readConstraint( ConstraintDefinition& constraint )
+{
+	Token name, value;
+	while( readAttribute( name, value ) )
+	{
+		if( name.equalsNoCase( "type" ) )
+		{
+			if( value.equalsNoCase( "point" ) )
+				constraint.type = ConstraintDefinition::Point;
+			else if( value.equalsNoCase( "hinge" ) )
+				constraint.type = ConstraintDefinition::Hinge;
+			else if( value.equalsNoCase( "slider" ) )
+				constraint.type = ConstraintDefinition::Slider;
+			else if( value.equalsNoCase( "spring" ) )
+				constraint.type = ConstraintDefinition::Spring;
+			else
+				m_error = true;
+		}
+		else if( name.equalsNoCase( "target" ) )
+			readNodeName( value, constraint.target );
+		else if( name.equalsNoCase( "x" ) )
+			constraint.pivot[0] = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "y" ) )
+			constraint.pivot[1] = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "z" ) )
+			constraint.pivot[2] = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "axisX" ) )
+			constraint.axis[0] = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "axisY" ) )
+			constraint.axis[1] = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "axisZ" ) )
+			constraint.axis[2] = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "low" ) )
+			constraint.low = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "high" ) )
+			constraint.high = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "stiffness" ) )
+			constraint.stiffness = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "damping" ) )
+			constraint.damping = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "breaking" ) )
+			constraint.breakingImpulse = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "collide" ) )
+			constraint.collide = value.equalsNoCase( "true" ) || value.equals( "1" );
+	}
+	if( m_error )
+		return false;
+
+	Token elementName = { "Constraint", 0 };
+	elementName.end = elementName.begin + 10;
+	return m_emptyElement || skipContent( elementName );
+}
+
+bool AttachmentParser::readNodeName( const Token& value, char* name )
+{
+	// names that don't fit could only be resolved to the wrong node
+	if( value.end - value.begin >= ConstraintDefinition::MaxNameLength )
+	{
+		m_error = true;
+		return false;
+	}
+	memcpy( name, value.begin, value.end - value.begin );
+	name[value.end - value.begin] = 0;
+	return true;
+}
+
+short AttachmentParser::readLayers( const Token& value )
+{
+	short bits = 0;
+	bool first = true;
+	for( const char* c = value.begin; c != value.end; )
+	{
+		if( *c == '|' || isSpace( *c ) )
+		{
+			++c;
+			continue;
+		}
+		const bool negated = *c == '!';
+		if( negated )
+			++c;
+		Token layer = { c, c };
+		while( layer.end != value.end && *layer.end != '|' && !isSpace( *layer.end ) )
+			++layer.end;
+		c = layer.end;
+
+		short bit = layer.equals( "All" ) ? (short) -1 : CollisionLayers::find( layer.begin, layer.end );
+		if( bit == 0 )
+			printf( "Unknown collision layer '%.*s'\n", (int) ( layer.end - layer.begin ), layer.begin );
+		if( first && negated )
+			bits = -1;
+		bits = (short) ( negated ? bits & ~bit : bits | bit );
+		first = false;
+	}
+	return bits;
+}
+
+bool AttachmentParser::readWheel( WheelDefinition& wheel )
+{
+	wheel.node[0] = 0;
+	wheel.radius = 0.5f;
+	wheel.suspension = 0.5f;
+	wheel.front = false;
+	Token name, value;
+	while( readAttribute( name, value ) )
+	{
+		if( name.equalsNoCase( "node" ) )
+			readNodeName( value, wheel.node );
+		else if( name.equalsNoCase( "radius" ) )
+			wheel.radius = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "suspension" ) )
+			wheel.suspension = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "front" ) )
+			wheel.front = value.equalsNoCase( "true" ) || value.equals( "1" );
+	}
+	if( m_error )
+		return false;
+
+	Token elementName = { "Wheel", 0 };
+	elementName.end = elementName.begin + 5;
+	return m_emptyElement || skipContent( elementName );
+}
+
+bool AttachmentParser::readVehicle( VehicleDefinition& vehicle )
+{
+	Token name, value;
+	while( readAttribute( name, value ) )
+	{
+		if( name.equalsNoCase( "stiffness" ) )
+			vehicle.stiffness = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "compression" ) )
+			vehicle.compression = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "damping" ) )
+			vehicle.damping = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "travel" ) )
+			vehicle.maxTravel = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "friction" ) )
+			vehicle.frictionSlip = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "maxForce" ) )
+			vehicle.maxForce = parseFloat( value.begin, value.end );
+		else if( name.equalsNoCase( "rollInfluence" ) )
+			vehicle.rollInfluence = parseFloat( value.begin, value.end );
+	}
+	if( m_error )
+		return false;
+	if( m_emptyElement )
+		return true;
+
+	// Wheel children, further wheels and other elements are skipped
+	for(;;)
+	{
+		while( *m_pos && *m_pos != '<' ) ++m_pos;
+		skipMisc();
+		if( m_pos[0] != '<' )
+			return false;
+		if( m_pos[1] == '/' )
+		{
+			m_pos = skipPast( m_pos, ">" );
+			return true;
+		}
+		++m_pos;
+		if( !readName( name ) )
+			return false;
+		if( vehicle.numWheels < VehicleDefinition::MaxWheels && name.equalsNoCase( "Wheel" ) )
+		{
+			if( !readWheel( vehicle.wheels[vehicle.numWheels++] ) )
+				return false;
+		}
+		else
+		{
+			Token attribName, attribValue;
+			while( readAttribute( attribName, attribValue ) ) {}
+			if( m_error || ( !m_emptyElement && !skipContent( name ) ) )
+				return false;
+		}
+	}
+}
+
+bool AttachmentParser::parse( const char* xmlText, CollisionShape& shape, ConstraintDefinition* constraints, int maxConstraints,
+	int* numConstraints, VehicleDefinition* vehicle )
+{
+	if( numConstraints )
+		*numConstraints = 0;
+	if( vehicle )
+		vehicle->numWheels = 0;
+	if( xmlText == 0 )
+		return false;
+
+	AttachmentParser parser( xmlText );
+	parser.m_emptyElement = false;
+	parser.m_error = false;
+
+	// Search the Attachment element on the top level
+	Token name, attribName, attribValue;
+	for(;;)
+	{
+		parser.skipMisc();
+		if( *parser.m_pos != '<' )
+			return false;
+		++parser.m_pos;
+		if( !parser.readName( name ) )
+			return false;
+		if( name.equalsNoCase( "Attachment" ) )
+			break;
+		while( parser.readAttribute( attribName, attribValue ) ) {}
+		if( parser.m_error || ( !parser.m_emptyElement && !parser.skipContent( name ) ) )
+			return false;
+	}
+
+	bool gameEngine = false;
+	while( parser.readAttribute( attribName, attribValue ) )
+	{
+		if( attribName.equalsNoCase( "type" ) )
+			gameEngine = attribValue.equalsNoCase( "GameEngine" );
+	}
+	if( parser.m_error || !gameEngine || parser.m_emptyElement )
+		return false;
+
+	// Child elements of the attachment, text content is ignored
+	bool found = false;
+	int constraintCount = 0;
+	for(;;)
+	{
+		while( *parser.m_pos && *parser.m_pos != '<' ) ++parser.m_pos;
+		parser.skipMisc();
+		if( parser.m_pos[0] != '<' )
+			break;
+		if( parser.m_pos[1] == '/' )
+		{
+			if( numConstraints )
+				*numConstraints = found ? constraintCount : 0;
+			if( vehicle && !found )
+				vehicle->numWheels = 0;
+			return found;
+		}
+		++parser.m_pos;
+		if( !parser.readName( name ) )
+			break;
+		if( !found && name.equalsNoCase( "BulletPhysics" ) )
+		{
+			if( !parser.readBulletPhysics( shape ) )
+				break;
+			found = true;
+		}
+		else if( constraints && constraintCount < maxConstraints && name.equalsNoCase( "Constraint" ) )
+		{
+			constraints[constraintCount] = ConstraintDefinition();
+			if( !parser.readConstraint( constraints[constraintCount] ) )
+				break;
+			++constraintCount;
+		}
+		else if( vehicle && name.equalsNoCase( "Vehicle" ) )
+		{
+			*vehicle = VehicleDefinition();
+			if( !parser.readVehicle( *vehicle ) )
+				break;
+		}
+		else
+		{
+			while( parser.readAttribute( attribName, attribValue ) ) {}
+			if( parser.m_error || ( !parser.m_emptyElement && !parser.skipContent( name ) ) )
+				break;
+		}
+	}
+
+#ifdef _DEBUG
+	printf( "Error reading attachment at character %d\n", (int) ( parser.m_pos - xmlText ) );
+#endif
+	return false;
+}
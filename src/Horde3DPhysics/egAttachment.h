@@ -0,0 +1,242 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+#pragma once
+
+/// Helper struct for loading collision objects, filled from the attributes of a BulletPhysics element
+struct CollisionShape
+{
+	enum Type {Box, Sphere, Mesh, Ragdoll};
+	Type type;
+	float mass;
+	bool kinematic;
+	/// Builds a single compound shape from all child meshes of a model node
+	bool compound;
+	/// Creates a trigger volume reporting overlaps instead of a rigid body, box and sphere shapes only
+	bool trigger;
+	/// Surface material of the rigid body
+	float friction;
+	float restitution;
+	/// Maximum rotation of a ragdoll joint around each axis in degrees, 0 for unlimited joints
+	float jointLimit;
+	/// Maximum impulse of the motors damping the ragdoll joints, 0 for limp joints
+	float jointMotor;
+	/// Broadphase filter bits of the collision layers the body belongs to and collides with, 0 for Bullet's defaults
+	short group;
+	short mask;
+
+	union
+	{
+		float extents[3];
+		/// Radius of a sphere or of the links of a ragdoll
+		float radius;
+	};
+
+	CollisionShape() : type(Mesh), mass(0.0f), kinematic(false), compound(false), trigger(false), friction(0.5f), restitution(0.0f),
+		jointLimit(0.0f), jointMotor(0.0f), group(0), mask(0)
+	{
+		extents[0] = extents[1] = extents[2] = 0.0f;
+	}
+};
+
+/// Joint between the body of an attachment and the body of another node, filled from a Constraint element
+struct ConstraintDefinition
+{
+	enum Type {Point, Hinge, Slider, Spring};
+	enum { MaxNameLength = 64 };
+	/// Constraint elements read from a single attachment, further ones are ignored
+	enum { MaxPerAttachment = 16 };
+	Type type;
+	/// Name of the node owning the other body, empty to attach the body to the world
+	char target[MaxNameLength];
+	/// Pivot in the local coordinates of the attachment's node
+	float pivot[3];
+	/// Axis of hinges, sliders and springs in the local coordinates of the attachment's node
+	float axis[3];
+	/// Range of the rotation in degrees (hinges) or of the translation along the axis, unlimited if low > high
+	float low;
+	float high;
+	/// Spring constant and damping of springs
+	float stiffness;
+	float damping;
+	/// Impulse breaking the constraint, 0 for unbreakable constraints
+	float breakingImpulse;
+	/// Whether the connected bodies collide with each other
+	bool collide;
+
+	ConstraintDefinition() : type(Point), low(1.0f), high(-1.0f), stiffness(0.0f), damping(0.0f), breakingImpulse(0.0f), collide(false)
+	{
+		target[0] = 0;
+		pivot[0] = pivot[1] = pivot[2] = 0.0f;
+		axis[0] = axis[2] = 0.0f;
+		axis[1] = 1.0f;
+	}
+};
+
+/// Wheel of a vehicle, filled from a Wheel element
+struct WheelDefinition
+{
+	/// Name of the wheel node below the chassis node
+	char node[ConstraintDefinition::MaxNameLength];
+	float radius;
+	/// Rest length of the suspension
+	float suspension;
+	/// Front wheels are steered, the other wheels are driven
+	bool front;
+};
+
+/// Raycast vehicle using the body of an attachment as chassis, filled from a Vehicle element and its Wheel children
+struct VehicleDefinition
+{
+	enum { MaxWheels = 8 };
+	/// 0 if the attachment doesn't contain a vehicle
+	int numWheels;
+	WheelDefinition wheels[MaxWheels];
+	/// Suspension and tire parameters of btRaycastVehicle::btVehicleTuning
+	float stiffness;
+	float compression;
+	float damping;
+	/// Maximum suspension travel in centimeters
+	float maxTravel;
+	float frictionSlip;
+	float maxForce;
+	/// Reduces the rolling torque of the wheel forces, 0 prevents the vehicle from rolling over
+	float rollInfluence;
+
+	VehicleDefinition() : numWheels(0), stiffness(5.88f), compression(0.83f), damping(0.88f), maxTravel(500.0f), frictionSlip(10.5f), 
+		maxForce(6000.0f), rollInfluence(0.1f)
+	{
+	}
+};
+
+/**
+ * \brief Named collision layers mapped to the bits of Bullet's broadphase filter group and mask
+ *
+ * The layers Default, Static, Kinematic, Debris, Trigger and Character are Bullet's predefined filter
+ * groups, further layers use the remaining bits.
+ */
+class CollisionLayers
+{
+public:
+	/**
+	 * Defines a new layer or returns the bit of an existing one
+	 * @param name name of the layer used by the group and mask attributes
+	 * @return the filter bit of the layer, 0 if all bits are used
+	 */
+	static short define( const char* name );
+
+	/**
+	 * Returns the filter bit of a layer
+	 * @param begin first character of the layer name
+	 * @param end character after the name
+	 * @return the bit or 0 if the layer is not defined
+	 */
+	static short find( const char* begin, const char* end );
+};
+
+/**
+ * \brief Streaming parser for physics attachments
+ *
+ * Reads attachments of the form
+ * <Attachment type="GameEngine"><BulletPhysics shape="Box" x="1" y="1" z="1" mass="1" /></Attachment>
+ * directly from the attachment string. In contrast to XMLNode no DOM is built, the text is scanned in place
+ * without any heap allocation and numbers are converted by a locale independent float parser.
+ * A ragdoll is attached to a model node with shape="Ragdoll", the attributes radius, limit and motor
+ * describe the links and joints built from the model's joint hierarchy. With trigger="1" a box or sphere
+ * becomes a trigger volume that only reports the objects entering and leaving it.
+ * The attributes group and mask list the collision layers of the body, e.g. group="Debris" mask="!Debris"
+ * lets debris collide with everything but other debris. Layers are separated by '|', a list starting with
+ * a negated layer starts from all layers.
+ * Constraint elements next to the BulletPhysics element connect the body to the body of another node, e.g.
+ * <Constraint type="Hinge" target="DoorFrame" x="0.5" axisY="1" low="0" high="90" />
+ * A Vehicle element turns the body into the chassis of a raycast vehicle with the wheel nodes listed by
+ * its Wheel children, e.g. <Vehicle stiffness="20"><Wheel node="FrontLeft" radius="0.4" suspension="0.6" front="true" /></Vehicle>
+ */
+class AttachmentParser
+{
+public:
+	/**
+	 * Parses a physics attachment
+	 * @param xmlText code of the attachment node
+	 * @param shape collision shape information that will be filled by the attributes of the BulletPhysics element
+	 * @param constraints array receiving the Constraint elements, may be 0 if they are not needed
+	 * @param maxConstraints size of the constraints array, further Constraint elements are ignored
+	 * @param numConstraints receives the number of Constraint elements that have been read
+	 * @param vehicle receives the Vehicle element, may be 0 if it is not needed
+	 * @return true if the attachment contains a BulletPhysics element
+	 */
+	static bool parse( const char* xmlText, CollisionShape& shape, ConstraintDefinition* constraints = 0, int maxConstraints = 0,
+		int* numConstraints = 0, VehicleDefinition* vehicle = 0 );
+
+	/**
+	 * Converts a decimal number with optional sign, fraction and exponent
+	 * @param begin first character of the number
+	 * @param end character after the number
+	 * @return the parsed value, 0 if the text is not a number
+	 */
+	static float parseFloat( const char* begin, const char* end );
+
+private:
+	/// Section of the attachment text, not zero terminated
+	struct Token
+	{
+		const char* begin;
+		const char* end;
+
+		bool equals( const char* text ) const;
+		/// Element and attribute names are compared case insensitive like XMLNode does
+		bool equalsNoCase( const char* text ) const;
+		bool equalsNoCase( const Token& other ) const;
+	};
+
+	AttachmentParser( const char* xmlText ) : m_pos(xmlText) {}
+
+	/// Skips white space, comments and processing instructions
+	void skipMisc();
+	/// Reads the name of an element or attribute
+	bool readName( Token& name );
+	/**
+	 * Reads the next attribute of the current element
+	 * @return false at the end of the start tag, m_emptyElement tells if the element has no content
+	 */
+	bool readAttribute( Token& name, Token& value );
+	/// Skips the content and the end tag of the current element
+	bool skipContent( const Token& elementName );
+	/// Reads the attributes of a BulletPhysics element
+	bool readBulletPhysics( CollisionShape& shape );
+	/// Reads the attributes of a Constraint element
+	bool readConstraint( ConstraintDefinition& constraint );
+	/// Reads the attributes and the Wheel children of a Vehicle element
+	bool readVehicle( VehicleDefinition& vehicle );
+	/// Reads the attributes of a Wheel element
+	bool readWheel( WheelDefinition& wheel );
+	/// Copies an attribute value into a name buffer of MaxNameLength characters
+	bool readNodeName( const Token& value, char* name );
+	/// Converts a list of collision layers into filter bits
+	short readLayers( const Token& value );
+
+	const char*		m_pos;
+	bool			m_emptyElement;
+	bool			m_error;
+};
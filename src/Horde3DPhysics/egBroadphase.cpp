@@ -0,0 +1,91 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+#include "egBroadphase.h"
+#include <vector>
+
+using namespace std;
+
+void ShiftableAxisSweep::shiftOrigin(const btVector3& translation, btDispatcher* dispatcher)
+{
+	// the edges between the sentinels belong to the handles in use
+	const int numEdges = m_numHandles * 2;
+	for (int i = 1; i <= numEdges; ++i)
+	{
+		if (m_pEdges[0][i].IsMax())
+			continue;
+		Handle* handle = getHandle(m_pEdges[0][i].m_handle);
+		handle->m_aabbMin += translation;
+		handle->m_aabbMax += translation;
+		if (m_raycastAccelerator)
+			m_raycastAccelerator->setAabb(handle->m_dbvtProxy, handle->m_aabbMin, handle->m_aabbMax, dispatcher);
+	}
+
+	// Quantization is monotonic, only min and max edges within the same quantization step may swap. A min edge 
+	// passing a max edge is a new overlap along its axis, the pair is added once all axes have been sorted.
+	vector< pair<unsigned short, unsigned short> > crossings;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		Edge* edges = m_pEdges[axis];
+		for (int i = 1; i <= numEdges; ++i)
+		{
+			const Handle* handle = getHandle(edges[i].m_handle);
+			unsigned short position[3];
+			quantize(position, edges[i].IsMax() ? handle->m_aabbMax : handle->m_aabbMin, edges[i].IsMax());
+			edges[i].m_pos = position[axis];
+		}
+		for (int i = 2; i <= numEdges; ++i)
+		{
+			const Edge edge = edges[i];
+			int j = i;
+			for (; j > 1 && edges[j - 1].m_pos > edge.m_pos; --j)
+			{
+				if (!edge.IsMax() && edges[j - 1].IsMax())
+					crossings.push_back(make_pair(edge.m_handle, edges[j - 1].m_handle));
+				edges[j] = edges[j - 1];
+			}
+			edges[j] = edge;
+		}
+		for (int i = 1; i <= numEdges; ++i)
+		{
+			Handle* handle = getHandle(edges[i].m_handle);
+			if (edges[i].IsMax())
+				handle->m_maxEdges[axis] = (unsigned short) i;
+			else
+				handle->m_minEdges[axis] = (unsigned short) i;
+		}
+	}
+
+	for (unsigned int i = 0; i < crossings.size(); ++i)
+	{
+		Handle* handleA = getHandle(crossings[i].first);
+		Handle* handleB = getHandle(crossings[i].second);
+		if (!testAabbOverlap(handleA, handleB))
+			continue;
+		// existing pairs are returned unchanged
+		m_pairCache->addOverlappingPair(handleA, handleB);
+		if (m_userPairCallback)
+			m_userPairCallback->addOverlappingPair(handleA, handleB);
+	}
+}
@@ -0,0 +1,47 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+#pragma once
+
+#include <Bullet/btBulletDynamicsCommon.h>
+
+/**
+ * \brief Sweep and prune broadphase that can move all proxies by the same offset at once
+ *
+ * Moving the proxies one after another through setAabb would sort each of them through the edges of the
+ * others, removing and adding pairs on the way. A uniform translation keeps the order of the edges, so 
+ * the edges are requantized in place and the overlapping pairs and their contact manifolds are kept.
+ */
+class ShiftableAxisSweep : public btAxisSweep3
+{
+public:
+	ShiftableAxisSweep(const btVector3& worldAabbMin, const btVector3& worldAabbMax) : btAxisSweep3(worldAabbMin, worldAabbMax) {}
+
+	/**
+	 * Translates the bounding boxes of all proxies
+	 * @param translation offset added to all positions
+	 * @param dispatcher dispatcher of the world the proxies belong to
+	 */
+	void shiftOrigin(const btVector3& translation, btDispatcher* dispatcher);
+};
@@ -0,0 +1,155 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egCharacter.h"
+#include <Horde3D/Horde3D.h>
+#include <Horde3D/utMath.h>
+#include <algorithm>
+
+using namespace std;
+using namespace Horde3D;
+
+Character::Character(int hordeID, float radius, float height, float stepHeight, btScalar gravity) : m_hordeID(hordeID)
+{
+	m_centerOffset = max(height * 0.5f, radius);
+	m_shape = new btCapsuleShape(radius, m_centerOffset * 2 - radius * 2);
+
+	// the capsule stands upright on the origin of the node
+	const float* x = 0;
+	h3dGetNodeTransMats(hordeID, 0, &x);
+	m_position[0] = x ? x[12] : 0;
+	m_position[1] = x ? x[13] : 0;
+	m_position[2] = x ? x[14] : 0;
+	m_ghostObject = new btPairCachingGhostObject();
+	m_ghostObject->setCollisionShape(m_shape);
+	m_ghostObject->setCollisionFlags(btCollisionObject::CF_CHARACTER_OBJECT);
+	m_ghostObject->setUserIndex(hordeID);
+	m_startCenter[0] = m_position[0];
+	m_startCenter[1] = m_position[1] + m_centerOffset;
+	m_startCenter[2] = m_position[2];
+	m_ghostObject->setWorldTransform(btTransform(btQuaternion::getIdentity(), btVector3(m_startCenter[0], m_startCenter[1], m_startCenter[2])));
+
+	m_controller = new btKinematicCharacterController(m_ghostObject, m_shape, stepHeight);
+	m_controller->setGravity(gravity);
+}
+
+Character::~Character()
+{
+	delete m_controller;
+	delete m_ghostObject;
+	delete m_shape;
+}
+
+void Character::setVelocity(const btVector3& velocity)
+{
+	// the velocity is kept until it is changed again
+	m_controller->setVelocityForTimeInterval(velocity, BT_LARGE_FLOAT);
+}
+
+void Character::reset(btCollisionWorld* collisionWorld)
+{
+	m_controller->reset(collisionWorld);
+	m_controller->warp(btVector3(m_startCenter[0], m_startCenter[1], m_startCenter[2]));
+}
+
+void Character::shiftOrigin(const btVector3& translation)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		m_position[i] += translation[i];
+		m_startCenter[i] += translation[i];
+	}
+}
+
+void Character::update()
+{
+	const btVector3& center = m_ghostObject->getWorldTransform().getOrigin();
+	const float position[3] = { center.x(), center.y() - m_centerOffset, center.z() };
+	if (position[0] == m_position[0] && position[1] == m_position[1] && position[2] == m_position[2])
+		return;
+	m_position[0] = position[0];
+	m_position[1] = position[1];
+	m_position[2] = position[2];
+
+	// Only the translation of the absolute transformation changes
+	const float* parentMat = 0;
+	const float* absMat = 0;
+	h3dGetNodeTransMats(h3dGetNodeParent(m_hordeID), 0, &parentMat);
+	h3dGetNodeTransMats(m_hordeID, 0, &absMat);
+	if (!parentMat || !absMat)
+		return;
+	Matrix4f absTrans(absMat);
+	absTrans.x[12] = position[0];
+	absTrans.x[13] = position[1];
+	absTrans.x[14] = position[2];
+	h3dSetNodeTransMat(m_hordeID, (Matrix4f(parentMat).inverted() * absTrans).x);
+}
+
+CharacterBatch::~CharacterBatch()
+{
+	for (unsigned int i = 0; i < m_characters.size(); ++i)
+		delete m_characters[i];
+}
+
+void CharacterBatch::add(Character* character)
+{
+	m_characters.push_back(character);
+}
+
+Character* CharacterBatch::remove(int hordeID)
+{
+	for (unsigned int i = 0; i < m_characters.size(); ++i)
+	{
+		if (m_characters[i]->hordeID() == hordeID)
+		{
+			Character* character = m_characters[i];
+			m_characters.erase(m_characters.begin() + i);
+			return character;
+		}
+	}
+	return 0;
+}
+
+Character* CharacterBatch::find(int hordeID) const
+{
+	for (unsigned int i = 0; i < m_characters.size(); ++i)
+	{
+		if (m_characters[i]->hordeID() == hordeID)
+			return m_characters[i];
+	}
+	return 0;
+}
+
+void CharacterBatch::updateAction(btCollisionWorld* collisionWorld, btScalar deltaTimeStep)
+{
+	for (unsigned int i = 0; i < m_characters.size(); ++i)
+		m_characters[i]->controller()->updateAction(collisionWorld, deltaTimeStep);
+}
+
+void CharacterBatch::debugDraw(btIDebugDraw* debugDrawer)
+{
+	for (unsigned int i = 0; i < m_characters.size(); ++i)
+		m_characters[i]->controller()->debugDraw(debugDrawer);
+}
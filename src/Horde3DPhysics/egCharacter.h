@@ -0,0 +1,124 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <vector>
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <Bullet/BulletCollision/CollisionDispatch/btGhostObject.h>
+#include <Bullet/BulletDynamics/Character/btKinematicCharacterController.h>
+
+/**
+ * \brief Kinematic character attached to a Horde3D node
+ *
+ * The character is a capsule standing on the origin of its node. Its btKinematicCharacterController moves a 
+ * btPairCachingGhostObject, whose overlapping pairs are maintained by the broadphase, so the controller only 
+ * tests the objects around the character instead of sweeping through the whole world.
+ */
+class Character
+{
+public:
+	/**
+	 * Constructor
+	 * @param hordeID id of the Horde3D node moved by the character
+	 * @param radius radius of the capsule
+	 * @param height total height of the capsule, at least 2 * radius
+	 * @param stepHeight maximum height of steps the character climbs
+	 * @param gravity downward acceleration of falling characters
+	 */
+	Character(int hordeID, float radius, float height, float stepHeight, btScalar gravity);
+	/// Destructor, the ghost object has to be removed from the world before
+	~Character();
+
+	int hordeID() const { return m_hordeID; }
+	btPairCachingGhostObject* ghostObject() { return m_ghostObject; }
+	btKinematicCharacterController* controller() { return m_controller; }
+
+	/**
+	 * Sets the velocity the character walks with until the next call
+	 */
+	void setVelocity(const btVector3& velocity);
+
+	/**
+	 * Moves the character back to the position it has been created at and stops it
+	 */
+	void reset(btCollisionWorld* collisionWorld);
+
+	/**
+	 * Moves the start position and the last written position, the ghost object is moved together with all
+	 * objects of the world
+	 * @param translation offset added to all positions
+	 */
+	void shiftOrigin(const btVector3& translation);
+
+	/**
+	 * Transfers the position of the character to its Horde3D node, the rotation of the node is kept
+	 */
+	void update();
+
+private:
+	btCapsuleShape*						m_shape;
+	btPairCachingGhostObject*			m_ghostObject;
+	btKinematicCharacterController*		m_controller;
+	/// Distance between the center of the capsule and the origin of the node
+	float								m_centerOffset;
+	/// Position last written to the node
+	float								m_position[3];
+	/// Center of the capsule the character has been created with
+	float								m_startCenter[3];
+	/// ID within the Horde3D scenegraph
+	int									m_hordeID;
+};
+
+/**
+ * \brief Single action updating all characters of the world
+ *
+ * Instead of registering one action per character, the world calls this batch once per simulation step, 
+ * which updates the characters one after another in the order they have been created.
+ */
+class CharacterBatch : public btActionInterface
+{
+public:
+	/// Destructor, deletes the remaining characters
+	virtual ~CharacterBatch();
+
+	void add(Character* character);
+	/**
+	 * Removes a character from the batch without deleting it
+	 * @return the character or 0 if there is no character for the node
+	 */
+	Character* remove(int hordeID);
+	/// Returns the character of a node or 0
+	Character* find(int hordeID) const;
+
+	int numCharacters() const { return (int) m_characters.size(); }
+	Character* character(int index) const { return m_characters[index]; }
+
+	virtual void updateAction(btCollisionWorld* collisionWorld, btScalar deltaTimeStep);
+	virtual void debugDraw(btIDebugDraw* debugDrawer);
+
+private:
+	std::vector<Character*>	m_characters;
+};
@@ -0,0 +1,77 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egCommandQueue.h"
+
+using namespace std;
+
+CommandQueue::CommandQueue() : m_head(&m_stub), m_tail(&m_stub), m_stub(PhysicsCommand::RemoveNode, 0)
+{
+}
+
+CommandQueue::~CommandQueue()
+{
+	while (PhysicsCommand* command = pop())
+		delete command;
+}
+
+void CommandQueue::push(PhysicsCommand* command)
+{
+	command->next.store(0, memory_order_relaxed);
+	PhysicsCommand* previous = m_head.exchange(command, memory_order_acq_rel);
+	// the command is not visible to the consumer until it has been linked to its predecessor
+	previous->next.store(command, memory_order_release);
+}
+
+PhysicsCommand* CommandQueue::pop()
+{
+	PhysicsCommand* tail = m_tail;
+	PhysicsCommand* next = tail->next.load(memory_order_acquire);
+	if (tail == &m_stub)
+	{
+		if (!next)
+			return 0;
+		m_tail = next;
+		tail = next;
+		next = next->next.load(memory_order_acquire);
+	}
+	if (next)
+	{
+		m_tail = next;
+		return tail;
+	}
+	// a producer has swapped the head but not linked its command yet
+	if (tail != m_head.load(memory_order_acquire))
+		return 0;
+	// tail is the last command, the stub takes its place so that it can be returned
+	push(&m_stub);
+	next = tail->next.load(memory_order_acquire);
+	if (next)
+	{
+		m_tail = next;
+		return tail;
+	}
+	return 0;
+}
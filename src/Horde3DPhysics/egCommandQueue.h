@@ -0,0 +1,87 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <string>
+#include <atomic>
+
+/**
+ * \brief Change of the physics world requested by a thread that doesn't own the Physics instance
+ */
+struct PhysicsCommand
+{
+	enum Type { CreateNode, CreateNodes, RemoveNode, ApplyImpulse, Teleport, CreateCharacter, RemoveCharacter, MoveCharacter, JumpCharacter,
+		VehicleControls };
+
+	Type							type;
+	/// Horde3D node the command refers to, the root node for CreateNodes
+	int								hordeID;
+	/// Impulse and relative position for ApplyImpulse, absolute transformation for Teleport, 
+	/// radius, height and step height for CreateCharacter, velocity for MoveCharacter,
+	/// engine force, brake and steering for VehicleControls
+	float							values[16];
+	/// Attachment code for CreateNode
+	std::string						xmlText;
+	/// Next command in the CommandQueue
+	std::atomic<PhysicsCommand*>	next;
+
+	PhysicsCommand(Type commandType, int id) : type(commandType), hordeID(id), next(0) {}
+};
+
+/**
+ * \brief Lock free multi producer single consumer queue of physics commands
+ *
+ * Any number of threads may push commands at the same time, a push never blocks. Only one thread may pop
+ * commands. The queue takes ownership of the pushed commands until they are popped again.
+ * Follows Dmitry Vyukov's intrusive MPSC node based queue.
+ */
+class CommandQueue
+{
+public:
+	CommandQueue();
+	/// Destructor, deletes all commands that have not been popped
+	~CommandQueue();
+
+	/**
+	 * Appends a command, may be called from any thread
+	 * @param command the command allocated with new
+	 */
+	void push(PhysicsCommand* command);
+
+	/**
+	 * Removes the oldest command, must only be called by the consuming thread
+	 * @return the command or 0 if the queue is empty or the next command is still being pushed
+	 */
+	PhysicsCommand* pop();
+
+private:
+	/// Last pushed command, producers swap it atomically
+	std::atomic<PhysicsCommand*>	m_head;
+	/// Next command to pop, only accessed by the consumer
+	PhysicsCommand*					m_tail;
+	/// Placeholder keeping the queue linked while it is empty
+	PhysicsCommand					m_stub;
+};
@@ -0,0 +1,244 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egDebugDrawer.h"
+#include "Horde3DPhysics.h"
+#include <cstdio>
+
+using namespace Horde3D;
+
+namespace
+{
+	/// Width of the lines in overlay coordinates, about a pixel at 720 lines
+	const float LineWidth = 0.0015f;
+	/// Size of the crosses marking contact points in world units
+	const btScalar ContactSize = 0.05f;
+
+	/// Colors of the categories, the defaults of btIDebugDraw
+	const float CategoryColors[DebugDrawer::NumCategories][3] =
+	{
+		{ 1.0f, 1.0f, 0.0f },	// contacts
+		{ 1.0f, 0.0f, 1.0f },	// constraints
+		{ 1.0f, 1.0f, 1.0f },	// active shapes
+		{ 0.0f, 1.0f, 0.0f },	// sleeping shapes
+		{ 1.0f, 0.0f, 0.0f }	// bounding boxes
+	};
+}
+
+DebugDrawer::DebugDrawer() : m_numLines(0), m_maxLines(0), m_numSkipped(0), m_firstLine(0), m_debugMode(0), m_cameraID(0),
+	m_categories(0), m_materialRes(0), m_aspect(1.0f)
+{
+}
+
+void DebugDrawer::setup(int cameraID, int categories, H3DRes materialRes, int maxLines)
+{
+	m_cameraID = cameraID;
+	m_categories = categories;
+	m_materialRes = materialRes;
+	m_maxLines = maxLines > 0 ? maxLines : 0;
+	m_vertices.resize(m_maxLines * 16);
+}
+
+void DebugDrawer::draw(btDiscreteDynamicsWorld* world, btActionInterface* const* actions, int numActions)
+{
+	using namespace Horde3DPhysics;
+
+	const float* camera = 0;
+	h3dGetNodeTransMats(m_cameraID, 0, &camera);
+	if (!camera || m_maxLines == 0)
+		return;
+	float projection[16];
+	h3dGetCameraProjMat(m_cameraID, projection);
+	m_viewProjection = Matrix4f(projection) * Matrix4f(camera).inverted();
+	const Matrix4f& m = m_viewProjection;
+	for (int i = 0; i < 3; ++i)
+	{
+		m_frustum[i*2] = Plane(m.c[0][3] + m.c[0][i], m.c[1][3] + m.c[1][i], m.c[2][3] + m.c[2][i], m.c[3][3] + m.c[3][i]);
+		m_frustum[i*2+1] = Plane(m.c[0][3] - m.c[0][i], m.c[1][3] - m.c[1][i], m.c[2][3] - m.c[2][i], m.c[3][3] - m.c[3][i]);
+	}
+	const int viewportHeight = h3dGetNodeParamI(m_cameraID, H3DCamera::ViewportHeightI);
+	m_aspect = viewportHeight > 0 ? (float) h3dGetNodeParamI(m_cameraID, H3DCamera::ViewportWidthI) / viewportHeight : 1.0f;
+	m_numLines = m_numSkipped = m_firstLine = 0;
+
+	// Contacts and constraints are few and most informative, they are drawn first
+	if (m_categories & DebugDrawCategories::Contacts)
+	{
+		m_debugMode = DBG_DrawContactPoints;
+		btDispatcher* dispatcher = world->getDispatcher();
+		for (int i = 0; i < dispatcher->getNumManifolds() && getDebugMode(); ++i)
+		{
+			const btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+			for (int j = 0; j < manifold->getNumContacts(); ++j)
+			{
+				const btManifoldPoint& point = manifold->getContactPoint(j);
+				drawContactPoint(point.m_positionWorldOnB, point.m_normalWorldOnB, point.getDistance(), point.getLifeTime(), btVector3(1, 1, 0));
+			}
+		}
+		flush(Contacts);
+	}
+	if (m_categories & DebugDrawCategories::Constraints)
+	{
+		m_debugMode = DBG_DrawConstraints | DBG_DrawConstraintLimits;
+		for (int i = 0; i < world->getNumConstraints() && getDebugMode(); ++i)
+			world->debugDrawConstraint(world->getConstraint(i));
+		flush(Constraints);
+	}
+
+	// Shapes are drawn in two passes, the color tells if they are sleeping
+	if (m_categories & DebugDrawCategories::Shapes)
+	{
+		m_debugMode = DBG_DrawWireframe;
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			const btCollisionObjectArray& objects = world->getCollisionObjectArray();
+			for (int i = 0; i < objects.size() && getDebugMode(); ++i)
+			{
+				const btCollisionObject* object = objects[i];
+				const btBroadphaseProxy* proxy = object->getBroadphaseHandle();
+				if (object->isActive() != (pass == 0) || (object->getCollisionFlags() & btCollisionObject::CF_DISABLE_VISUALIZE_OBJECT) ||
+					!proxy || !isVisible(proxy->m_aabbMin, proxy->m_aabbMax))
+					continue;
+				world->debugDrawObject(object->getWorldTransform(), object->getCollisionShape(), btVector3(1, 1, 1));
+			}
+			// vehicles and characters
+			if (pass == 0)
+			{
+				for (int i = 0; i < numActions && getDebugMode(); ++i)
+					actions[i]->debugDraw(this);
+			}
+			flush(pass == 0 ? ActiveShapes : SleepingShapes);
+		}
+	}
+	if (m_categories & DebugDrawCategories::Aabbs)
+	{
+		m_debugMode = DBG_DrawAabb;
+		const btCollisionObjectArray& objects = world->getCollisionObjectArray();
+		for (int i = 0; i < objects.size() && getDebugMode(); ++i)
+		{
+			const btBroadphaseProxy* proxy = objects[i]->getBroadphaseHandle();
+			if (proxy && isVisible(proxy->m_aabbMin, proxy->m_aabbMax))
+				drawAabb(proxy->m_aabbMin, proxy->m_aabbMax, btVector3(1, 0, 0));
+		}
+		flush(Aabbs);
+	}
+	// the world queries the mode while simulating
+	m_debugMode = 0;
+}
+
+void DebugDrawer::drawLine(const btVector3& from, const btVector3& to, const btVector3& /*color*/)
+{
+	if (m_numLines >= m_maxLines)
+	{
+		++m_numSkipped;
+		return;
+	}
+
+	float clip[2][4];
+	project(from, clip[0]);
+	project(to, clip[1]);
+	// Clipping against the near plane, the rest of the screen is clipped by the rasterizer
+	const float d0 = clip[0][2] + clip[0][3], d1 = clip[1][2] + clip[1][3];
+	if (d0 < 0 && d1 < 0)
+		return;
+	if (d0 < 0 || d1 < 0)
+	{
+		const float t = d0 / (d0 - d1);
+		float* behind = d0 < 0 ? clip[0] : clip[1];
+		for (int i = 0; i < 4; ++i)
+			behind[i] = clip[0][i] + t * (clip[1][i] - clip[0][i]);
+	}
+
+	// Overlay coordinates have their origin at the top left corner and reach from 0 to the aspect ratio horizontally
+	float x[2], y[2];
+	for (int i = 0; i < 2; ++i)
+	{
+		const float w = clip[i][3] > 1e-6f ? clip[i][3] : 1e-6f;
+		x[i] = (clip[i][0] / w * 0.5f + 0.5f) * m_aspect;
+		y[i] = 0.5f - clip[i][1] / w * 0.5f;
+	}
+	if ((x[0] < 0 && x[1] < 0) || (x[0] > m_aspect && x[1] > m_aspect) || (y[0] < 0 && y[1] < 0) || (y[0] > 1 && y[1] > 1))
+		return;
+
+	// the quad is extruded to the left of the line, which keeps the winding of all quads equal
+	float dx = x[1] - x[0], dy = y[1] - y[0];
+	const float length = sqrtf(dx * dx + dy * dy);
+	if (length < 1e-6f)
+		dx = 1, dy = 0;
+	else
+		dx /= length, dy /= length;
+	const float nx = -dy * LineWidth * 0.5f, ny = dx * LineWidth * 0.5f;
+	float* v = &m_vertices[m_numLines * 16];
+	v[0] = x[0] + nx; v[1] = y[0] + ny; v[2] = 0; v[3] = 0;
+	v[4] = x[1] + nx; v[5] = y[1] + ny; v[6] = 0; v[7] = 0;
+	v[8] = x[1] - nx; v[9] = y[1] - ny; v[10] = 0; v[11] = 0;
+	v[12] = x[0] - nx; v[13] = y[0] - ny; v[14] = 0; v[15] = 0;
+	++m_numLines;
+}
+
+void DebugDrawer::drawContactPoint(const btVector3& pointOnB, const btVector3& normalOnB, btScalar /*distance*/, int /*lifeTime*/, const btVector3& color)
+{
+	const btVector3 size(ContactSize, ContactSize, ContactSize);
+	if (!isVisible(pointOnB - size, pointOnB + size))
+		return;
+	drawLine(pointOnB - btVector3(ContactSize, 0, 0), pointOnB + btVector3(ContactSize, 0, 0), color);
+	drawLine(pointOnB - btVector3(0, 0, ContactSize), pointOnB + btVector3(0, 0, ContactSize), color);
+	drawLine(pointOnB, pointOnB + normalOnB * (ContactSize * 4), color);
+}
+
+void DebugDrawer::reportErrorWarning(const char* warningString)
+{
+	printf("%s\n", warningString);
+}
+
+void DebugDrawer::flush(Category category)
+{
+	if (m_numLines > m_firstLine)
+	{
+		const float* color = CategoryColors[category];
+		h3dShowOverlays(&m_vertices[m_firstLine * 16], (m_numLines - m_firstLine) * 4, color[0], color[1], color[2], 1.0f, m_materialRes, 0);
+	}
+	m_firstLine = m_numLines;
+}
+
+bool DebugDrawer::isVisible(const btVector3& aabbMin, const btVector3& aabbMax) const
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		// corner furthest along the plane normal
+		const Vec3f corner(m_frustum[i].normal.x >= 0 ? aabbMax.x() : aabbMin.x(),
+			m_frustum[i].normal.y >= 0 ? aabbMax.y() : aabbMin.y(),
+			m_frustum[i].normal.z >= 0 ? aabbMax.z() : aabbMin.z());
+		if (m_frustum[i].distToPoint(corner) < 0)
+			return false;
+	}
+	return true;
+}
+
+void DebugDrawer::project(const btVector3& point, float* clip) const
+{
+	const Matrix4f& m = m_viewProjection;
+	for (int i = 0; i < 4; ++i)
+		clip[i] = m.c[0][i] * point.x() + m.c[1][i] * point.y() + m.c[2][i] * point.z() + m.c[3][i];
+}
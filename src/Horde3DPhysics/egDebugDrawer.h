@@ -0,0 +1,104 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <Horde3D/Horde3D.h>
+#include <Horde3D/utMath.h>
+#include <vector>
+#include <Bullet/btBulletDynamicsCommon.h>
+
+/**
+ * \brief Draws the physics world as a single batch of Horde3D overlays
+ *
+ * The lines are projected by the camera and written as thin quads into a vertex buffer that is allocated
+ * once for the line budget. The world is drawn in one pass for each category, so the lines of a category
+ * are contiguous and shown by a single h3dShowOverlays call in the color of the category. Objects outside
+ * the camera frustum are skipped, once the budget is used up the remaining objects are skipped as well.
+ */
+class DebugDrawer : public btIDebugDraw
+{
+public:
+	/// Draw passes, each category is drawn in its own color
+	enum Category { Contacts, Constraints, ActiveShapes, SleepingShapes, Aabbs, NumCategories };
+
+	DebugDrawer();
+
+	/**
+	 * Configures the debug view
+	 * @param cameraID camera node the lines are projected with
+	 * @param categories Horde3DPhysics::DebugDrawCategories flags
+	 * @param materialRes overlay material
+	 * @param maxLines number of lines drawn at most per frame, the vertex buffer is resized to fit them
+	 */
+	void setup(int cameraID, int categories, H3DRes materialRes, int maxLines);
+
+	/**
+	 * Draws the world and shows the lines as overlays, which have to be removed with h3dClearOverlays
+	 * @param world the physics world
+	 * @param actions actions drawn along with the active shapes
+	 * @param numActions number of actions
+	 */
+	void draw(btDiscreteDynamicsWorld* world, btActionInterface* const* actions, int numActions);
+
+	/// Returns the number of lines that didn't fit into the budget during the last draw call
+	int numSkippedLines() const { return m_numSkipped; }
+
+	virtual void drawLine(const btVector3& from, const btVector3& to, const btVector3& color);
+	virtual void drawContactPoint(const btVector3& pointOnB, const btVector3& normalOnB, btScalar distance, int lifeTime, const btVector3& color);
+	virtual void reportErrorWarning(const char* warningString);
+	virtual void draw3dText(const btVector3&, const char*) {}
+	virtual void setDebugMode(int debugMode) { m_debugMode = debugMode; }
+	/// Returns 0 outside of draw and once the budget is used up, so Bullet skips its own debug drawing
+	virtual int getDebugMode() const { return m_numLines < m_maxLines ? m_debugMode : 0; }
+
+private:
+	/// Shows the lines written since the last call in the color of the category
+	void flush(Category category);
+
+	/// Tests a bounding box against the camera frustum
+	bool isVisible(const btVector3& aabbMin, const btVector3& aabbMax) const;
+
+	/// Projects a point into clip space
+	void project(const btVector3& point, float* clip) const;
+
+	/// Quads of the lines, four vertices of (x, y, u, v) for each line
+	std::vector<float>		m_vertices;
+	int						m_numLines;
+	int						m_maxLines;
+	int						m_numSkipped;
+	/// First line of the category that is being drawn
+	int						m_firstLine;
+	int						m_debugMode;
+
+	int						m_cameraID;
+	int						m_categories;
+	H3DRes					m_materialRes;
+	/// View projection matrix of the camera and the planes of its frustum, normals pointing inside
+	Horde3D::Matrix4f		m_viewProjection;
+	Horde3D::Plane			m_frustum[6];
+	/// Width of the overlay coordinate system
+	float					m_aspect;
+};
@@ -0,0 +1,60 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egIslandUnion.h"
+#include <algorithm>
+
+using namespace std;
+
+void IslandUnion::reset(int numIslands)
+{
+	m_parents.resize(numIslands);
+	for (int i = 0; i < numIslands; ++i)
+		m_parents[i] = i;
+	m_bodies.clear();
+}
+
+void IslandUnion::share(int island, const void* body)
+{
+	map<const void*, int>::iterator iter = m_bodies.find(body);
+	if (iter == m_bodies.end())
+	{
+		m_bodies[body] = island;
+		return;
+	}
+	// the smaller index becomes the representative, so groups keep the island order
+	const int a = find(iter->second), b = find(island);
+	m_parents[max(a, b)] = min(a, b);
+}
+
+int IslandUnion::find(int island)
+{
+	while (m_parents[island] != island)
+	{
+		m_parents[island] = m_parents[m_parents[island]];
+		island = m_parents[island];
+	}
+	return island;
+}
@@ -0,0 +1,59 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <vector>
+#include <map>
+
+/**
+ * \brief Union find merging the simulation islands that share a body
+ *
+ * The islands solved in parallel by the ParallelDynamicsWorld are merged when they touch the same kinematic 
+ * body. A group is always represented by the smallest index of its islands, so the groups and their order 
+ * don't depend on the order in which the shared bodies are reported.
+ */
+class IslandUnion
+{
+public:
+	/// Puts each of the given number of islands into a group of its own
+	void reset(int numIslands);
+
+	/**
+	 * Records a body touched by an island, the islands touching the same body are merged
+	 * @param island index of the island
+	 * @param body the shared body
+	 */
+	void share(int island, const void* body);
+
+	/// Returns the group of an island, which is the smallest index of the islands in the group
+	int find(int island);
+
+private:
+	/// Parent of each island, the representatives are their own parents
+	std::vector<int>			m_parents;
+	/// First island that has touched each body
+	std::map<const void*, int>	m_bodies;
+};
@@ -0,0 +1,310 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egParallelDispatcher.h"
+#include <Bullet/BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h>
+#include <Bullet/LinearMath/btPoolAllocator.h>
+#include <algorithm>
+
+using namespace std;
+
+SafeConvexConvexAlgorithm::SafeConvexConvexAlgorithm(btPersistentManifold* mf, const btCollisionAlgorithmConstructionInfo& ci, 
+	const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, btConvexPenetrationDepthSolver* pdSolver, 
+	int numPerturbationIterations, int minimumPointsPerturbationThreshold) : 
+	// the base class only stores the pointer to the simplex solver
+	btConvexConvexAlgorithm(mf, ci, body0Wrap, body1Wrap, &m_ownSimplexSolver, pdSolver, numPerturbationIterations, minimumPointsPerturbationThreshold)
+{
+}
+
+btCollisionAlgorithm* SafeConvexConvexAlgorithm::CreateFunc::CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, 
+	const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap)
+{
+	void* mem = ci.m_dispatcher1->allocateCollisionAlgorithm(sizeof(SafeConvexConvexAlgorithm));
+	return new(mem) SafeConvexConvexAlgorithm(ci.m_manifold, ci, body0Wrap, body1Wrap, m_settings->m_pdSolver, 
+		m_settings->m_numPerturbationIterations, m_settings->m_minimumPointsPerturbationThreshold);
+}
+
+ParallelCollisionConfiguration::ParallelCollisionConfiguration()
+{
+	void* mem = btAlignedAlloc(sizeof(SafeConvexConvexAlgorithm::CreateFunc), 16);
+	m_safeConvexConvexCreateFunc = new(mem) SafeConvexConvexAlgorithm::CreateFunc(
+		static_cast<btConvexConvexAlgorithm::CreateFunc*>(m_convexConvexCreateFunc));
+}
+
+ParallelCollisionConfiguration::~ParallelCollisionConfiguration()
+{
+	m_safeConvexConvexCreateFunc->~btCollisionAlgorithmCreateFunc();
+	btAlignedFree(m_safeConvexConvexCreateFunc);
+}
+
+btCollisionAlgorithmCreateFunc* ParallelCollisionConfiguration::getCollisionAlgorithmCreateFunc(int proxyType0, int proxyType1)
+{
+	btCollisionAlgorithmCreateFunc* createFunc = btDefaultCollisionConfiguration::getCollisionAlgorithmCreateFunc(proxyType0, proxyType1);
+	return createFunc == m_convexConvexCreateFunc ? m_safeConvexConvexCreateFunc : createFunc;
+}
+
+ParallelCollisionDispatcher::ParallelCollisionDispatcher(btCollisionConfiguration* configuration) : btCollisionDispatcher(configuration),
+	m_scheduler(0), m_processing(false)
+{
+	setScheduler(0);
+}
+
+ParallelCollisionDispatcher::~ParallelCollisionDispatcher()
+{
+	for (unsigned int i = 0; i < m_threadData.size(); ++i)
+	{
+		delete m_threadData[i]->manifoldPool;
+		delete m_threadData[i]->algorithmPool;
+		delete m_threadData[i];
+	}
+}
+
+void ParallelCollisionDispatcher::setScheduler(Horde3DPhysics::ITaskScheduler* scheduler)
+{
+	m_scheduler = scheduler;
+	// Existing pools are kept, they still contain the manifolds and algorithms of the current pairs
+	const int numThreads = m_scheduler ? m_scheduler->numThreadIndices() : 1;
+	const int numManifolds = max(m_persistentManifoldPoolAllocator->getMaxCount() / numThreads, 256);
+	const int numAlgorithms = max(m_collisionAlgorithmPoolAllocator->getMaxCount() / numThreads, 256);
+	// pool elements have to be aligned like the first one
+	const int algorithmSize = (max(m_collisionAlgorithmPoolAllocator->getElementSize(), (int) sizeof(SafeConvexConvexAlgorithm)) + 15) & ~15;
+	const int manifoldSize = (int) (sizeof(btPersistentManifold) + 15) & ~15;
+	while ((int) m_threadData.size() < numThreads)
+	{
+		ThreadData* data = new ThreadData();
+		data->manifoldPool = new btPoolAllocator(manifoldSize, numManifolds);
+		data->algorithmPool = new btPoolAllocator(algorithmSize, numAlgorithms);
+		data->pair = data->sequence = 0;
+		m_threadData.push_back(data);
+	}
+}
+
+ParallelCollisionDispatcher::ThreadData& ParallelCollisionDispatcher::threadData()
+{
+	return *m_threadData[m_scheduler ? m_scheduler->threadIndex() : 0];
+}
+
+btPersistentManifold* ParallelCollisionDispatcher::getNewManifold(const btCollisionObject* body0, const btCollisionObject* body1)
+{
+	// same thresholds as btCollisionDispatcher
+	const btScalar contactBreakingThreshold = (m_dispatcherFlags & CD_USE_RELATIVE_CONTACT_BREAKING_THRESHOLD) ?
+		btMin(body0->getCollisionShape()->getContactBreakingThreshold(gContactBreakingThreshold), 
+			body1->getCollisionShape()->getContactBreakingThreshold(gContactBreakingThreshold)) : gContactBreakingThreshold;
+	const btScalar contactProcessingThreshold = btMin(body0->getContactProcessingThreshold(), body1->getContactProcessingThreshold());
+
+	ThreadData& data = threadData();
+	void* mem = 0;
+	if (data.manifoldPool->getFreeCount())
+		mem = data.manifoldPool->allocate(sizeof(btPersistentManifold));
+	else if ((m_dispatcherFlags & CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION) == 0)
+		mem = btAlignedAlloc(sizeof(btPersistentManifold), 16);
+	else
+	{
+		btAssert(0);
+		return 0;
+	}
+	btPersistentManifold* manifold = new(mem) btPersistentManifold(body0, body1, 0, contactBreakingThreshold, contactProcessingThreshold);
+
+	if (m_processing)
+	{
+		PendingManifold pending = { data.pair, data.sequence++, manifold };
+		data.created.push_back(pending);
+		manifold->m_index1a = -1;
+	}
+	else
+	{
+		manifold->m_index1a = m_manifoldsPtr.size();
+		m_manifoldsPtr.push_back(manifold);
+	}
+	return manifold;
+}
+
+void ParallelCollisionDispatcher::releaseManifold(btPersistentManifold* manifold)
+{
+	clearManifold(manifold);
+	if (m_processing)
+	{
+		ThreadData& data = threadData();
+		// manifolds created while processing the same pair have not been added to the manifold array yet
+		for (unsigned int i = 0; i < data.created.size(); ++i)
+		{
+			if (data.created[i].manifold == manifold)
+			{
+				data.created.erase(data.created.begin() + i);
+				manifold->~btPersistentManifold();
+				freeMemory(manifold, true);
+				return;
+			}
+		}
+		PendingManifold pending = { data.pair, data.sequence++, manifold };
+		data.released.push_back(pending);
+		return;
+	}
+
+	const int index = manifold->m_index1a;
+	m_manifoldsPtr.swap(index, m_manifoldsPtr.size() - 1);
+	m_manifoldsPtr[index]->m_index1a = index;
+	m_manifoldsPtr.pop_back();
+	manifold->~btPersistentManifold();
+	freeMemory(manifold, true);
+}
+
+void* ParallelCollisionDispatcher::allocateCollisionAlgorithm(int size)
+{
+	btPoolAllocator* pool = threadData().algorithmPool;
+	if (pool->getFreeCount() > 0 && size <= pool->getElementSize())
+		return pool->allocate(size);
+	return btAlignedAlloc(static_cast<size_t>(size), 16);
+}
+
+void ParallelCollisionDispatcher::freeCollisionAlgorithm(void* ptr)
+{
+	freeMemory(ptr, false);
+}
+
+void ParallelCollisionDispatcher::freeMemory(void* ptr, bool manifold)
+{
+	ThreadData* own = m_processing ? &threadData() : 0;
+	for (unsigned int i = 0; i < m_threadData.size(); ++i)
+	{
+		ThreadData* data = m_threadData[i];
+		btPoolAllocator* pool = manifold ? data->manifoldPool : data->algorithmPool;
+		if (!pool->validPtr(ptr))
+			continue;
+		// The pools of other threads must not be changed while the workers are running. Manifolds are only
+		// freed by the workers if they have been created while processing the same pair.
+		if (own && own != data)
+		{
+			btAssert(!manifold);
+			own->algorithmFrees.push_back(ptr);
+		}
+		else
+			pool->freeMemory(ptr);
+		return;
+	}
+	btAlignedFree(ptr);
+}
+
+namespace
+{
+	bool isTrigger(const btCollisionObject* object)
+	{
+		return object->getInternalType() == btCollisionObject::CO_GHOST_OBJECT && !object->hasContactResponse();
+	}
+}
+
+bool ParallelCollisionDispatcher::needsCollision(const btCollisionObject* body0, const btCollisionObject* body1)
+{
+	if (isTrigger(body0) || isTrigger(body1))
+		return false;
+	return btCollisionDispatcher::needsCollision(body0, body1);
+}
+
+void ParallelCollisionDispatcher::dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& dispatchInfo, btDispatcher* dispatcher)
+{
+#ifdef HORDEPHYSICS_BULLET_NO_PROFILE
+	const bool parallel = m_scheduler && dispatchInfo.m_dispatchFunc == btDispatcherInfo::DISPATCH_DISCRETE &&
+		!pairCache->hasDeferredRemoval() && getNearCallback() == defaultNearCallback;
+#else
+	// Bullet's profiler is not thread safe
+	const bool parallel = false;
+#endif
+	if (!parallel)
+	{
+		btCollisionDispatcher::dispatchAllCollisionPairs(pairCache, dispatchInfo, dispatcher);
+		return;
+	}
+
+	// Algorithms of new pairs are created in the order of the pairs, their manifolds are added right away
+	btBroadphasePairArray& pairs = pairCache->getOverlappingPairArray();
+	m_pairs.resize(0);
+	for (int i = 0; i < pairs.size(); ++i)
+	{
+		btBroadphasePair& pair = pairs[i];
+		btCollisionObject* colObj0 = (btCollisionObject*) pair.m_pProxy0->m_clientObject;
+		btCollisionObject* colObj1 = (btCollisionObject*) pair.m_pProxy1->m_clientObject;
+		if (!needsCollision(colObj0, colObj1))
+			continue;
+		if (!pair.m_algorithm)
+		{
+			btCollisionObjectWrapper obj0Wrap(0, colObj0->getCollisionShape(), colObj0, colObj0->getWorldTransform(), -1, -1);
+			btCollisionObjectWrapper obj1Wrap(0, colObj1->getCollisionShape(), colObj1, colObj1->getWorldTransform(), -1, -1);
+			pair.m_algorithm = findAlgorithm(&obj0Wrap, &obj1Wrap);
+		}
+		if (pair.m_algorithm)
+			m_pairs.push_back(&pair);
+	}
+
+	m_processing = true;
+	const int grainSize = max(m_pairs.size() / (4 * m_scheduler->numThreadIndices()), 64);
+	parallelFor(m_scheduler, m_pairs.size(), grainSize, [this, &dispatchInfo](int begin, int end, int)
+	{
+		ThreadData& data = threadData();
+		for (int i = begin; i < end; ++i)
+		{
+			btBroadphasePair& pair = *m_pairs[i];
+			data.pair = i;
+			data.sequence = 0;
+			btCollisionObject* colObj0 = (btCollisionObject*) pair.m_pProxy0->m_clientObject;
+			btCollisionObject* colObj1 = (btCollisionObject*) pair.m_pProxy1->m_clientObject;
+			btCollisionObjectWrapper obj0Wrap(0, colObj0->getCollisionShape(), colObj0, colObj0->getWorldTransform(), -1, -1);
+			btCollisionObjectWrapper obj1Wrap(0, colObj1->getCollisionShape(), colObj1, colObj1->getWorldTransform(), -1, -1);
+			btManifoldResult contactPointResult(&obj0Wrap, &obj1Wrap);
+			pair.m_algorithm->processCollision(&obj0Wrap, &obj1Wrap, dispatchInfo, &contactPointResult);
+		}
+	});
+	m_processing = false;
+
+	applyPendingChanges();
+}
+
+void ParallelCollisionDispatcher::applyPendingChanges()
+{
+	// Released manifolds are removed first, both in the order of the pairs
+	m_pendingLists.clear();
+	for (unsigned int i = 0; i < m_threadData.size(); ++i)
+		m_pendingLists.push_back(&m_threadData[i]->released);
+	mergePendingManifolds(m_pendingLists, m_pending);
+	for (unsigned int i = 0; i < m_pending.size(); ++i)
+		releaseManifold(m_pending[i].manifold);
+
+	m_pendingLists.clear();
+	for (unsigned int i = 0; i < m_threadData.size(); ++i)
+		m_pendingLists.push_back(&m_threadData[i]->created);
+	mergePendingManifolds(m_pendingLists, m_pending);
+	for (unsigned int i = 0; i < m_pending.size(); ++i)
+	{
+		m_pending[i].manifold->m_index1a = m_manifoldsPtr.size();
+		m_manifoldsPtr.push_back(m_pending[i].manifold);
+	}
+
+	for (unsigned int i = 0; i < m_threadData.size(); ++i)
+	{
+		vector<void*>& frees = m_threadData[i]->algorithmFrees;
+		for (unsigned int j = 0; j < frees.size(); ++j)
+			freeMemory(frees[j], false);
+		frees.clear();
+	}
+}
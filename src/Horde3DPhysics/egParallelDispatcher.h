@@ -0,0 +1,147 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <vector>
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <Bullet/BulletCollision/CollisionDispatch/btConvexConvexAlgorithm.h>
+#include <Bullet/BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h>
+
+#include "egTaskScheduler.h"
+#include "egPendingManifold.h"
+
+/**
+ * \brief Convex collision algorithm with its own simplex solver
+ *
+ * btConvexConvexAlgorithm shares the simplex solver of the collision configuration between all pairs, 
+ * so it can't be used by several threads at the same time.
+ */
+class SafeConvexConvexAlgorithm : public btConvexConvexAlgorithm
+{
+public:
+	SafeConvexConvexAlgorithm(btPersistentManifold* mf, const btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap, 
+		const btCollisionObjectWrapper* body1Wrap, btConvexPenetrationDepthSolver* pdSolver, int numPerturbationIterations, int minimumPointsPerturbationThreshold);
+
+	/// Creates SafeConvexConvexAlgorithms with the settings of the configuration's btConvexConvexAlgorithm::CreateFunc
+	struct CreateFunc : public btCollisionAlgorithmCreateFunc
+	{
+		btConvexConvexAlgorithm::CreateFunc*	m_settings;
+
+		CreateFunc(btConvexConvexAlgorithm::CreateFunc* settings) : m_settings(settings) {}
+
+		virtual btCollisionAlgorithm* CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap, 
+			const btCollisionObjectWrapper* body1Wrap);
+	};
+
+private:
+	btVoronoiSimplexSolver	m_ownSimplexSolver;
+};
+
+/**
+ * \brief Collision configuration whose algorithms can be processed by several threads at the same time
+ */
+class ParallelCollisionConfiguration : public btDefaultCollisionConfiguration
+{
+public:
+	ParallelCollisionConfiguration();
+	virtual ~ParallelCollisionConfiguration();
+
+	virtual btCollisionAlgorithmCreateFunc* getCollisionAlgorithmCreateFunc(int proxyType0, int proxyType1);
+
+private:
+	btCollisionAlgorithmCreateFunc*	m_safeConvexConvexCreateFunc;
+};
+
+/**
+ * \brief Collision dispatcher processing the overlapping pairs on worker threads
+ *
+ * The collision algorithms of new pairs are created on the calling thread, afterwards the pairs are split 
+ * into chunks processed by the threads of an ITaskScheduler. Each thread allocates manifolds and algorithms
+ * from its own pools. Manifolds created or released by the workers are added to or removed from the manifold
+ * array after all pairs have been processed, in the order of their pairs, so the manifold order does not
+ * depend on the number of threads.
+ *
+ * Requires a ParallelCollisionConfiguration and the HORDEPHYSICS_BULLET_NO_PROFILE build option described in 
+ * egParallelDynamicsWorld.h, otherwise the pairs are processed like by btCollisionDispatcher.
+ */
+class ParallelCollisionDispatcher : public btCollisionDispatcher
+{
+public:
+	ParallelCollisionDispatcher(btCollisionConfiguration* configuration);
+	virtual ~ParallelCollisionDispatcher();
+
+	/**
+	 * Sets the thread pool the pairs are processed on
+	 * @param scheduler the scheduler or 0 to process the pairs on the calling thread
+	 */
+	void setScheduler(Horde3DPhysics::ITaskScheduler* scheduler);
+
+	virtual btPersistentManifold* getNewManifold(const btCollisionObject* body0, const btCollisionObject* body1);
+	virtual void releaseManifold(btPersistentManifold* manifold);
+	virtual void* allocateCollisionAlgorithm(int size);
+	virtual void freeCollisionAlgorithm(void* ptr);
+	virtual void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& dispatchInfo, btDispatcher* dispatcher);
+	/// Skips the pairs of trigger volumes, ghost objects without contact response only track broadphase overlaps
+	virtual bool needsCollision(const btCollisionObject* body0, const btCollisionObject* body1);
+
+private:
+	/// Allocators and pending changes of a single thread
+	struct ThreadData
+	{
+		btPoolAllocator*				manifoldPool;
+		btPoolAllocator*				algorithmPool;
+		/// Pair processed by the thread and number of manifold changes within that pair
+		int								pair;
+		int								sequence;
+		std::vector<PendingManifold>	created;
+		std::vector<PendingManifold>	released;
+		/// Algorithms allocated from the pool of another thread
+		std::vector<void*>				algorithmFrees;
+	};
+
+	/// Returns the data of the calling thread
+	ThreadData& threadData();
+
+	/**
+	 * Releases the memory of a manifold or an algorithm
+	 * @param ptr the memory
+	 * @param manifold true if ptr is a manifold, false for an algorithm
+	 */
+	void freeMemory(void* ptr, bool manifold);
+
+	/// Applies the manifold changes of the workers after all pairs have been processed
+	void applyPendingChanges();
+
+	Horde3DPhysics::ITaskScheduler*		m_scheduler;
+	std::vector<ThreadData*>				m_threadData;
+	/// True while the workers process the pairs
+	bool									m_processing;
+	/// Pairs with a collision algorithm that are processed by the workers
+	btAlignedObjectArray<btBroadphasePair*>	m_pairs;
+	std::vector<PendingManifold>			m_pending;
+	/// Created or released manifolds of each thread, merged into m_pending
+	std::vector<std::vector<PendingManifold>*>	m_pendingLists;
+};
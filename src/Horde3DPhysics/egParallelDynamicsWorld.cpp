@@ -0,0 +1,216 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egParallelDynamicsWorld.h"
+#include <algorithm>
+
+using namespace std;
+
+ParallelDynamicsWorld::ParallelDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* pairCache, btMultiBodyConstraintSolver* constraintSolver, 
+	btCollisionConfiguration* collisionConfiguration) : btMultiBodyDynamicsWorld(dispatcher, pairCache, constraintSolver, collisionConfiguration),
+	m_scheduler(0)
+{
+}
+
+ParallelDynamicsWorld::~ParallelDynamicsWorld()
+{
+	setScheduler(0);
+}
+
+void ParallelDynamicsWorld::setScheduler(Horde3DPhysics::ITaskScheduler* scheduler)
+{
+	for (unsigned int i = 0; i < m_solvers.size(); ++i)
+		delete m_solvers[i];
+	m_solvers.clear();
+	m_scheduler = scheduler;
+	if (m_scheduler)
+	{
+		for (int i = 0; i < m_scheduler->numThreadIndices(); ++i)
+			m_solvers.push_back(new btSequentialImpulseConstraintSolver());
+	}
+}
+
+void ParallelDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
+{
+#ifdef HORDEPHYSICS_BULLET_NO_PROFILE
+	// the multi body solver integrates the multi body velocities as well, it has to process all islands
+	if (m_scheduler && m_islandManager->getSplitIslands() && m_multiBodies.size() == 0 && m_multiBodyConstraints.size() == 0)
+	{
+		solveIslandsParallel(solverInfo);
+		return;
+	}
+#endif
+	btMultiBodyDynamicsWorld::solveConstraints(solverInfo);
+}
+
+void ParallelDynamicsWorld::IslandCollector::processIsland(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifolds, 
+	int numManifolds, int islandId)
+{
+	Island island;
+	island.bodyBegin = world->m_islandBodies.size();
+	island.numBodies = numBodies;
+	island.manifoldBegin = world->m_islandManifolds.size();
+	island.numManifolds = numManifolds;
+	island.constraintBegin = island.numConstraints = 0;
+	for (int i = 0; i < numBodies; ++i)
+		world->m_islandBodies.push_back(bodies[i]);
+	for (int i = 0; i < numManifolds; ++i)
+		world->m_islandManifolds.push_back(manifolds[i]);
+	world->m_islands.push_back(island);
+	world->m_islandIds.push_back(islandId);
+}
+
+void ParallelDynamicsWorld::solveIslandsParallel(btContactSolverInfo& solverInfo)
+{
+	m_islands.clear();
+	m_islandIds.clear();
+	m_islandBodies.resize(0);
+	m_islandManifolds.resize(0);
+	m_islandConstraints.resize(0);
+
+	IslandCollector collector;
+	collector.world = this;
+	m_islandManager->buildAndProcessIslands(getCollisionWorld()->getDispatcher(), getCollisionWorld(), &collector);
+	const int numIslands = (int) m_islands.size();
+	if (numIslands == 0)
+		return;
+
+	// Island ids are indices of collision objects
+	vector<int> islandIndices(getNumCollisionObjects(), -1);
+	for (int i = 0; i < numIslands; ++i)
+		islandIndices[m_islandIds[i]] = i;
+
+	// Constraints belong to the island of their first non static body, sorted by island
+	vector< pair<int, int> > constraintIslands;
+	for (int i = 0; i < m_constraints.size(); ++i)
+	{
+		btTypedConstraint* constraint = m_constraints[i];
+		if (!constraint->isEnabled())
+			continue;
+		const int islandId = constraint->getRigidBodyA().getIslandTag() >= 0 ? 
+			constraint->getRigidBodyA().getIslandTag() : constraint->getRigidBodyB().getIslandTag();
+		// constraints of sleeping islands are not solved
+		if (islandId >= 0 && islandIndices[islandId] >= 0)
+			constraintIslands.push_back(make_pair(islandIndices[islandId], i));
+	}
+	sort(constraintIslands.begin(), constraintIslands.end());
+	for (unsigned int i = 0; i < constraintIslands.size(); ++i)
+	{
+		Island& island = m_islands[constraintIslands[i].first];
+		if (island.numConstraints++ == 0)
+			island.constraintBegin = m_islandConstraints.size();
+		m_islandConstraints.push_back(m_constraints[constraintIslands[i].second]);
+	}
+
+	// Merge islands that share a kinematic body
+	m_islandUnion.reset(numIslands);
+	for (int i = 0; i < numIslands; ++i)
+	{
+		const Island& island = m_islands[i];
+		btAlignedObjectArray<const btCollisionObject*> shared;
+		for (int j = 0; j < island.numManifolds; ++j)
+		{
+			shared.push_back(m_islandManifolds[island.manifoldBegin + j]->getBody0());
+			shared.push_back(m_islandManifolds[island.manifoldBegin + j]->getBody1());
+		}
+		for (int j = 0; j < island.numConstraints; ++j)
+		{
+			shared.push_back(&m_islandConstraints[island.constraintBegin + j]->getRigidBodyA());
+			shared.push_back(&m_islandConstraints[island.constraintBegin + j]->getRigidBodyB());
+		}
+		for (int j = 0; j < shared.size(); ++j)
+		{
+			if (shared[j]->isKinematicObject())
+				m_islandUnion.share(i, shared[j]);
+		}
+	}
+
+	// Copy the islands of each group into contiguous sections, islands without contacts and constraints are skipped
+	m_groups.clear();
+	vector<int> groupIndices(numIslands, -1);
+	for (int i = 0; i < numIslands; ++i)
+	{
+		const Island& island = m_islands[i];
+		if (island.numManifolds + island.numConstraints == 0)
+			continue;
+		const int root = m_islandUnion.find(i);
+		if (groupIndices[root] < 0)
+		{
+			groupIndices[root] = (int) m_groups.size();
+			Island group = { 0, 0, 0, 0, 0, 0 };
+			m_groups.push_back(group);
+		}
+		Island& group = m_groups[groupIndices[root]];
+		group.numBodies += island.numBodies;
+		group.numManifolds += island.numManifolds;
+		group.numConstraints += island.numConstraints;
+	}
+	int bodyBegin = 0, manifoldBegin = 0, constraintBegin = 0;
+	for (unsigned int i = 0; i < m_groups.size(); ++i)
+	{
+		Island& group = m_groups[i];
+		group.bodyBegin = bodyBegin;
+		group.manifoldBegin = manifoldBegin;
+		group.constraintBegin = constraintBegin;
+		bodyBegin += group.numBodies;
+		manifoldBegin += group.numManifolds;
+		constraintBegin += group.numConstraints;
+		// used as fill positions below
+		group.numBodies = group.numManifolds = group.numConstraints = 0;
+	}
+	m_groupBodies.resize(bodyBegin);
+	m_groupManifolds.resize(manifoldBegin);
+	m_groupConstraints.resize(constraintBegin);
+	for (int i = 0; i < numIslands; ++i)
+	{
+		const Island& island = m_islands[i];
+		if (island.numManifolds + island.numConstraints == 0)
+			continue;
+		Island& group = m_groups[groupIndices[m_islandUnion.find(i)]];
+		for (int j = 0; j < island.numBodies; ++j)
+			m_groupBodies[group.bodyBegin + group.numBodies++] = m_islandBodies[island.bodyBegin + j];
+		for (int j = 0; j < island.numManifolds; ++j)
+			m_groupManifolds[group.manifoldBegin + group.numManifolds++] = m_islandManifolds[island.manifoldBegin + j];
+		for (int j = 0; j < island.numConstraints; ++j)
+			m_groupConstraints[group.constraintBegin + group.numConstraints++] = m_islandConstraints[island.constraintBegin + j];
+	}
+
+	// About four chunks per thread, stealing balances groups of different size
+	const int numGroups = (int) m_groups.size();
+	const int grainSize = max(numGroups / (4 * ((int) m_solvers.size())), 1);
+	parallelFor(m_scheduler, numGroups, grainSize, [this, &solverInfo](int begin, int end, int threadIndex)
+	{
+		btSequentialImpulseConstraintSolver* solver = m_solvers[threadIndex];
+		for (int i = begin; i < end; ++i)
+		{
+			const Island& group = m_groups[i];
+			solver->setRandSeed(0);
+			solver->solveGroup(group.numBodies ? &m_groupBodies[group.bodyBegin] : 0, group.numBodies, 
+				group.numManifolds ? &m_groupManifolds[group.manifoldBegin] : 0, group.numManifolds,
+				group.numConstraints ? &m_groupConstraints[group.constraintBegin] : 0, group.numConstraints,
+				solverInfo, m_debugDrawer, m_dispatcher1);
+		}
+	});
+}
@@ -0,0 +1,124 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <vector>
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <Bullet/BulletCollision/CollisionDispatch/btSimulationIslandManager.h>
+#include <Bullet/BulletDynamics/Featherstone/btMultiBodyDynamicsWorld.h>
+#include <Bullet/BulletDynamics/Featherstone/btMultiBodyConstraintSolver.h>
+
+#include "egTaskScheduler.h"
+#include "egIslandUnion.h"
+
+/**
+ * Build option: define HORDEPHYSICS_BULLET_NO_PROFILE for all sources of this library when it is linked against
+ * Bullet libraries built with BT_NO_PROFILE. Bullet's profiler is not thread safe and the Bullet libraries of the
+ * SDK are built with it, so without the option the narrowphase, the island solver and the vehicle rays stay serial.
+ * Bullet's headers have to match its libraries, so BT_NO_PROFILE has to be defined as well.
+ */
+#if defined(HORDEPHYSICS_BULLET_NO_PROFILE) && !defined(BT_NO_PROFILE)
+#error "HORDEPHYSICS_BULLET_NO_PROFILE requires BT_NO_PROFILE, Bullet's headers have to match its libraries"
+#endif
+
+/**
+ * \brief Dynamics world solving independent simulation islands in parallel
+ *
+ * The islands found by the btSimulationIslandManager are solved on the threads of an ITaskScheduler, each 
+ * thread using its own btSequentialImpulseConstraintSolver. Islands touching the same kinematic body are
+ * merged, since the solver stores temporary data in every non static body it processes. The result does 
+ * not depend on the number of threads or the execution order: islands are independent and each solver 
+ * starts with the same random seed.
+ *
+ * Bullet's profiler is not thread safe, so the islands are only solved in parallel if this library is 
+ * built with HORDEPHYSICS_BULLET_NO_PROFILE. Otherwise, and as long as the world contains multi bodies, the world behaves 
+ * like a btMultiBodyDynamicsWorld.
+ */
+ATTRIBUTE_ALIGNED16(class) ParallelDynamicsWorld : public btMultiBodyDynamicsWorld
+{
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	/**
+	 * Constructor
+	 * 
+	 * Parameters are the same as of btMultiBodyDynamicsWorld, they are not deleted by the world.
+	 */
+	ParallelDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* pairCache, btMultiBodyConstraintSolver* constraintSolver, 
+		btCollisionConfiguration* collisionConfiguration);
+	/// Destructor
+	virtual ~ParallelDynamicsWorld();
+
+	/**
+	 * Sets the thread pool the islands are solved on
+	 * @param scheduler the scheduler or 0 to solve all islands with the world's constraint solver
+	 */
+	void setScheduler(Horde3DPhysics::ITaskScheduler* scheduler);
+
+protected:
+	virtual void solveConstraints(btContactSolverInfo& solverInfo);
+
+private:
+	/// Section of the body, manifold and constraint arrays belonging to an island or a group of islands
+	struct Island
+	{
+		int	bodyBegin, numBodies;
+		int	manifoldBegin, numManifolds;
+		int	constraintBegin, numConstraints;
+	};
+
+	/// Collects the awake islands reported by the island manager
+	struct IslandCollector : public btSimulationIslandManager::IslandCallback
+	{
+		ParallelDynamicsWorld*	world;
+
+		void processIsland(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifolds, int numManifolds, int islandId);
+	};
+
+	/**
+	 * Collects the islands, merges the ones sharing kinematic bodies and solves them on the scheduler
+	 */
+	void solveIslandsParallel(btContactSolverInfo& solverInfo);
+
+	Horde3DPhysics::ITaskScheduler*			m_scheduler;
+	/// One solver for each thread index of the scheduler
+	std::vector<btSequentialImpulseConstraintSolver*>	m_solvers;
+
+	/// Awake islands of the current step
+	std::vector<Island>							m_islands;
+	std::vector<int>							m_islandIds;
+	btAlignedObjectArray<btCollisionObject*>	m_islandBodies;
+	btAlignedObjectArray<btPersistentManifold*>	m_islandManifolds;
+	btAlignedObjectArray<btTypedConstraint*>	m_islandConstraints;
+	/// Islands merged by the kinematic bodies they share
+	IslandUnion									m_islandUnion;
+
+	/// Merged islands, in the order of their first island
+	std::vector<Island>							m_groups;
+	btAlignedObjectArray<btCollisionObject*>	m_groupBodies;
+	btAlignedObjectArray<btPersistentManifold*>	m_groupManifolds;
+	btAlignedObjectArray<btTypedConstraint*>	m_groupConstraints;
+};
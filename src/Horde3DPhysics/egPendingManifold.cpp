@@ -0,0 +1,40 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egPendingManifold.h"
+#include <algorithm>
+
+using namespace std;
+
+void mergePendingManifolds(const vector<vector<PendingManifold>*>& lists, vector<PendingManifold>& merged)
+{
+	merged.clear();
+	for (unsigned int i = 0; i < lists.size(); ++i)
+	{
+		merged.insert(merged.end(), lists[i]->begin(), lists[i]->end());
+		lists[i]->clear();
+	}
+	sort(merged.begin(), merged.end());
+}
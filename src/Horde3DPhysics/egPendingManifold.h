@@ -0,0 +1,49 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <vector>
+
+class btPersistentManifold;
+
+/// Manifold created or released by a worker of the ParallelCollisionDispatcher, ordered by the pair it belongs to
+struct PendingManifold
+{
+	int						pair;
+	/// Number of manifold changes made before within the same pair
+	int						sequence;
+	btPersistentManifold*	manifold;
+
+	bool operator<(const PendingManifold& other) const { return pair < other.pair || (pair == other.pair && sequence < other.sequence); }
+};
+
+/**
+ * Moves the manifolds collected by the threads of a pass into a single array in the order of their pairs.
+ * A pair is processed by a single thread, so the result doesn't depend on how the pairs were distributed.
+ * @param lists the pending manifolds of each thread, they are cleared
+ * @param merged receives the manifolds sorted by pair and by sequence within a pair
+ */
+void mergePendingManifolds(const std::vector<std::vector<PendingManifold>*>& lists, std::vector<PendingManifold>& merged);
@@ -28,190 +28,350 @@
 // #include <Horde3d/Horde3DTerrain.h>
 #include <Horde3D/utMath.h>
 #include <algorithm>
-#include "utXmlParser.h"
 
 using namespace std;
 using namespace Horde3D;
 
-PhysicsNode::PhysicsNode(CollisionShape shape, int hordeID) : 
-m_motionState(0), m_collisionShape(0), m_btTriangleMesh(0), m_rigidBody(0), m_selfUpdate(false), m_hordeID(hordeID)
+PhysicsNode::PhysicsNode(CollisionShape shape, int hordeID) : m_shape(shape), m_cookState(Gathered),
+m_motionState(0), m_rigidBody(0), m_collisionShape(0), m_sharedShape(false), m_hordeID(hordeID),
+m_lodAsleep(false), m_lodTouching(false), m_lodSkipped(0), m_updateDeferred(false), m_visibilityMargin(0)
 {
+	// Create initial transformation without scale
+	const float* x = 0;
+	h3dGetNodeTransMats(m_hordeID, 0, &x);
+	Matrix4f objTrans( x );	
+	Vec3f t, r, s;
+	objTrans.decompose(t, r, s);
+	objTrans.scale( 1.0f / s.x, 1.0f / s.y, 1.0f / s.z );
+	memcpy(m_startTransformation, objTrans.x, sizeof(m_startTransformation));
+	m_scaling[0] = s.x; m_scaling[1] = s.y; m_scaling[2] = s.z;
+	// changes made before the node has been created are part of the start transformation
+	h3dCheckNodeTransFlag(m_hordeID, true);
+	// the first pose read always counts as changed
+	memset(m_pose, 0, sizeof(m_pose));
+	memset(m_cookingShift, 0, sizeof(m_cookingShift));
+	memset(m_deferredBounds, 0, sizeof(m_deferredBounds));
+
+	if (shape.compound)
+	{
+		// One compound shape for all meshes of the model: local transforms are relative to the model node
+		gatherChildShapes(m_hordeID, Matrix4f(x).inverted());
+		if (m_recipes.empty())
+			printf("The compound physics representation doesn't contain any mesh\n");
+		return;
+	}
+
+	ShapeRecipe recipe;
+	recipe.type = shape.type;
 	switch (shape.type)
 	{
 	case CollisionShape::Box: // Bounding Box Shape
-		m_collisionShape = new btBoxShape(btVector3(shape.extents[0], shape.extents[1],shape.extents[2]));
+		memcpy(recipe.extents, shape.extents, sizeof(recipe.extents));
 		break;
 	case CollisionShape::Sphere: // Sphere Shape			
-		m_collisionShape = new btSphereShape(shape.radius);	
+		recipe.radius = shape.radius;
 		break;
 	case CollisionShape::Mesh: // Mesh Shape
-		{
-			H3DRes geoResource = 0;
-			int vertexOffset = 0, indexOffset = 0;
-			unsigned int numVertices = 0, numTriangleIndices = 0, vertRStart = 0;
+		if (!gatherMesh(m_hordeID, recipe))
+			return;
+		break;
+	case CollisionShape::Ragdoll: // Ragdolls are built by Physics::prepareNode
+		return;
+	}
+	m_recipes.push_back(recipe);
+}
 
-			switch(h3dGetNodeType(m_hordeID))
-			{
-			case H3DNodeTypes::Mesh:
-				geoResource = h3dGetNodeParamI(h3dGetNodeParent(m_hordeID), H3DModel::GeoResI);
-				numVertices = h3dGetNodeParamI(m_hordeID, H3DMesh::VertREndI) - h3dGetNodeParamI(m_hordeID, H3DMesh::VertRStartI) + 1;
-				numTriangleIndices = h3dGetNodeParamI(m_hordeID, H3DMesh::BatchCountI);		
-				vertRStart = h3dGetNodeParamI(m_hordeID, H3DMesh::VertRStartI);
-				vertexOffset = vertRStart * 3;
-				indexOffset = h3dGetNodeParamI(m_hordeID, H3DMesh::BatchStartI);
-				break;
-			case H3DNodeTypes::Model:
-				geoResource = h3dGetNodeParamI(m_hordeID, H3DModel::GeoResI);
-				numVertices = h3dGetResParamI(geoResource, 200, m_hordeID,H3DGeoRes::GeoVertexCountI);
-				numTriangleIndices = h3dGetResParamI(geoResource, 200, m_hordeID, H3DGeoRes::GeoIndexCountI);		
-				break;
-// 			case H3DEXT_NodeType_Terrain:
-// 				/*  if( m_terrainGeoRes != 0 )
-// 				{
-// 					h3dRemoveResource( m_terrainGeoRes );
-// 					h3dReleaseUnusedResources();
-// 					m_terrainGeoRes = 0;
-// 				}
-// 				*/
-// 				geoResource = h3dextCreateTerrainGeoRes( 
-// 					m_hordeID, 
-// 					h3dGetNodeParamStr( m_hordeID, H3DNodeParams::NameStr ), 
-// 					h3dGetNodeParamF( m_hordeID, H3DEXTTerrain::MeshQualityF, 0) );		
-// 				numVertices = h3dGetResParamI(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoVertexCountI);
-// 				numTriangleIndices = h3dGetResParamI(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoIndexCountI);		
-// 				break;
-			}
+PhysicsNode::~PhysicsNode()
+{
+	// wait for a worker thread that is still cooking this node
+	while (m_cookState == Queued)
+		this_thread::yield();
 
-			float* vertexBase = (float*) h3dMapResStream(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoVertPosStream, true, false);
-			h3dUnmapResStream(geoResource);
-			
-			if( vertexBase ) vertexBase += vertexOffset;
+	Physics::instance()->removeNode(this);
+	delete m_rigidBody;
+	delete m_motionState;
+	// queries on older snapshots may still use the collision data
+	if (m_sharedShape)
+		Physics::instance()->releaseSharedShape(m_collisionShape);
+	else
+		Physics::instance()->retire(m_collisionShape);
+	for (unsigned int i = 0; i < m_childShapes.size(); ++i)
+		Physics::instance()->retire(m_childShapes[i]);
+	for (unsigned int i = 0; i < m_btTriangleMeshes.size(); ++i)
+		Physics::instance()->retire(m_btTriangleMeshes[i]);
+}
 
-			//unsigned int* triangleBase = NULL;//= (char*) h3dMapResStream(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoIndexStream, true, false);
+bool PhysicsNode::gatherMesh(int hordeID, ShapeRecipe& recipe)
+{
+	H3DRes geoResource = 0;
+	int vertexOffset = 0, indexOffset = 0;
+	unsigned int numTriangleIndices = 0, vertRStart = 0;
 
-			unsigned int* TriangleBase32 = NULL;
-			unsigned short* TriangleBase16 = NULL;
+	switch(h3dGetNodeType(hordeID))
+	{
+	case H3DNodeTypes::Mesh:
+		geoResource = h3dGetNodeParamI(h3dGetNodeParent(hordeID), H3DModel::GeoResI);
+		numTriangleIndices = h3dGetNodeParamI(hordeID, H3DMesh::BatchCountI);		
+		vertRStart = h3dGetNodeParamI(hordeID, H3DMesh::VertRStartI);
+		vertexOffset = vertRStart * 3;
+		indexOffset = h3dGetNodeParamI(hordeID, H3DMesh::BatchStartI);
+		break;
+	case H3DNodeTypes::Model:
+		geoResource = h3dGetNodeParamI(hordeID, H3DModel::GeoResI);
+		numTriangleIndices = h3dGetResParamI(geoResource, 200, hordeID, H3DGeoRes::GeoIndexCountI);		
+		break;
+// 	case H3DEXT_NodeType_Terrain:
+// 		/*  if( m_terrainGeoRes != 0 )
+// 		{
+// 			h3dRemoveResource( m_terrainGeoRes );
+// 			h3dReleaseUnusedResources();
+// 			m_terrainGeoRes = 0;
+// 		}
+// 		*/
+// 		geoResource = h3dextCreateTerrainGeoRes( 
+// 			hordeID, 
+// 			h3dGetNodeParamStr( hordeID, H3DNodeParams::NameStr ), 
+// 			h3dGetNodeParamF( hordeID, H3DEXTTerrain::MeshQualityF, 0) );		
+// 		numTriangleIndices = h3dGetResParamI(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoIndexCountI);		
+// 		break;
+	}
 
-			//Triangle indices, must cope with 16 bit and 32 bit
-			if (h3dGetResParamI(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoIndices16I)) 
-			{
-				unsigned short* tb = (unsigned short*)h3dMapResStream(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoIndexStream, true, false);
-				TriangleBase16 = new unsigned short[ numTriangleIndices ];
-				memcpy(TriangleBase16, tb+indexOffset, numTriangleIndices * 2);
+	float* vertexBase = (float*) h3dMapResStream(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoVertPosStream, true, false);
+	h3dUnmapResStream(geoResource);
+	
+	if( vertexBase ) vertexBase += vertexOffset;
 
-				h3dUnmapResStream(geoResource);
+	// Copy the triangle indices rebased to the vertex range of the mesh, the triangle mesh is built while cooking
+	recipe.indices.resize(numTriangleIndices - numTriangleIndices % 3);
+	unsigned int maxIndex = 0;
+	bool indicesValid = false;
 
-				delete TriangleBase32;
-			} 
-			else 
-			{
-				unsigned int* tb = (unsigned int*)h3dMapResStream(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoIndexStream, true, false);
-				TriangleBase32 = new unsigned int[numTriangleIndices];
-				memcpy(TriangleBase32, tb+indexOffset, numTriangleIndices * 4);
+	//Triangle indices, must cope with 16 bit and 32 bit
+	if (h3dGetResParamI(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoIndices16I)) 
+	{
+		unsigned short* tb = (unsigned short*)h3dMapResStream(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoIndexStream, true, false);
+		if (tb)
+		{
+			for (unsigned int i = 0; i < recipe.indices.size(); ++i)
+				maxIndex = max(maxIndex, recipe.indices[i] = tb[indexOffset + i] - vertRStart);
+			indicesValid = true;
+		}
+		h3dUnmapResStream(geoResource);
+	} 
+	else 
+	{
+		unsigned int* tb = (unsigned int*)h3dMapResStream(geoResource, H3DGeoRes::GeometryElem, 0, H3DGeoRes::GeoIndexStream, true, false);
+		if (tb)
+		{
+			for (unsigned int i = 0; i < recipe.indices.size(); ++i)
+				maxIndex = max(maxIndex, recipe.indices[i] = tb[indexOffset + i] - vertRStart);
+			indicesValid = true;
+		}
+		h3dUnmapResStream(geoResource);
+	}
 
-				h3dUnmapResStream(geoResource);
+	if(	vertexBase && indicesValid && !recipe.indices.empty() )
+		recipe.vertices.assign(vertexBase, vertexBase + (maxIndex + 1) * 3);
+	else
+	{
+		printf("The mesh data for the physics representation couldn't be retrieved\n");
+		recipe.indices.clear();
+	}
 
-				delete TriangleBase16;
-			}
+	return !recipe.indices.empty();
+}
 
+void PhysicsNode::gatherChildShapes(int parentID, const Matrix4f& modelTrans)
+{
+	H3DNode child = 0;
+	for (int i = 0; (child = h3dGetNodeChild(parentID, i)) != 0; ++i)
+	{
+		if (h3dGetNodeType(child) != H3DNodeTypes::Mesh)
+			continue;
 
-			if(	vertexBase && (TriangleBase32 || TriangleBase16))
-			//if(	vertexBase && triangleBase)
-			{
-				// Create new mesh in physics engine
-				m_btTriangleMesh = new btTriangleMesh();
-				int offset = 3;
-				//if (triangleMode == 5) // Triangle Strip
-				//	offset = 1;
-
-				// copy mesh from graphics to physics
-				bool index16 = false;
-				if (TriangleBase16)
-					index16 = true;
-
-				for (unsigned int i = 0; i < numTriangleIndices - 2; i+=offset)
-					{
-						unsigned int index1 = index16 ? (TriangleBase16[i]   - vertRStart) * 3 : (TriangleBase32[i]   - vertRStart) * 3;
-						unsigned int index2 = index16 ? (TriangleBase16[i+1] - vertRStart) * 3 : (TriangleBase32[i+1] - vertRStart) * 3;
-						unsigned int index3 = index16 ? (TriangleBase16[i+2] - vertRStart) * 3 : (TriangleBase32[i+2] - vertRStart) * 3;
-
-						//unsigned int index1 = ( triangleBase[i]   - vertRStart) * 3;
-						//unsigned int index2 = (triangleBase[i+1] - vertRStart) * 3;
-						//unsigned int index3 = (triangleBase[i+2] - vertRStart) * 3;
-						m_btTriangleMesh->addTriangle(
-							btVector3(vertexBase[index1], vertexBase[index1+1], vertexBase[index1+2] ),
-							btVector3(vertexBase[index2], vertexBase[index2+1], vertexBase[index2+2] ),
-							btVector3(vertexBase[index3], vertexBase[index3+1], vertexBase[index3+2] )
-						); 
-					}														
-
-				bool useQuantizedAabbCompression = true;														
-				if (shape.mass > 0)
-					// You can use GImpact or convex decomposition of bullet to handle more complex meshes
-					m_collisionShape = new btConvexTriangleMeshShape(m_btTriangleMesh);				
-				else // BvhTriangleMesh can be used only for static objects
-					m_collisionShape = new btBvhTriangleMeshShape(m_btTriangleMesh,useQuantizedAabbCompression);
-			}
-			else
-			{
-				printf("The mesh data for the physics representation couldn't be retrieved\n");
-				return;
-			}
+		// A physics attachment of the mesh may replace the triangle geometry by a primitive shape
+		CollisionShape childShape;
+		if (!Physics::instance()->attachedShape(child, childShape))
+			childShape.type = CollisionShape::Mesh;
+
+		ShapeRecipe recipe;
+		recipe.type = childShape.type;
+		bool valid = true;
+		switch (childShape.type)
+		{
+		case CollisionShape::Box:
+			memcpy(recipe.extents, childShape.extents, sizeof(recipe.extents));
+			break;
+		case CollisionShape::Sphere:
+			recipe.radius = childShape.radius;
+			break;
+		case CollisionShape::Mesh:
+			valid = gatherMesh(child, recipe);
+			break;
+		case CollisionShape::Ragdoll:
+			printf("A ragdoll can't be part of a compound shape\n");
+			valid = false;
+			break;
 		}
-	}	
 
-	if( m_collisionShape )
+		if (valid)
+		{
+			// Transformation of the mesh relative to the model, scale is moved into the child shape
+			const float* x = 0;
+			h3dGetNodeTransMats(child, 0, &x);
+			Matrix4f relTrans = modelTrans * Matrix4f(x);
+			Vec3f t, r, s;
+			relTrans.decompose(t, r, s);
+			relTrans.scale( 1.0f / s.x, 1.0f / s.y, 1.0f / s.z );
+			memcpy(recipe.transformation, relTrans.x, sizeof(recipe.transformation));
+			recipe.scaling[0] = s.x; recipe.scaling[1] = s.y; recipe.scaling[2] = s.z;
+			m_recipes.push_back(recipe);
+		}
+		// meshes may be nested within other meshes
+		gatherChildShapes(child, modelTrans);
+	}
+}
+
+btCollisionShape* PhysicsNode::cookShape(const ShapeRecipe& recipe, bool dynamic)
+{
+	switch (recipe.type)
 	{
-		// Create initial transformation without scale
-		const float* x = 0;
-		h3dGetNodeTransMats(m_hordeID, 0, &x);
-		Matrix4f objTrans( x );	
-		Vec3f t, r, s;
-		objTrans.decompose(t, r, s);
+	case CollisionShape::Box:
+		return new btBoxShape(btVector3(recipe.extents[0], recipe.extents[1], recipe.extents[2]));
+	case CollisionShape::Sphere:
+		return new btSphereShape(recipe.radius);
+	case CollisionShape::Mesh:
+	case CollisionShape::Ragdoll: // never part of a recipe
+		break;
+	}
 
-		objTrans.scale( 1.0f / s.x, 1.0f / s.y, 1.0f / s.z );
+	// Create new mesh in physics engine
+	btTriangleMesh* triangleMesh = new btTriangleMesh();
+	m_btTriangleMeshes.push_back(triangleMesh);
+	triangleMesh->preallocateVertices((int) recipe.indices.size());
 
-		btTransform tr;
-		tr.setFromOpenGLMatrix( objTrans.x );
-		// Set local scaling in collision shape because Bullet does not support scaling in the world transformation matrices
-		m_collisionShape->setLocalScaling(btVector3(s.x,s.y,s.z));			
-		btVector3 localInertia(0,0,0);
-		//rigidbody is dynamic if and only if mass is non zero otherwise static
-		if ( shape.mass != 0)
-			m_collisionShape->calculateLocalInertia( shape.mass,localInertia );
-		if (shape.mass != 0 || shape.kinematic)
-			//using motionstate is recommended, it provides interpolation capabilities, and only synchronizes 'active' objects
-			m_motionState = new btDefaultMotionState(tr);						
+	// copy mesh from graphics to physics
+	const float* vertexBase = &recipe.vertices[0];
+	for (unsigned int i = 0; i < recipe.indices.size(); i += 3)
+	{
+		unsigned int index1 = recipe.indices[i] * 3;
+		unsigned int index2 = recipe.indices[i+1] * 3;
+		unsigned int index3 = recipe.indices[i+2] * 3;
 
-		btRigidBody::btRigidBodyConstructionInfo rbInfo( shape.mass,m_motionState,m_collisionShape,localInertia);
-		rbInfo.m_startWorldTransform = tr;	
+		triangleMesh->addTriangle(
+			btVector3(vertexBase[index1], vertexBase[index1+1], vertexBase[index1+2] ),
+			btVector3(vertexBase[index2], vertexBase[index2+1], vertexBase[index2+2] ),
+			btVector3(vertexBase[index3], vertexBase[index3+1], vertexBase[index3+2] )
+		); 
+	}														
 
-		m_rigidBody = new btRigidBody(rbInfo);
-		m_rigidBody->setUserPointer(this);
-		m_rigidBody->setDeactivationTime(2.0f);	
+	bool useQuantizedAabbCompression = true;														
+	if (dynamic)
+		// You can use GImpact or convex decomposition of bullet to handle more complex meshes
+		return new btConvexTriangleMeshShape(triangleMesh);				
+	else // BvhTriangleMesh can be used only for static objects
+		return new btBvhTriangleMeshShape(triangleMesh,useQuantizedAabbCompression);
+}
 
-		// Add support for collision detection if mass is zero but kinematic is explicitly enabled
-		if( shape.kinematic && shape.mass == 0 )
+void PhysicsNode::cook()
+{
+	const bool dynamic = m_shape.mass > 0;
+	if (m_shape.compound)
+	{
+		btCompoundShape* compound = new btCompoundShape();
+		for (unsigned int i = 0; i < m_recipes.size(); ++i)
 		{
-			m_rigidBody->setCollisionFlags(m_rigidBody->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);	
-			m_rigidBody->setActivationState(DISABLE_DEACTIVATION);
+			btCollisionShape* shape = cookShape(m_recipes[i], dynamic);
+			btTransform tr;
+			tr.setFromOpenGLMatrix( m_recipes[i].transformation );
+			shape->setLocalScaling(btVector3(m_recipes[i].scaling[0], m_recipes[i].scaling[1], m_recipes[i].scaling[2]));
+			compound->addChildShape(tr, shape);
+			m_childShapes.push_back(shape);
 		}
+		m_collisionShape = compound;
 	}
+	else if (!m_sharedShape)
+		m_collisionShape = cookShape(m_recipes[0], dynamic);
+	// the gathered data is not needed anymore
+	vector<ShapeRecipe>().swap(m_recipes);
+
+	btTransform tr;
+	tr.setFromOpenGLMatrix( m_startTransformation );
+	// Set local scaling in collision shape because Bullet does not support scaling in the world transformation matrices
+	if (!m_sharedShape)
+		m_collisionShape->setLocalScaling(btVector3(m_scaling[0], m_scaling[1], m_scaling[2]));			
+	btVector3 localInertia(0,0,0);
+	//rigidbody is dynamic if and only if mass is non zero otherwise static
+	if ( m_shape.mass != 0)
+		m_collisionShape->calculateLocalInertia( m_shape.mass,localInertia );
+	if (m_shape.mass != 0 || m_shape.kinematic)
+		//using motionstate is recommended, it provides interpolation capabilities, and only synchronizes 'active' objects
+		m_motionState = new btDefaultMotionState(tr);						
+
+	btRigidBody::btRigidBodyConstructionInfo rbInfo( m_shape.mass,m_motionState,m_collisionShape,localInertia);
+	rbInfo.m_startWorldTransform = tr;	
+	rbInfo.m_friction = m_shape.friction;
+	rbInfo.m_restitution = m_shape.restitution;
+
+	m_rigidBody = new btRigidBody(rbInfo);
+	m_rigidBody->setUserPointer(this);
+	m_rigidBody->setUserIndex(m_hordeID);
+	m_rigidBody->setDeactivationTime(2.0f);	
+
+	// Add support for collision detection if mass is zero but kinematic is explicitly enabled
+	// The body is woken up whenever its Horde3D node moves, so it may sleep while its node rests
+	if( m_shape.kinematic && m_shape.mass == 0 )
+		m_rigidBody->setCollisionFlags(m_rigidBody->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
+
+	m_cookState = Cooked;
 }
 
-PhysicsNode::~PhysicsNode()
+void PhysicsNode::shiftOrigin(const btVector3& translation)
 {
-	Physics::instance()->removeNode(this);
-	delete m_rigidBody;
-	delete m_motionState;
-	delete m_collisionShape;
-	delete m_btTriangleMesh;
+	// the start transformation is read by cook()
+	for (int i = 0; i < 3; ++i)
+		m_startTransformation[12 + i] += translation[i];
+	// the bounds are only set while an update is deferred
+	if (m_updateDeferred)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			m_deferredBounds[i] += translation[i];
+			m_deferredBounds[3 + i] += translation[i];
+		}
+	}
+	if (!m_rigidBody)
+		return;
+	m_rigidBody->getWorldTransform().getOrigin() += translation;
+	m_rigidBody->getInterpolationWorldTransform().getOrigin() += translation;
+	if (m_motionState)
+	{
+		m_motionState->m_graphicsWorldTrans.getOrigin() += translation;
+		m_motionState->m_startWorldTrans.getOrigin() += translation;
+	}
+}
+
+void PhysicsNode::applyCookingShift()
+{
+	if (m_cookingShift[0] == 0 && m_cookingShift[1] == 0 && m_cookingShift[2] == 0)
+		return;
+	shiftOrigin(btVector3(m_cookingShift[0], m_cookingShift[1], m_cookingShift[2]));
+	memset(m_cookingShift, 0, sizeof(m_cookingShift));
+}
+
+void PhysicsNode::collisionFilter(short& group, short& mask) const
+{
+	// the same defaults as btDiscreteDynamicsWorld::addRigidBody
+	const bool dynamic = !m_rigidBody->isStaticOrKinematicObject();
+	group = m_shape.group ? m_shape.group : short(dynamic ? btBroadphaseProxy::DefaultFilter : btBroadphaseProxy::StaticFilter);
+	mask = m_shape.mask ? m_shape.mask : short(dynamic ? btBroadphaseProxy::AllFilter : btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter);
 }
 
 void PhysicsNode::reset()
 {
 	if (m_rigidBody && m_motionState)
 	{			 
+		m_lodAsleep = false;
 		m_motionState->setWorldTransform(m_motionState->m_startWorldTrans);
 		m_rigidBody->setWorldTransform( m_motionState->m_startWorldTrans );
 		m_rigidBody->setInterpolationWorldTransform( m_motionState->m_startWorldTrans );
@@ -224,29 +384,208 @@ void PhysicsNode::reset()
 	}	
 }
 
-void PhysicsNode::update()
-{	
+void PhysicsNode::calcTransformation(float* x) const
+{
 	btTransform transformation;
-	m_motionState->getWorldTransform(transformation);
+	if (m_motionState)
+		m_motionState->getWorldTransform(transformation);
+	else
+		transformation = m_rigidBody->getWorldTransform();
 
-	float x[16];
 	transformation.getBasis().scaled(m_collisionShape->getLocalScaling()).getOpenGLSubMatrix(x);
 	x[12] = transformation.getOrigin().x();
 	x[13] = transformation.getOrigin().y();
 	x[14] = transformation.getOrigin().z();
 	x[15] = 1.0f;
+}
+
+bool PhysicsNode::updatePose()
+{
+	btTransform transformation;
+	m_motionState->getWorldTransform(transformation);
+	const btQuaternion rotation = transformation.getRotation();
+	const float pose[7] = { (float) transformation.getOrigin().x(), (float) transformation.getOrigin().y(), (float) transformation.getOrigin().z(),
+		(float) rotation.x(), (float) rotation.y(), (float) rotation.z(), (float) rotation.w() };
+	if (memcmp(pose, m_pose, sizeof(m_pose)) == 0)
+		return false;
+	memcpy(m_pose, pose, sizeof(m_pose));
+	return true;
+}
+
+void PhysicsNode::update()
+{	
+	float x[16];
+	calcTransformation(x);
+	update(x);
+}
 
+void PhysicsNode::update(const float* x)
+{
 	const float* parentMat = 0;
 	// since the physics transformation is absolute we have to create a relative transformation matrix for Horde3D
 	h3dGetNodeTransMats(h3dGetNodeParent(m_hordeID), 0, &parentMat);		
 	if (parentMat) h3dSetNodeTransMat(m_hordeID, (Matrix4f(parentMat).inverted() * Matrix4f(x)).x);
 	
 	h3dCheckNodeTransFlag( m_hordeID, true );
+	m_updateDeferred = false;
 
 	//if (parentMat) Physics::removePhysicsNode( m_hordeID );
 
 }
 
+void PhysicsNode::applyImpulse(const float* impulse, const float* relativePosition)
+{
+	if (m_rigidBody->isStaticOrKinematicObject())
+		return;
+	// the saved velocities of a body put to sleep by the LOD have to be changed as well
+	lodWake();
+	m_rigidBody->activate(true);
+	m_rigidBody->applyImpulse(btVector3(impulse[0], impulse[1], impulse[2]), 
+		btVector3(relativePosition[0], relativePosition[1], relativePosition[2]));
+}
+
+namespace
+{
+	/// Converts an absolute Horde3D transformation into a Bullet transformation without scale
+	btTransform removeScale(const float* x)
+	{
+		Matrix4f objTrans( x );
+		Vec3f t, r, s;
+		objTrans.decompose(t, r, s);
+		objTrans.scale( 1.0f / s.x, 1.0f / s.y, 1.0f / s.z );
+		btTransform transformation;
+		transformation.setFromOpenGLMatrix(objTrans.x);
+		return transformation;
+	}
+}
+
+void PhysicsNode::teleport(const float* x)
+{
+	const btTransform transformation = removeScale(x);
+	lodWake();
+	m_rigidBody->setWorldTransform(transformation);
+	m_rigidBody->setInterpolationWorldTransform(transformation);
+	if (m_motionState)
+		m_motionState->setWorldTransform(transformation);
+	if (!m_rigidBody->isStaticOrKinematicObject())
+		m_rigidBody->activate(true);
+}
+
+void PhysicsNode::setKinematicTarget(const float* x)
+{
+	// Bullet derives the velocity of the kinematic body from the motion state during the next step
+	m_motionState->setWorldTransform(removeScale(x));
+	m_rigidBody->activate();
+}
+
+void PhysicsNode::deferUpdate()
+{
+	if (m_updateDeferred)
+		return;
+	m_updateDeferred = true;
+	// The node stays at its last transferred position until the next transfer
+	float* b = m_deferredBounds;
+	h3dGetNodeAABB(m_hordeID, &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]);
+	// Meshes may be larger than their collision shape, the difference is used to enlarge the body's box
+	const btBroadphaseProxy* proxy = m_rigidBody->getBroadphaseHandle();
+	m_visibilityMargin = 0;
+	for (int i = 0; i < 3; ++i)
+		m_visibilityMargin = max(m_visibilityMargin, ((b[i+3] - b[i]) - (proxy->m_aabbMax[i] - proxy->m_aabbMin[i])) * 0.5f);
+}
+
+namespace
+{
+	/// Tests a box against the frustum planes, false if it is completely outside one of them
+	bool boxInFrustum(const Plane* frustum, const Vec3f& boxMin, const Vec3f& boxMax)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			// corner furthest along the plane normal
+			const Vec3f corner(frustum[i].normal.x >= 0 ? boxMax.x : boxMin.x,
+				frustum[i].normal.y >= 0 ? boxMax.y : boxMin.y,
+				frustum[i].normal.z >= 0 ? boxMax.z : boxMin.z);
+			if (frustum[i].distToPoint(corner) < 0)
+				return false;
+		}
+		return true;
+	}
+}
+
+bool PhysicsNode::isVisible(const Plane* frustum) const
+{
+	const btBroadphaseProxy* proxy = m_rigidBody->getBroadphaseHandle();
+	const Vec3f margin(m_visibilityMargin, m_visibilityMargin, m_visibilityMargin);
+	if (boxInFrustum(frustum,
+		Vec3f(proxy->m_aabbMin.x(), proxy->m_aabbMin.y(), proxy->m_aabbMin.z()) - margin,
+		Vec3f(proxy->m_aabbMax.x(), proxy->m_aabbMax.y(), proxy->m_aabbMax.z()) + margin))
+		return true;
+	// a stale node on the screen has to be moved to its current position as well
+	return m_updateDeferred && boxInFrustum(frustum,
+		Vec3f(m_deferredBounds[0], m_deferredBounds[1], m_deferredBounds[2]),
+		Vec3f(m_deferredBounds[3], m_deferredBounds[4], m_deferredBounds[5]));
+}
+
+void PhysicsNode::lodSleep()
+{
+	// bodies that are sleeping already keep their saved velocities, bodies woken up by a collision have been simulated
+	if (!m_rigidBody->isActive())
+		return;
+	const btVector3& linearVelocity = m_rigidBody->getLinearVelocity();
+	const btVector3& angularVelocity = m_rigidBody->getAngularVelocity();
+	for (int i = 0; i < 3; ++i)
+	{
+		m_lodLinearVelocity[i] = linearVelocity[i];
+		m_lodAngularVelocity[i] = angularVelocity[i];
+	}
+	m_rigidBody->setActivationState(ISLAND_SLEEPING);
+	m_lodAsleep = true;
+	m_lodSkipped = 0;
+}
+
+bool PhysicsNode::lodWake()
+{
+	if (!m_lodAsleep)
+		return false;
+	m_lodAsleep = false;
+	btVector3 linearVelocity(m_lodLinearVelocity[0], m_lodLinearVelocity[1], m_lodLinearVelocity[2]);
+	btVector3 angularVelocity(m_lodAngularVelocity[0], m_lodAngularVelocity[1], m_lodAngularVelocity[2]);
+	// Resting bodies count the extrapolated time as well, otherwise they would need much longer to fall asleep
+	const btScalar linearThreshold = m_rigidBody->getLinearSleepingThreshold();
+	const btScalar angularThreshold = m_rigidBody->getAngularSleepingThreshold();
+	if (linearVelocity.length2() < linearThreshold * linearThreshold && angularVelocity.length2() < angularThreshold * angularThreshold)
+		m_rigidBody->setDeactivationTime(m_rigidBody->getDeactivationTime() + m_lodSkipped);
+	m_rigidBody->setActivationState(ACTIVE_TAG);
+	m_rigidBody->setLinearVelocity(linearVelocity);
+	m_rigidBody->setAngularVelocity(angularVelocity);
+	return true;
+}
+
+void PhysicsNode::lodExtrapolate(btScalar timeStep)
+{
+	m_lodSkipped += timeStep;
+	btVector3 linearVelocity(m_lodLinearVelocity[0], m_lodLinearVelocity[1], m_lodLinearVelocity[2]);
+	btVector3 angularVelocity(m_lodAngularVelocity[0], m_lodAngularVelocity[1], m_lodAngularVelocity[2]);
+	// Bodies in contact keep their velocity, otherwise resting bodies would sink into the ground until the next step
+	if (!m_lodTouching)
+	{
+		linearVelocity += m_rigidBody->getGravity() * timeStep;
+		m_lodLinearVelocity[0] = linearVelocity.x();
+		m_lodLinearVelocity[1] = linearVelocity.y();
+		m_lodLinearVelocity[2] = linearVelocity.z();
+	}
+	else if (linearVelocity.fuzzyZero() && angularVelocity.fuzzyZero())
+		return;
+
+	btTransform transformation;
+	btTransformUtil::integrateTransform(m_rigidBody->getWorldTransform(), linearVelocity, angularVelocity, timeStep, transformation);
+	m_rigidBody->setWorldTransform(transformation);
+	m_rigidBody->setInterpolationWorldTransform(transformation);
+	m_motionState->setWorldTransform(transformation);
+	// If a collision wakes up the body during the step it continues with the extrapolated velocities
+	m_rigidBody->setLinearVelocity(linearVelocity);
+	m_rigidBody->setAngularVelocity(angularVelocity);
+}
+
 
 Physics* Physics::m_instance = 0;
 
@@ -263,140 +602,1694 @@ void Physics::release()
 	m_instance = 0;
 }
 
-Physics::Physics()
+Physics::Physics() : m_cookedNodes(0), m_scheduler(0), m_ownScheduler(0), m_asyncCooking(false), m_parallelSimulation(false), m_sceneWrites(true), m_poseExport(false), m_bakedAttachments(0),
+m_lodNear(0), m_lodFar(0), m_lodInterval(1), m_lodTick(0), m_visibilityCamera(0), m_ownerThread(this_thread::get_id()),
+m_sceneSync(true), m_querySnapshots(false), m_snapshotIndex(0)
 {
-	m_clock = new btClock();
-	m_configuration = new btDefaultCollisionConfiguration();
-	m_dispatcher = new btCollisionDispatcher(m_configuration);
+	m_lodViewpoint[0] = m_lodViewpoint[1] = m_lodViewpoint[2] = 0;
+	m_overlapFilter.filter = 0;
+	m_overlapFilter.userData = 0;
+	m_debugDrawer = 0;
+	m_partitionChanged = false;
+	m_resolvePending = false;
+	m_originOffset[0] = m_originOffset[1] = m_originOffset[2] = 0;
+	m_originShift[0] = m_originShift[1] = m_originShift[2] = 0;
+	m_originShiftPending = false;
+	m_originShiftThreshold = 0;
+	m_frameStart = chrono::steady_clock::now();
+	m_configuration = new ParallelCollisionConfiguration();
+	m_dispatcher = new ParallelCollisionDispatcher(m_configuration);
 	btVector3 worldMin(-1000,-1000,-1000);
 	btVector3 worldMax(1000,1000,1000);
-	m_pairCache = new btAxisSweep3(worldMin,worldMax);
-	m_constraintSolver = new btSequentialImpulseConstraintSolver();
-	m_physicsWorld = new btDiscreteDynamicsWorld(m_dispatcher,m_pairCache,m_constraintSolver, m_configuration);
+	m_pairCache = new ShiftableAxisSweep(worldMin,worldMax);
+	m_constraintSolver = new btMultiBodyConstraintSolver();
+	m_physicsWorld = new ParallelDynamicsWorld(m_dispatcher,m_pairCache,m_constraintSolver, m_configuration);
 	m_physicsWorld->setGravity(btVector3(0,-9.81f,0));
+	m_physicsWorld->setInternalTickCallback(preTickCallback, this, true);
+	// ghost objects of characters only test the objects overlapping them
+	m_ghostPairCallback = new btGhostPairCallback();
+	m_pairCache->getOverlappingPairCache()->setInternalGhostPairCallback(m_ghostPairCallback);
+	m_characters = new CharacterBatch();
+	m_physicsWorld->addAction(m_characters);
+	m_vehicles = new VehicleBatch();
+	m_physicsWorld->addAction(m_vehicles);
 }
 
 Physics::~Physics()
 {
+	waitForCooking();
+	for (unsigned int i = 0; i < m_pendingCommands.size(); ++i)
+		delete m_pendingCommands[i];
+	for (unsigned int i = 0; i < m_ragdolls.size(); ++i)
+		delete m_ragdolls[i];
+	for (unsigned int i = 0; i < m_constraints.size(); ++i)
+	{
+		m_physicsWorld->removeConstraint(m_constraints[i]);
+		delete m_constraints[i];
+	}
+	for (int i = 0; i < m_characters->numCharacters(); ++i)
+		m_physicsWorld->removeCollisionObject(m_characters->character(i)->ghostObject());
+	m_physicsWorld->removeAction(m_characters);
+	delete m_characters;
+	m_physicsWorld->removeAction(m_vehicles);
+	delete m_vehicles;
+	while (m_triggers.numTriggers() > 0)
+		removeTrigger(m_triggers.trigger(0)->hordeID());
+	delete m_debugDrawer;
 	delete m_physicsWorld;
 	delete m_pairCache;
+	delete m_ghostPairCallback;
 	delete m_constraintSolver;
 	delete m_dispatcher;
 	delete m_configuration;
-	delete m_clock;
+	delete m_ownScheduler;
 	m_instance = 0;
 }
 
 void Physics::reset()
 {
-	m_clock->reset();
+	m_frameStart = chrono::steady_clock::now();
 	int numObjects = m_physicsWorld->getNumCollisionObjects();
 	for (int i=0;i<numObjects;i++)
 	{
 		btCollisionObject* colObj = m_physicsWorld->getCollisionObjectArray()[i];
-		((PhysicsNode*)((btCollisionObject*) colObj)->getUserPointer())->reset();
+		PhysicsNode* node = (PhysicsNode*) colObj->getUserPointer();
+		if (node)
+			node->reset();
 	}	
+	for (unsigned int i = 0; i < m_ragdolls.size(); ++i)
+		m_ragdolls[i]->reset();
+	for (int i = 0; i < m_characters->numCharacters(); ++i)
+		m_characters->character(i)->reset(m_physicsWorld);
+	for (int i = 0; i < m_vehicles->numVehicles(); ++i)
+		m_vehicles->vehicle(i)->vehicle()->resetSuspension();
 }
 
 void Physics::render()
 {
-	float dt = m_clock->getTimeMicroseconds() * 0.00001f;
-	m_clock->reset();
+	const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	float dt = chrono::duration_cast<chrono::microseconds>(now - m_frameStart).count() * 0.00001f;
+	m_frameStart = now;
+
+	// Changes requested by other threads since the last frame are applied before the step
+	const size_t numCooking = m_cookingNodes.size();
+	// bodies restored by the partition continue with their stored state once their shapes have been cooked
+	for (unsigned int i = 0; i < m_pendingRestores.size(); )
+	{
+		if (m_pendingRestores[i].first->needsCooking())
+			++i;
+		else
+		{
+			restoreState(m_pendingRestores[i].first, m_pendingRestores[i].second);
+			m_pendingRestores.erase(m_pendingRestores.begin() + i);
+		}
+	}
+	addCookedNodes();
+	executeCommands();
+	// constraints and vehicles are only kept pending while one of their nodes is being cooked or until the
+	// frame that created their nodes ends
+	if (m_cookingNodes.size() != numCooking || m_resolvePending)
+	{
+		m_resolvePending = false;
+		resolveConstraints();
+		resolveVehicles();
+	}
+	if (m_partitionChanged)
+		updatePartition();
+	syncSceneTransforms();
+	// commands and node transformations of this frame are still relative to the old origin
+	if (m_originShiftPending)
+		rebaseOrigin();
 
 	m_physicsWorld->stepSimulation(dt);
+	m_triggers.update(m_parallelSimulation ? scheduler() : 0);
 
-	vector<PhysicsNode*>::iterator iter = m_physicsNodes.begin();
-	while ( iter!= m_physicsNodes.end() )
+	if (m_visibilityCamera)
+		updateFrustum();
+
+	// Visibility, transformations and poses are calculated in parallel, Horde3D is only accessed by the calling thread
+	const int numNodes = (int) m_physicsNodes.size();
+	m_syncTransformations.resize(m_sceneWrites ? numNodes * 16 : 0);
+	m_syncVisible.resize(m_sceneWrites ? numNodes : 0);
+	m_syncMoved.resize(m_poseExport ? numNodes : 0);
+	parallelFor(m_parallelSimulation ? scheduler() : 0, numNodes, 256, [this](int begin, int end, int)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			if (m_sceneWrites)
+			{
+				m_syncVisible[i] = !m_visibilityCamera || m_physicsNodes[i]->isVisible(m_frustum);
+				if (m_syncVisible[i])
+					m_physicsNodes[i]->calcTransformation(&m_syncTransformations[i * 16]);
+			}
+			if (m_poseExport)
+				m_syncMoved[i] = m_physicsNodes[i]->updatePose();
+		}
+	});
+	if (m_sceneWrites)
+	{
+		for (int i = 0; i < numNodes; ++i)
+		{
+			// kinematic bodies follow their Horde3D nodes
+			if (m_physicsNodes[i]->m_rigidBody->isKinematicObject())
+				continue;
+			if (m_syncVisible[i])
+				m_physicsNodes[i]->update(&m_syncTransformations[i * 16]);
+			else
+				m_physicsNodes[i]->deferUpdate();
+		}
+		for (unsigned int i = 0; i < m_ragdolls.size(); ++i)
+			m_ragdolls[i]->update();
+		for (int i = 0; i < m_characters->numCharacters(); ++i)
+			m_characters->character(i)->update();
+		// wheels are placed relative to their chassis nodes
+		for (int i = 0; i < m_vehicles->numVehicles(); ++i)
+			m_vehicles->vehicle(i)->update();
+	}
+	if (m_poseExport)
+	{
+		m_poses.clear();
+		for (int i = 0; i < numNodes; ++i)
+		{
+			if (!m_syncMoved[i])
+				continue;
+			Horde3DPhysics::PhysicsPose pose;
+			pose.hordeID = m_physicsNodes[i]->m_hordeID;
+			memcpy(pose.position, m_physicsNodes[i]->pose(), sizeof(pose.position));
+			memcpy(pose.rotation, m_physicsNodes[i]->pose() + 3, sizeof(pose.rotation));
+			m_poses.push_back(pose);
+		}
+	}
+
+	if (m_debugDrawer)
 	{
-		(*iter)->update();
-		++iter;
-		//iter = iter + 1;
+		btActionInterface* const actions[] = { m_vehicles, m_characters };
+		m_debugDrawer->draw(static_cast<btDiscreteDynamicsWorld*>(m_physicsWorld), actions, 2);
 	}
+
+	if (m_querySnapshots)
+		updateSnapshot();
+	// after disabling the snapshots, removed collision data is kept until the last query has finished
+	else if (m_retired && m_retired.use_count() == 1)
+		m_retired.reset();
 }
 
-void Physics::addNode(PhysicsNode* node)
+void Physics::setPoseExport( bool enable )
 {
-	vector<PhysicsNode*>::iterator iter = find(m_physicsNodes.begin(), m_physicsNodes.end(), node);
-	if (iter == m_physicsNodes.end())
-	{		
-		m_physicsWorld->addRigidBody(node->m_rigidBody);
-		// add it to the object vector only if it is dynamic
-		if (node->m_motionState) m_physicsNodes.push_back(node);
-	}
+	m_poseExport = enable;
+	if (!enable)
+		m_poses.clear();
 }
 
-void Physics::removeNode(PhysicsNode* node)
+const Horde3DPhysics::PhysicsPose* Physics::poses( int& count ) const
 {
-	// Remove from dynamics physics world
-	if (node)
+	count = (int) m_poses.size();
+	return m_poses.empty() ? 0 : &m_poses[0];
+}
+
+void Physics::setSceneWrites( bool enable )
+{
+	m_sceneWrites = enable;
+}
+
+void Physics::syncSceneTransforms()
+{
+	// Only the flags are checked for all nodes, the transformations of moved nodes are read afterwards
+	m_movedNodes.clear();
+	if (m_sceneSync)
 	{
-		m_physicsWorld->removeRigidBody(node->m_rigidBody);
-		// remove from Physics
-		if (node->m_motionState)
+		const int numObjects = m_physicsWorld->getNumCollisionObjects();
+		for (int i = 0; i < numObjects; ++i)
 		{
-			vector<PhysicsNode*>::iterator iter = find(m_physicsNodes.begin(), m_physicsNodes.end(), node);
-			if( iter != m_physicsNodes.end() ) m_physicsNodes.erase(iter);
+			PhysicsNode* node = (PhysicsNode*) m_physicsWorld->getCollisionObjectArray()[i]->getUserPointer();
+			if (node && h3dCheckNodeTransFlag(node->m_hordeID, true))
+				m_movedNodes.push_back(node);
+		}
+	}
+	else
+	{
+		// kinematic bodies are driven by their Horde3D nodes in any case
+		for (unsigned int i = 0; i < m_kinematicNodes.size(); ++i)
+		{
+			if (h3dCheckNodeTransFlag(m_kinematicNodes[i]->m_hordeID, true))
+				m_movedNodes.push_back(m_kinematicNodes[i]);
 		}
 	}
-}
 
+	// triggers follow their nodes like kinematic bodies
+	for (int i = 0; i < m_triggers.numTriggers(); ++i)
+	{
+		Trigger* trigger = m_triggers.trigger(i);
+		if (!h3dCheckNodeTransFlag(trigger->hordeID(), true))
+			continue;
+		const float* x = 0;
+		h3dGetNodeTransMats(trigger->hordeID(), 0, &x);
+		if (!x)
+			continue;
+		trigger->setTransformation(x);
+		m_physicsWorld->updateSingleAabb(trigger->ghostObject());
+	}
 
+	for (unsigned int i = 0; i < m_movedNodes.size(); ++i)
+	{
+		PhysicsNode* node = m_movedNodes[i];
+		const float* x = 0;
+		h3dGetNodeTransMats(node->m_hordeID, 0, &x);
+		if (!x)
+			continue;
+		if (node->m_rigidBody->isKinematicObject())
+			node->setKinematicTarget(x);
+		else
+		{
+			node->teleport(x);
+			m_physicsWorld->updateSingleAabb(node->m_rigidBody);
+		}
+	}
+}
 
-void Physics::createPhysicsNode( int hordeID, const char *xmlText)
+void Physics::setSceneSync( bool enable )
 {
-	XMLResults results;
-	XMLNode xmlNode = XMLNode::parseString(xmlText, "Attachment", &results);
-	if( !xmlNode.isEmpty() && results.error == eXMLErrorNone )
-	{		
-		XMLNode physicsNode;
-		const char* type = xmlNode.getAttribute("type", "");
-		if ( _stricmp(type, "GameEngine")==0 && !( physicsNode = xmlNode.getChildNode("BulletPhysics") ).isEmpty() )
+	// changes made while the sync was disabled are ignored
+	if (enable && !m_sceneSync)
+	{
+		const int numObjects = m_physicsWorld->getNumCollisionObjects();
+		for (int i = 0; i < numObjects; ++i)
 		{
-			CollisionShape collisionShape;
-			const char* shape = physicsNode.getAttribute("shape");
-			if (shape && _stricmp(shape, "box")==0)
-			{
-				collisionShape.type = CollisionShape::Box;
-				collisionShape.extents[0] =  static_cast<float>(atof(physicsNode.getAttribute("x")));
-				collisionShape.extents[1] =  static_cast<float>(atof(physicsNode.getAttribute("y")));
-				collisionShape.extents[2] =  static_cast<float>(atof(physicsNode.getAttribute("z")));
-			}
-			else if (shape && _stricmp(shape, "sphere")==0)
-			{
-				collisionShape.type = CollisionShape::Sphere;
-				collisionShape.radius =  static_cast<float>(atof(physicsNode.getAttribute("radius")));
-			}
-			else
-				collisionShape.type = CollisionShape::Mesh;
-			const char* mass = physicsNode.getAttribute("mass", "0.0");
-			collisionShape.mass = static_cast<float>(atof(mass));
-			const char* kinematic = physicsNode.getAttribute("kinematic", "false");
-			collisionShape.kinematic = _stricmp( kinematic, "true" ) == 0 || _stricmp( kinematic, "1" ) == 0;
-			// create new physicsnode: livetime of the node instance will be controlled by the Physics instance
-			PhysicsNode* physicsNode = new PhysicsNode(collisionShape, hordeID);
-			if (physicsNode->m_rigidBody == 0)
-				delete physicsNode;
-			else
-				instance()->addNode(physicsNode);
+			PhysicsNode* node = (PhysicsNode*) m_physicsWorld->getCollisionObjectArray()[i]->getUserPointer();
+			if (node && !node->m_rigidBody->isKinematicObject())
+				h3dCheckNodeTransFlag(node->m_hordeID, true);
 		}
 	}
-#ifdef _DEBUG
-	else if( !xmlNode.isEmpty() )
-		printf("Error reading XmlNode: %s", XMLNode::getError(results.error));
-#endif
+	m_sceneSync = enable;
 }
 
-void Physics::removePhysicsNode( int node )
+void Physics::setQuerySnapshots( bool enable )
 {
-	int numObjects = instance()->m_physicsWorld->getNumCollisionObjects();
+	if (enable == m_querySnapshots)
+		return;
+	m_querySnapshots = enable;
+	if (enable)
+	{
+		if (!m_retired)
+			m_retired = make_shared<RetiredCollisionData>();
+		updateSnapshot();
+	}
+	else
+	{
+		atomic_store(&m_snapshot, shared_ptr<const WorldSnapshot>());
+		m_snapshotBuffers[0].reset();
+		m_snapshotBuffers[1].reset();
+	}
+}
+
+void Physics::updateSnapshot()
+{
+	m_snapshotIndex ^= 1;
+	shared_ptr<WorldSnapshot>& snapshot = m_snapshotBuffers[m_snapshotIndex];
+	if (!snapshot || snapshot.use_count() > 1)
+		snapshot = make_shared<WorldSnapshot>();
+	snapshot->clear();
+
+	const int numObjects = m_physicsWorld->getNumCollisionObjects();
 	for (int i = 0; i < numObjects; ++i)
 	{
-		btCollisionObject* colObj = instance()->m_physicsWorld->getCollisionObjectArray()[i];
-		PhysicsNode* nodePtr = ((PhysicsNode*)((btCollisionObject*) colObj)->getUserPointer());
-		if( nodePtr && nodePtr->m_hordeID == node )
-		{
-			delete nodePtr;
-			break;
-		}
-	}	
+		const btCollisionObject* object = m_physicsWorld->getCollisionObjectArray()[i];
+		const PhysicsNode* node = (const PhysicsNode*) object->getUserPointer();
+		if (node)
+			snapshot->add(object, node->m_hordeID);
+	}
+	snapshot->build();
+
+	// Data retired from now on may be referenced by this snapshot, data retired before by older ones only
+	shared_ptr<RetiredCollisionData> retired = make_shared<RetiredCollisionData>();
+	m_retired->next = retired;
+	m_retired = retired;
+	snapshot->m_retired = retired;
+
+	atomic_store(&m_snapshot, shared_ptr<const WorldSnapshot>(snapshot));
+}
+
+void Physics::updateFrustum()
+{
+	float projection[16];
+	h3dGetCameraProjMat(m_visibilityCamera, projection);
+	const float* camera = 0;
+	h3dGetNodeTransMats(m_visibilityCamera, 0, &camera);
+	if (!camera)
+		return;
+	// Planes are extracted from the rows of the view projection matrix (Gribb/Hartmann)
+	const Matrix4f m = Matrix4f(projection) * Matrix4f(camera).inverted();
+	for (int i = 0; i < 3; ++i)
+	{
+		m_frustum[i*2] = Plane(m.c[0][3] + m.c[0][i], m.c[1][3] + m.c[1][i], m.c[2][3] + m.c[2][i], m.c[3][3] + m.c[3][i]);
+		m_frustum[i*2+1] = Plane(m.c[0][3] - m.c[0][i], m.c[1][3] - m.c[1][i], m.c[2][3] - m.c[2][i], m.c[3][3] - m.c[3][i]);
+	}
+}
+
+void Physics::setVisibilityCamera( int cameraID )
+{
+	m_visibilityCamera = cameraID;
+	if (!cameraID)
+		flushTransforms();
+}
+
+void Physics::flushTransforms()
+{
+	for (unsigned int i = 0; i < m_physicsNodes.size(); ++i)
+		m_physicsNodes[i]->flush();
+}
+
+void Physics::addNode(PhysicsNode* node)
+{
+	vector<PhysicsNode*>::iterator iter = find(m_physicsNodes.begin(), m_physicsNodes.end(), node);
+	if (iter == m_physicsNodes.end())
+	{		
+		short group, mask;
+		node->collisionFilter(group, mask);
+		m_physicsWorld->addRigidBody(node->m_rigidBody, group, mask);
+		// add it to the object vector only if it is dynamic
+		if (node->m_motionState) m_physicsNodes.push_back(node);
+		if (node->m_rigidBody->isKinematicObject()) m_kinematicNodes.push_back(node);
+	}
+}
+
+namespace
+{
+	/// Orders rigid bodies along the first axis of the sweep and prune broadphase
+	struct AabbMinXLess
+	{
+		bool operator()(const pair<float, PhysicsNode*>& a, const pair<float, PhysicsNode*>& b) const { return a.first < b.first; }
+	};
+}
+
+void Physics::addNodes(vector<PhysicsNode*>& nodes)
+{
+	// Inserting in ascending order keeps the insertion sort of btAxisSweep3 short on the first axis
+	vector< pair<float, PhysicsNode*> > sorted;
+	sorted.reserve(nodes.size());
+	for (unsigned int i = 0; i < nodes.size(); ++i)
+	{
+		btVector3 aabbMin, aabbMax;
+		btRigidBody* body = nodes[i]->m_rigidBody;
+		body->getCollisionShape()->getAabb(body->getWorldTransform(), aabbMin, aabbMax);
+		sorted.push_back(make_pair(float(aabbMin.x()), nodes[i]));
+	}
+	sort(sorted.begin(), sorted.end(), AabbMinXLess());
+
+	m_physicsNodes.reserve(m_physicsNodes.size() + nodes.size());
+	for (unsigned int i = 0; i < sorted.size(); ++i)
+	{
+		PhysicsNode* node = sorted[i].second;
+		short group, mask;
+		node->collisionFilter(group, mask);
+		m_physicsWorld->addRigidBody(node->m_rigidBody, group, mask);
+		// add it to the object vector only if it is dynamic
+		if (node->m_motionState) m_physicsNodes.push_back(node);
+		if (node->m_rigidBody->isKinematicObject()) m_kinematicNodes.push_back(node);
+	}
+}
+
+void Physics::removeNode(PhysicsNode* node)
+{
+	// Nodes that are still being cooked have not been added to the world yet
+	vector<PhysicsNode*>::iterator cooking = find(m_cookingNodes.begin(), m_cookingNodes.end(), node);
+	if (cooking != m_cookingNodes.end())
+	{
+		m_cookingNodes.erase(cooking);
+		for (unsigned int i = 0; i < m_pendingRestores.size(); ++i)
+		{
+			if (m_pendingRestores[i].first == node)
+			{
+				m_pendingRestores.erase(m_pendingRestores.begin() + i);
+				break;
+			}
+		}
+		return;
+	}
+	// Nodes whose shape couldn't be built never got a rigid body
+	if (!node || !node->m_rigidBody)
+		return;
+	// Remove from dynamics physics world
+	removeConstraints(node->m_rigidBody);
+	removeVehicle(node->m_rigidBody);
+	m_physicsWorld->removeRigidBody(node->m_rigidBody);
+	// remove from Physics
+	if (node->m_motionState)
+	{
+		vector<PhysicsNode*>::iterator iter = find(m_physicsNodes.begin(), m_physicsNodes.end(), node);
+		if( iter != m_physicsNodes.end() ) m_physicsNodes.erase(iter);
+	}
+	if (node->m_rigidBody->isKinematicObject())
+	{
+		vector<PhysicsNode*>::iterator iter = find(m_kinematicNodes.begin(), m_kinematicNodes.end(), node);
+		if( iter != m_kinematicNodes.end() ) m_kinematicNodes.erase(iter);
+	}
+}
+
+
+
+void Physics::createPhysicsNode( int hordeID, const char *xmlText)
+{
+	CollisionShape collisionShape;
+	ConstraintDefinition constraints[ConstraintDefinition::MaxPerAttachment];
+	int numConstraints = 0;
+	VehicleDefinition vehicle;
+	// Meshes of a model with a compound physics representation are already part of the model's shape
+	if( AttachmentParser::parse(xmlText, collisionShape, constraints, ConstraintDefinition::MaxPerAttachment, &numConstraints, &vehicle) && 
+		!instance()->hasCompoundAncestor(hordeID) )
+	{
+		PhysicsNode* physicsNode = instance()->prepareNode(collisionShape, hordeID);
+		if (physicsNode && !physicsNode->needsCooking())
+			instance()->addNode(physicsNode);
+		instance()->queueConstraints(hordeID, constraints, numConstraints);
+		instance()->queueVehicle(hordeID, vehicle);
+		// the targets of the constraints may not have been created yet
+		if (numConstraints > 0 || vehicle.numWheels > 0)
+			instance()->m_resolvePending = true;
+	}
+}
+
+void Physics::createPhysicsNodes( int rootID )
+{
+	vector<int> hordeIDs;
+	SceneSearch::findNodes(rootID, "", H3DNodeTypes::Undefined, hordeIDs);
+
+	Physics* physics = instance();
+	vector<int> attachedIDs;
+	vector<CollisionShape> shapes;
+	ConstraintDefinition constraints[ConstraintDefinition::MaxPerAttachment];
+	VehicleDefinition vehicle;
+	for (unsigned int i = 0; i < hordeIDs.size(); ++i)
+	{
+		const char* attachment = h3dGetNodeParamStr(hordeIDs[i], H3DNodeParams::AttachmentStr);
+		CollisionShape collisionShape;
+		int numConstraints = 0;
+		if (!attachment || *attachment == 0 || 
+			!AttachmentParser::parse(attachment, collisionShape, constraints, ConstraintDefinition::MaxPerAttachment, &numConstraints, &vehicle))
+			continue;
+		attachedIDs.push_back(hordeIDs[i]);
+		shapes.push_back(collisionShape);
+		physics->queueConstraints(hordeIDs[i], constraints, numConstraints);
+		physics->queueVehicle(hordeIDs[i], vehicle);
+	}
+	physics->createBranch(rootID, attachedIDs, shapes);
+	physics->resolveConstraints();
+	physics->resolveVehicles();
+}
+
+bool Physics::bakePhysicsNodes( int rootID, const char* fileName )
+{
+	return PhysicsBlob::bake(rootID, fileName);
+}
+
+bool Physics::loadPhysicsNodes( int rootID, const char* fileName )
+{
+	PhysicsBlob blob;
+	if (!blob.open(fileName))
+		return false;
+	if (!blob.isCurrent(rootID))
+	{
+		printf("Physics blob %s is out of date, the attachments have changed since baking\n", fileName);
+		return false;
+	}
+
+	const int count = blob.numDescriptors();
+	vector<int> hordeIDs(count);
+	const int resolved = count > 0 ? blob.resolveNodes(rootID, &hordeIDs[0]) : 0;
+	if (resolved < count)
+	{
+		printf("Physics blob %s doesn't match the scene, node '%s' not found\n", fileName, blob.descriptors()[resolved].path);
+		return false;
+	}
+
+	vector<int> attachedIDs;
+	vector<CollisionShape> shapes;
+	attachedIDs.reserve(count);
+	shapes.reserve(count);
+	// attachments of meshes that are part of a compound shape are looked up while gathering the compound
+	map<int, const PhysicsDescriptor*> bakedAttachments;
+	for (int i = 0; i < count; ++i)
+	{
+		CollisionShape collisionShape;
+		PhysicsBlob::toCollisionShape(blob.descriptors()[i], collisionShape);
+		attachedIDs.push_back(hordeIDs[i]);
+		shapes.push_back(collisionShape);
+		bakedAttachments[hordeIDs[i]] = &blob.descriptors()[i];
+	}
+
+	Physics* physics = instance();
+	for (int i = 0; i < blob.numConstraints(); ++i)
+	{
+		const ConstraintDescriptor& constraint = blob.constraints()[i];
+		physics->queueConstraints(hordeIDs[constraint.descriptor], &constraint.definition, 1);
+	}
+	for (int i = 0; i < blob.numVehicles(); ++i)
+		physics->queueVehicle(hordeIDs[blob.vehicles()[i].descriptor], blob.vehicles()[i].definition);
+	physics->m_bakedAttachments = &bakedAttachments;
+	physics->createBranch(rootID, attachedIDs, shapes);
+	physics->m_bakedAttachments = 0;
+	physics->resolveConstraints();
+	physics->resolveVehicles();
+	return true;
+}
+
+bool Physics::attachedShape( int hordeID, CollisionShape& shape ) const
+{
+	if (m_bakedAttachments)
+	{
+		map<int, const PhysicsDescriptor*>::const_iterator iter = m_bakedAttachments->find(hordeID);
+		if (iter == m_bakedAttachments->end())
+			return false;
+		PhysicsBlob::toCollisionShape(*iter->second, shape);
+		return true;
+	}
+	const char* attachment = h3dGetNodeParamStr(hordeID, H3DNodeParams::AttachmentStr);
+	return attachment && *attachment != 0 && AttachmentParser::parse(attachment, shape);
+}
+
+void Physics::createBranch( int rootID, const vector<int>& hordeIDs, const vector<CollisionShape>& shapes )
+{
+	// the whole branch belongs to a compound shape created before
+	if (hasCompoundAncestor(rootID))
+		return;
+
+	// compound models of this branch, the nodes are ordered parents before their children
+	vector<int> compoundIDs;
+	vector<PhysicsNode*> nodes;
+	nodes.reserve(hordeIDs.size());
+	for (unsigned int i = 0; i < hordeIDs.size(); ++i)
+	{
+		bool partOfCompound = false;
+		for (int parent = hordeIDs[i]; !compoundIDs.empty() && parent != rootID && parent != 0 && !partOfCompound; )
+		{
+			parent = h3dGetNodeParent(parent);
+			partOfCompound = find(compoundIDs.begin(), compoundIDs.end(), parent) != compoundIDs.end();
+		}
+		if (partOfCompound)
+			continue;
+
+		PhysicsNode* physicsNode = prepareNode(shapes[i], hordeIDs[i]);
+		if (!physicsNode)
+			continue;
+		if (shapes[i].compound)
+			compoundIDs.push_back(hordeIDs[i]);
+		// nodes that are cooked asynchronously are added once they are ready
+		if (!physicsNode->needsCooking())
+			nodes.push_back(physicsNode);
+	}
+	addNodes(nodes);
+}
+
+PhysicsNode* Physics::prepareNode( const CollisionShape& collisionShape, int hordeID )
+{
+	if (collisionShape.type == CollisionShape::Ragdoll)
+	{
+		// ragdolls are multi bodies, they are added to the world directly
+		Ragdoll* ragdoll = new Ragdoll(collisionShape, hordeID);
+		if (ragdoll->isValid())
+		{
+			ragdoll->addToWorld(static_cast<ParallelDynamicsWorld*>(m_physicsWorld));
+			m_ragdolls.push_back(ragdoll);
+		}
+		else
+			delete ragdoll;
+		return 0;
+	}
+	if (collisionShape.trigger)
+	{
+		// triggers are ghost objects, they are not represented by physics nodes
+		createTrigger(collisionShape, hordeID);
+		return 0;
+	}
+	// create new physicsnode: livetime of the node instance will be controlled by the Physics instance
+	PhysicsNode* physicsNode = new PhysicsNode(collisionShape, hordeID);
+	if (!physicsNode->isValid())
+	{
+		delete physicsNode;
+		return 0;
+	}
+	if (collisionShape.compound || collisionShape.type == CollisionShape::Mesh)
+	{
+		if (m_asyncCooking)
+		{
+			// the node will be inserted into the world by addCookedNodes() once its shape is available
+			physicsNode->m_cookState = PhysicsNode::Queued;
+			m_cookingNodes.push_back(physicsNode);
+			scheduler()->submit(&PhysicsNode::cookTask, physicsNode);
+			return physicsNode;
+		}
+	}
+	else
+	{
+		// equal primitive shapes are shared between all nodes
+		physicsNode->m_collisionShape = acquireSharedShape(physicsNode->m_recipes[0], physicsNode->m_scaling);
+		physicsNode->m_sharedShape = true;
+	}
+	physicsNode->cook();
+	return physicsNode;
+}
+
+bool Physics::hasCompoundAncestor( int hordeID )
+{
+	for (int parent = h3dGetNodeParent(hordeID); parent != 0; parent = h3dGetNodeParent(parent))
+	{
+		PhysicsNode* parentNode = findNode(parent);
+		if (parentNode && parentNode->m_shape.compound)
+			return true;
+	}
+	return false;
+}
+
+btCollisionShape* Physics::acquireSharedShape( const ShapeRecipe& recipe, const float* scaling )
+{
+	SharedShapeKey key;
+	key.values[0] = float(recipe.type);
+	key.values[1] = recipe.type == CollisionShape::Box ? recipe.extents[0] : recipe.radius;
+	key.values[2] = recipe.type == CollisionShape::Box ? recipe.extents[1] : 0.0f;
+	key.values[3] = recipe.type == CollisionShape::Box ? recipe.extents[2] : 0.0f;
+	memcpy(key.values + 4, scaling, 3 * sizeof(float));
+
+	map<SharedShapeKey, btCollisionShape*>::iterator iter = m_sharedShapes.find(key);
+	if (iter != m_sharedShapes.end())
+	{
+		++m_sharedShapeRefs[iter->second];
+		return iter->second;
+	}
+
+	btCollisionShape* shape = 0;
+	if (recipe.type == CollisionShape::Box)
+		shape = new btBoxShape(btVector3(recipe.extents[0], recipe.extents[1], recipe.extents[2]));
+	else
+		shape = new btSphereShape(recipe.radius);
+	shape->setLocalScaling(btVector3(scaling[0], scaling[1], scaling[2]));
+	m_sharedShapes[key] = shape;
+	m_sharedShapeRefs[shape] = 1;
+	return shape;
+}
+
+void Physics::releaseSharedShape( btCollisionShape* shape )
+{
+	map<btCollisionShape*, int>::iterator refs = m_sharedShapeRefs.find(shape);
+	if (refs == m_sharedShapeRefs.end() || --refs->second > 0)
+		return;
+	m_sharedShapeRefs.erase(refs);
+	for (map<SharedShapeKey, btCollisionShape*>::iterator iter = m_sharedShapes.begin(); iter != m_sharedShapes.end(); ++iter)
+	{
+		if (iter->second == shape)
+		{
+			m_sharedShapes.erase(iter);
+			break;
+		}
+	}
+	retire(shape);
+}
+
+void Physics::retire( btCollisionShape* shape )
+{
+	if (m_retired && shape)
+		m_retired->shapes.push_back(shape);
+	else
+		delete shape;
+}
+
+void Physics::retire( btStridingMeshInterface* mesh )
+{
+	if (m_retired && mesh)
+		m_retired->meshes.push_back(mesh);
+	else
+		delete mesh;
+}
+
+void Physics::setAsyncCooking( bool enable )
+{
+	if (!enable && m_asyncCooking)
+	{
+		waitForCooking();
+		addCookedNodes();
+	}
+	m_asyncCooking = enable;
+}
+
+void Physics::setParallelSimulation( bool enable )
+{
+	m_parallelSimulation = enable;
+	static_cast<ParallelDynamicsWorld*>(m_physicsWorld)->setScheduler(enable ? scheduler() : 0);
+	static_cast<ParallelCollisionDispatcher*>(m_dispatcher)->setScheduler(enable ? scheduler() : 0);
+	m_vehicles->setScheduler(enable ? scheduler() : 0);
+}
+
+void Physics::setScheduler( Horde3DPhysics::ITaskScheduler* scheduler )
+{
+	// queued cooking tasks still reference the previous scheduler
+	waitForCooking();
+	m_scheduler = scheduler;
+	setParallelSimulation(m_parallelSimulation);
+	if (m_scheduler && m_ownScheduler)
+	{
+		delete m_ownScheduler;
+		m_ownScheduler = 0;
+	}
+}
+
+Horde3DPhysics::ITaskScheduler* Physics::scheduler()
+{
+	if (m_scheduler)
+		return m_scheduler;
+	if (!m_ownScheduler)
+		m_ownScheduler = new TaskScheduler();
+	return m_ownScheduler;
+}
+
+void Physics::waitForCooking()
+{
+	for (unsigned int i = 0; i < m_cookingNodes.size(); ++i)
+	{
+		while (m_cookingNodes[i]->needsCooking())
+			this_thread::yield();
+	}
+}
+
+float Physics::cookingProgress() const
+{
+	if (m_cookingNodes.empty())
+		return 1.0f;
+	int cooked = m_cookedNodes;
+	for (unsigned int i = 0; i < m_cookingNodes.size(); ++i)
+	{
+		if (!m_cookingNodes[i]->needsCooking())
+			++cooked;
+	}
+	return float(cooked) / float(m_cookedNodes + m_cookingNodes.size());
+}
+
+void Physics::addCookedNodes()
+{
+	unsigned int remaining = 0;
+	for (unsigned int i = 0; i < m_cookingNodes.size(); ++i)
+	{
+		PhysicsNode* node = m_cookingNodes[i];
+		if (node->needsCooking())
+			m_cookingNodes[remaining++] = node;
+		else
+		{
+			++m_cookedNodes;
+			node->applyCookingShift();
+			addNode(node);
+		}
+	}
+	m_cookingNodes.resize(remaining);
+	// start counting from zero for the next loading phase
+	if (m_cookingNodes.empty())
+		m_cookedNodes = 0;
+}
+
+void Physics::setSimulationLOD( float nearDistance, float farDistance, int midInterval )
+{
+	m_lodNear = nearDistance;
+	m_lodFar = max(farDistance, nearDistance);
+	m_lodInterval = max(midInterval, 1);
+	if (farDistance <= 0)
+	{
+		for (unsigned int i = 0; i < m_physicsNodes.size(); ++i)
+			m_physicsNodes[i]->lodWake();
+	}
+}
+
+void Physics::setLODViewpoint( float x, float y, float z )
+{
+	m_lodViewpoint[0] = x;
+	m_lodViewpoint[1] = y;
+	m_lodViewpoint[2] = z;
+}
+
+void Physics::preTickCallback( btDynamicsWorld* world, btScalar timeStep )
+{
+	Physics* physics = static_cast<Physics*>(world->getWorldUserInfo());
+	if (physics->m_lodFar > 0)
+		physics->updateLOD(timeStep);
+	for (unsigned int i = 0; i < physics->m_ragdolls.size(); ++i)
+		physics->m_ragdolls[i]->updateJointLimits(timeStep);
+}
+
+void Physics::updateLOD( btScalar timeStep )
+{
+	++m_lodTick;
+
+	// The contacts of the last step decide whether the extrapolation of a body follows the gravity
+	for (unsigned int i = 0; i < m_physicsNodes.size(); ++i)
+		m_physicsNodes[i]->m_lodTouching = false;
+	const int numManifolds = m_dispatcher->getNumManifolds();
+	for (int i = 0; i < numManifolds; ++i)
+	{
+		btPersistentManifold* manifold = m_dispatcher->getManifoldByIndexInternal(i);
+		if (manifold->getNumContacts() == 0)
+			continue;
+		PhysicsNode* node0 = (PhysicsNode*) manifold->getBody0()->getUserPointer();
+		PhysicsNode* node1 = (PhysicsNode*) manifold->getBody1()->getUserPointer();
+		if (node0) node0->m_lodTouching = true;
+		if (node1) node1->m_lodTouching = true;
+	}
+
+	const btVector3 viewpoint(m_lodViewpoint[0], m_lodViewpoint[1], m_lodViewpoint[2]);
+	const btScalar nearDistance2 = m_lodNear * m_lodNear;
+	const btScalar farDistance2 = m_lodFar * m_lodFar;
+	for (unsigned int i = 0; i < m_physicsNodes.size(); ++i)
+	{
+		PhysicsNode* node = m_physicsNodes[i];
+		btRigidBody* body = node->m_rigidBody;
+		if (body->isStaticOrKinematicObject())
+			continue;
+
+		const btScalar distance2 = body->getWorldTransform().getOrigin().distance2(viewpoint);
+		bool simulate = distance2 < nearDistance2;
+		// mid range bodies are spread over the interval to balance the load of the steps
+		if (!simulate && distance2 < farDistance2)
+			simulate = (m_lodTick + (unsigned int) node->m_hordeID) % m_lodInterval == 0;
+
+		if (simulate)
+		{
+			// the gravity has been applied to the active bodies before the step
+			if (node->lodWake() && body->getTotalForce().fuzzyZero())
+				body->applyGravity();
+		}
+		else
+		{
+			node->lodSleep();
+			// far bodies stay frozen
+			if (node->m_lodAsleep && distance2 < farDistance2)
+				node->lodExtrapolate(timeStep);
+		}
+	}
+}
+
+void Physics::queueConstraints( int hordeID, const ConstraintDefinition* constraints, int count )
+{
+	for (int i = 0; i < count; ++i)
+	{
+		PendingConstraint pending;
+		pending.hordeID = hordeID;
+		pending.definition = constraints[i];
+		m_pendingConstraints.push_back(pending);
+	}
+}
+
+void Physics::resolveConstraints()
+{
+	if (m_pendingConstraints.empty())
+		return;
+
+	map<int, btRigidBody*> bodies;
+	const int numObjects = m_physicsWorld->getNumCollisionObjects();
+	for (int i = 0; i < numObjects; ++i)
+	{
+		PhysicsNode* node = (PhysicsNode*) m_physicsWorld->getCollisionObjectArray()[i]->getUserPointer();
+		if (node)
+			bodies[node->m_hordeID] = node->m_rigidBody;
+	}
+
+	vector< pair<btTypedConstraint*, bool> > created;
+	unsigned int remaining = 0;
+	for (unsigned int i = 0; i < m_pendingConstraints.size(); ++i)
+	{
+		const PendingConstraint& pending = m_pendingConstraints[i];
+		const char* name = h3dGetNodeParamStr(pending.hordeID, H3DNodeParams::NameStr);
+		int targetID = 0;
+		if (pending.definition.target[0] != 0)
+		{
+			// The closest ancestor containing a node of that name decides, so each instance of a scene uses its own nodes
+			for (int scope = h3dGetNodeParent(pending.hordeID); scope != 0 && targetID == 0; scope = h3dGetNodeParent(scope))
+				targetID = SceneSearch::findNode(scope, pending.definition.target, H3DNodeTypes::Undefined);
+			if (targetID == 0)
+			{
+				printf("Constraint of node '%s': target node '%s' not found\n", name, pending.definition.target);
+				continue;
+			}
+		}
+
+		// Constraints without target connect the body to the world
+		const int hordeIDs[2] = { pending.hordeID, targetID };
+		btRigidBody* constraintBodies[2] = { 0, &btTypedConstraint::getFixedBody() };
+		bool waiting = false, missing = false, evicted = false;
+		for (int j = 0; j < 2; ++j)
+		{
+			if (hordeIDs[j] == 0)
+				continue;
+			map<int, btRigidBody*>::const_iterator iter = bodies.find(hordeIDs[j]);
+			if (iter != bodies.end())
+				constraintBodies[j] = iter->second;
+			else if (find_if(m_cookingNodes.begin(), m_cookingNodes.end(), [&](PhysicsNode* node) { return node->m_hordeID == hordeIDs[j]; }) !=
+				m_cookingNodes.end())
+				waiting = true;
+			else if (j == 1 && m_partition.isEvicted(targetID))
+				evicted = true;
+			else
+				missing = true;
+		}
+		if (missing || constraintBodies[0] == constraintBodies[1])
+		{
+			printf("Constraint of node '%s' doesn't connect two physics bodies\n", name);
+			continue;
+		}
+		if (evicted)
+		{
+			// restoreBody() queues the constraint again once the target is back
+			m_parkedConstraints.push_back(make_pair(targetID, pending));
+			continue;
+		}
+		if (waiting)
+		{
+			m_pendingConstraints[remaining++] = pending;
+			continue;
+		}
+		btTypedConstraint* constraint = createConstraint(pending.definition, pending.hordeID, *constraintBodies[0], *constraintBodies[1]);
+		if (constraint)
+		{
+			created.push_back(make_pair(constraint, pending.definition.collide));
+			m_constraintSources[constraint] = pending;
+		}
+	}
+	m_pendingConstraints.resize(remaining);
+	if (!created.empty())
+		addConstraints(created);
+}
+
+btTypedConstraint* Physics::createConstraint( const ConstraintDefinition& definition, int hordeID, btRigidBody& bodyA, btRigidBody& bodyB )
+{
+	const float* x = 0;
+	h3dGetNodeTransMats(hordeID, 0, &x);
+	const Matrix4f nodeTrans(x);
+	const Vec3f pivot = nodeTrans * Vec3f(definition.pivot[0], definition.pivot[1], definition.pivot[2]);
+	const Vec3f axis = nodeTrans.mult33Vec(Vec3f(definition.axis[0], definition.axis[1], definition.axis[2]));
+	if (!(axis.length() > 0.0f))
+	{
+		printf("Constraint of node '%s' has an invalid axis\n", h3dGetNodeParamStr(hordeID, H3DNodeParams::NameStr));
+		return 0;
+	}
+
+	// Hinges rotate around the z axis of their frames, sliders and springs move along the x axis
+	const btVector3 frameAxis = definition.type == ConstraintDefinition::Hinge ? btVector3(0, 0, 1) : btVector3(1, 0, 0);
+	const Vec3f direction = axis.normalized();
+	const btTransform frame(shortestArcQuat(frameAxis, btVector3(direction.x, direction.y, direction.z)), btVector3(pivot.x, pivot.y, pivot.z));
+	const btTransform frameA = bodyA.getWorldTransform().inverse() * frame;
+	const btTransform frameB = bodyB.getWorldTransform().inverse() * frame;
+	const bool limited = definition.low <= definition.high;
+
+	btTypedConstraint* constraint = 0;
+	switch (definition.type)
+	{
+	case ConstraintDefinition::Point:
+		constraint = new btPoint2PointConstraint(bodyA, bodyB, frameA.getOrigin(), frameB.getOrigin());
+		break;
+	case ConstraintDefinition::Hinge:
+		{
+			btHingeConstraint* hinge = new btHingeConstraint(bodyA, bodyB, frameA, frameB);
+			if (limited)
+				hinge->setLimit(definition.low * SIMD_RADS_PER_DEG, definition.high * SIMD_RADS_PER_DEG);
+			constraint = hinge;
+		}
+		break;
+	case ConstraintDefinition::Slider:
+		{
+			btSliderConstraint* slider = new btSliderConstraint(bodyA, bodyB, frameA, frameB, true);
+			if (limited)
+			{
+				slider->setLowerLinLimit(definition.low);
+				slider->setUpperLinLimit(definition.high);
+			}
+			constraint = slider;
+		}
+		break;
+	case ConstraintDefinition::Spring:
+		{
+			// the bodies are locked except for the translation along the axis
+			btGeneric6DofSpring2Constraint* spring = new btGeneric6DofSpring2Constraint(bodyA, bodyB, frameA, frameB);
+			spring->setLimit(0, definition.low, definition.high);
+			spring->enableSpring(0, true);
+			spring->setStiffness(0, definition.stiffness);
+			spring->setDamping(0, definition.damping);
+			spring->setEquilibriumPoint(0, 0);
+			constraint = spring;
+		}
+		break;
+	}
+	if (definition.breakingImpulse > 0)
+		constraint->setBreakingImpulseThreshold(definition.breakingImpulse);
+	return constraint;
+}
+
+void Physics::addConstraints( vector< pair<btTypedConstraint*, bool> >& constraints )
+{
+	// Constraints of the same island are added next to each other, breadth first starting at a constraint to a static
+	// or kinematic body. The solver processes them in the order the impulses propagate from the anchor, which the island
+	// sort of the parallel world keeps.
+	map<const btRigidBody*, vector<int> > bodyConstraints;
+	for (unsigned int i = 0; i < constraints.size(); ++i)
+	{
+		const btRigidBody* bodies[2] = { &constraints[i].first->getRigidBodyA(), &constraints[i].first->getRigidBodyB() };
+		for (int j = 0; j < 2; ++j)
+		{
+			if (!bodies[j]->isStaticOrKinematicObject())
+				bodyConstraints[bodies[j]].push_back(i);
+		}
+	}
+
+	vector<int> order;
+	order.reserve(constraints.size());
+	vector<bool> added(constraints.size(), false);
+	// anchored constraints start the islands in the first pass, islands without anchor follow in the second
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (unsigned int seed = 0; seed < constraints.size(); ++seed)
+		{
+			const btTypedConstraint* constraint = constraints[seed].first;
+			if (added[seed] || (pass == 0 && !constraint->getRigidBodyA().isStaticOrKinematicObject() && 
+				!constraint->getRigidBodyB().isStaticOrKinematicObject()))
+				continue;
+			added[seed] = true;
+			order.push_back(seed);
+			for (size_t next = order.size() - 1; next < order.size(); ++next)
+			{
+				const btTypedConstraint* current = constraints[order[next]].first;
+				const btRigidBody* bodies[2] = { &current->getRigidBodyA(), &current->getRigidBodyB() };
+				for (int j = 0; j < 2; ++j)
+				{
+					map<const btRigidBody*, vector<int> >::const_iterator iter = bodyConstraints.find(bodies[j]);
+					if (iter == bodyConstraints.end())
+						continue;
+					for (unsigned int k = 0; k < iter->second.size(); ++k)
+					{
+						if (!added[iter->second[k]])
+						{
+							added[iter->second[k]] = true;
+							order.push_back(iter->second[k]);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < order.size(); ++i)
+	{
+		m_physicsWorld->addConstraint(constraints[order[i]].first, !constraints[order[i]].second);
+		m_constraints.push_back(constraints[order[i]].first);
+	}
+}
+
+void Physics::removeConstraints( btRigidBody* body )
+{
+	// constraints keep references to both of their bodies
+	while (body->getNumConstraintRefs() > 0)
+	{
+		btTypedConstraint* constraint = body->getConstraintRef(0);
+		m_physicsWorld->removeConstraint(constraint);
+		vector<btTypedConstraint*>::iterator iter = find(m_constraints.begin(), m_constraints.end(), constraint);
+		if (iter != m_constraints.end())
+		{
+			m_constraints.erase(iter);
+			m_constraintSources.erase(constraint);
+			delete constraint;
+		}
+	}
+}
+
+void Physics::parkConstraints( PhysicsNode* node )
+{
+	// the node's own constraints are read again from its attachment when it is restored
+	for (unsigned int i = 0; i < m_parkedConstraints.size(); )
+	{
+		if (m_parkedConstraints[i].second.hordeID == node->m_hordeID)
+			m_parkedConstraints.erase(m_parkedConstraints.begin() + i);
+		else
+			++i;
+	}
+	btRigidBody* body = node->m_rigidBody;
+	for (int i = 0; i < body->getNumConstraintRefs(); ++i)
+	{
+		map<btTypedConstraint*, PendingConstraint>::const_iterator iter = m_constraintSources.find(body->getConstraintRef(i));
+		if (iter != m_constraintSources.end() && iter->second.hordeID != node->m_hordeID)
+			m_parkedConstraints.push_back(make_pair(node->m_hordeID, iter->second));
+	}
+}
+
+void Physics::queueVehicle( int hordeID, const VehicleDefinition& vehicle )
+{
+	if (vehicle.numWheels == 0)
+		return;
+	PendingVehicle pending;
+	pending.hordeID = hordeID;
+	pending.definition = vehicle;
+	m_pendingVehicles.push_back(pending);
+}
+
+void Physics::resolveVehicles()
+{
+	unsigned int remaining = 0;
+	for (unsigned int i = 0; i < m_pendingVehicles.size(); ++i)
+	{
+		const PendingVehicle& pending = m_pendingVehicles[i];
+		PhysicsNode* node = findNode(pending.hordeID);
+		if (node && node->needsCooking())
+		{
+			m_pendingVehicles[remaining++] = pending;
+			continue;
+		}
+		if (!node || !node->m_motionState || node->m_rigidBody->isStaticOrKinematicObject())
+		{
+			printf("Vehicle of node '%s' requires a dynamic body\n", h3dGetNodeParamStr(pending.hordeID, H3DNodeParams::NameStr));
+			continue;
+		}
+		removeVehicle(node->m_rigidBody);
+		Vehicle* vehicle = new Vehicle(node->m_rigidBody, pending.hordeID, pending.definition);
+		if (vehicle->isValid())
+			m_vehicles->add(vehicle);
+		else
+			delete vehicle;
+	}
+	m_pendingVehicles.resize(remaining);
+}
+
+void Physics::removeVehicle( btRigidBody* chassis )
+{
+	delete m_vehicles->remove(chassis);
+}
+
+PhysicsNode* Physics::findNode( int hordeID )
+{
+	for (unsigned int i = 0; i < m_cookingNodes.size(); ++i)
+	{
+		if( m_cookingNodes[i]->m_hordeID == hordeID )
+			return m_cookingNodes[i];
+	}
+	int numObjects = m_physicsWorld->getNumCollisionObjects();
+	for (int i = 0; i < numObjects; ++i)
+	{
+		btCollisionObject* colObj = m_physicsWorld->getCollisionObjectArray()[i];
+		PhysicsNode* nodePtr = ((PhysicsNode*)((btCollisionObject*) colObj)->getUserPointer());
+		if( nodePtr && nodePtr->m_hordeID == hordeID )
+			return nodePtr;
+	}	
+	return 0;
+}
+
+void Physics::removePhysicsNode( int node )
+{
+	delete instance()->findNode(node);
+	vector<PendingConstraint>& pending = instance()->m_pendingConstraints;
+	for (unsigned int i = 0; i < pending.size(); )
+	{
+		if (pending[i].hordeID == node)
+			pending.erase(pending.begin() + i);
+		else
+			++i;
+	}
+	vector< pair<int, PendingConstraint> >& parked = instance()->m_parkedConstraints;
+	for (unsigned int i = 0; i < parked.size(); )
+	{
+		if (parked[i].first == node || parked[i].second.hordeID == node)
+			parked.erase(parked.begin() + i);
+		else
+			++i;
+	}
+	vector<PendingVehicle>& pendingVehicles = instance()->m_pendingVehicles;
+	for (unsigned int i = 0; i < pendingVehicles.size(); ++i)
+	{
+		if (pendingVehicles[i].hordeID == node)
+		{
+			pendingVehicles.erase(pendingVehicles.begin() + i);
+			break;
+		}
+	}
+	vector<Ragdoll*>& ragdolls = instance()->m_ragdolls;
+	for (unsigned int i = 0; i < ragdolls.size(); ++i)
+	{
+		if (ragdolls[i]->hordeID() == node)
+		{
+			delete ragdolls[i];
+			ragdolls.erase(ragdolls.begin() + i);
+			break;
+		}
+	}
+	instance()->removeCharacter(node);
+	instance()->removeTrigger(node);
+	instance()->m_partition.forget(node);
+}
+
+void Physics::createCharacter( int hordeID, float radius, float height, float stepHeight )
+{
+	removeCharacter(hordeID);
+	Character* character = new Character(hordeID, radius, height, stepHeight, m_physicsWorld->getGravity().length());
+	// characters collide with static and dynamic objects, other characters avoid each other by their steering
+	m_physicsWorld->addCollisionObject(character->ghostObject(), btBroadphaseProxy::CharacterFilter, 
+		btBroadphaseProxy::StaticFilter | btBroadphaseProxy::DefaultFilter | btBroadphaseProxy::SensorTrigger);
+	m_characters->add(character);
+}
+
+bool Physics::removeCharacter( int hordeID )
+{
+	Character* character = m_characters->remove(hordeID);
+	if (!character)
+		return false;
+	m_physicsWorld->removeCollisionObject(character->ghostObject());
+	delete character;
+	return true;
+}
+
+void Physics::setWorldPartition( float cellSize, int activeCells, int loadedCells )
+{
+	const bool enabled = m_partition.isEnabled();
+	m_partition.setup(cellSize, activeCells, loadedCells);
+	m_partitionChanged = true;
+	if (!enabled || m_partition.isEnabled())
+		return;
+	// bodies put to sleep by the partition are left to the simulation LOD from now on
+	if (m_lodFar <= 0)
+	{
+		for (unsigned int i = 0; i < m_physicsNodes.size(); ++i)
+			m_physicsNodes[i]->lodWake();
+	}
+	vector<WorldPartition::BodyState> states;
+	m_partition.load(states, true);
+	for (unsigned int i = 0; i < states.size(); ++i)
+		restoreBody(states[i]);
+	resolveConstraints();
+	resolveVehicles();
+}
+
+void Physics::setPartitionFocus( float x, float z )
+{
+	if (m_partition.setFocus(x, z))
+		m_partitionChanged = true;
+}
+
+void Physics::updatePartition()
+{
+	m_partitionChanged = false;
+	if (!m_partition.isEnabled())
+		return;
+
+	// nodes are deleted while the world is traversed, so they are collected first
+	vector<PhysicsNode*> nodes;
+	const int numObjects = m_physicsWorld->getNumCollisionObjects();
+	for (int i = 0; i < numObjects; ++i)
+	{
+		PhysicsNode* node = (PhysicsNode*) m_physicsWorld->getCollisionObjectArray()[i]->getUserPointer();
+		if (node)
+			nodes.push_back(node);
+	}
+	for (unsigned int i = 0; i < nodes.size(); ++i)
+	{
+		PhysicsNode* node = nodes[i];
+		btRigidBody* body = node->m_rigidBody;
+		const btTransform& transformation = body->getWorldTransform();
+		const bool dynamic = !body->isStaticOrKinematicObject();
+		switch (m_partition.ring(transformation.getOrigin().x(), transformation.getOrigin().z()))
+		{
+		case WorldPartition::Active:
+			// the simulation LOD decides about the bodies close to the focus
+			if (m_lodFar <= 0)
+				node->lodWake();
+			break;
+		case WorldPartition::Sleeping:
+			if (dynamic)
+				node->lodSleep();
+			break;
+		case WorldPartition::Evicted:
+			{
+				WorldPartition::BodyState state;
+				state.hordeID = node->m_hordeID;
+				state.dynamic = dynamic;
+				// bodies frozen by the LOD continue with their saved velocities
+				state.sleeping = !body->isActive() && !node->m_lodAsleep;
+				const btQuaternion rotation = transformation.getRotation();
+				for (int j = 0; j < 3; ++j)
+				{
+					state.position[j] = transformation.getOrigin()[j];
+					state.linearVelocity[j] = node->m_lodAsleep ? node->m_lodLinearVelocity[j] : body->getLinearVelocity()[j];
+					state.angularVelocity[j] = node->m_lodAsleep ? node->m_lodAngularVelocity[j] : body->getAngularVelocity()[j];
+				}
+				for (int j = 0; j < 4; ++j)
+					state.rotation[j] = rotation[j];
+				m_partition.store(state);
+				// deleting the node removes the constraints other nodes define on it as well
+				parkConstraints(node);
+				delete node;
+			}
+			break;
+		}
+	}
+
+	vector<WorldPartition::BodyState> states;
+	m_partition.load(states, false);
+	for (unsigned int i = 0; i < states.size(); ++i)
+		restoreBody(states[i]);
+	resolveConstraints();
+	resolveVehicles();
+}
+
+void Physics::restoreBody( const WorldPartition::BodyState& state )
+{
+	// constraints other nodes define on this one were removed on eviction, they are dropped again if the node is gone
+	for (unsigned int i = 0; i < m_parkedConstraints.size(); )
+	{
+		if (m_parkedConstraints[i].first == state.hordeID)
+		{
+			m_pendingConstraints.push_back(m_parkedConstraints[i].second);
+			m_parkedConstraints.erase(m_parkedConstraints.begin() + i);
+		}
+		else
+			++i;
+	}
+	// the attachment is read again, nodes removed from the scene in the meantime are dropped
+	const char* attachment = h3dGetNodeParamStr(state.hordeID, H3DNodeParams::AttachmentStr);
+	CollisionShape collisionShape;
+	ConstraintDefinition constraints[ConstraintDefinition::MaxPerAttachment];
+	int numConstraints = 0;
+	VehicleDefinition vehicle;
+	if (!attachment || *attachment == 0 || 
+		!AttachmentParser::parse(attachment, collisionShape, constraints, ConstraintDefinition::MaxPerAttachment, &numConstraints, &vehicle))
+		return;
+	PhysicsNode* node = prepareNode(collisionShape, state.hordeID);
+	queueConstraints(state.hordeID, constraints, numConstraints);
+	queueVehicle(state.hordeID, vehicle);
+	if (!node)
+		return;
+	if (node->needsCooking())
+	{
+		m_pendingRestores.push_back(make_pair(node, state));
+		return;
+	}
+	// the body enters the broadphase at its restored position
+	restoreState(node, state);
+	addNode(node);
+}
+
+void Physics::restoreState( PhysicsNode* node, const WorldPartition::BodyState& state )
+{
+	node->applyCookingShift();
+	btRigidBody* body = node->m_rigidBody;
+	if (!state.dynamic || body->isStaticOrKinematicObject())
+		return;
+	const btTransform transformation(btQuaternion(state.rotation[0], state.rotation[1], state.rotation[2], state.rotation[3]),
+		btVector3((btScalar) state.position[0], (btScalar) state.position[1], (btScalar) state.position[2]));
+	body->setWorldTransform(transformation);
+	body->setInterpolationWorldTransform(transformation);
+	if (node->m_motionState)
+		node->m_motionState->setWorldTransform(transformation);
+	body->setLinearVelocity(btVector3(state.linearVelocity[0], state.linearVelocity[1], state.linearVelocity[2]));
+	body->setAngularVelocity(btVector3(state.angularVelocity[0], state.angularVelocity[1], state.angularVelocity[2]));
+	if (state.sleeping)
+		body->setActivationState(ISLAND_SLEEPING);
+	if (body->getBroadphaseHandle())
+		m_physicsWorld->updateSingleAabb(body);
+	if (m_partition.isEnabled() && m_partition.ring((float) state.position[0], (float) state.position[2]) == WorldPartition::Sleeping)
+		node->lodSleep();
+}
+
+void Physics::shiftOrigin( float x, float y, float z )
+{
+	m_originShift[0] += x;
+	m_originShift[1] += y;
+	m_originShift[2] += z;
+	m_originShiftPending = true;
+}
+
+void Physics::setOriginShiftThreshold( float distance )
+{
+	m_originShiftThreshold = max(distance, 0.0f);
+}
+
+void Physics::setOriginFocus( float x, float y, float z )
+{
+	// the distance is measured from the origin of a shift that is still pending
+	x -= m_originShift[0];
+	y -= m_originShift[1];
+	z -= m_originShift[2];
+	if (m_originShiftThreshold > 0 && x * x + y * y + z * z > m_originShiftThreshold * m_originShiftThreshold)
+		shiftOrigin(x, y, z);
+}
+
+void Physics::originOffset( double* x, double* y, double* z ) const
+{
+	if (x) *x = m_originOffset[0];
+	if (y) *y = m_originOffset[1];
+	if (z) *z = m_originOffset[2];
+}
+
+void Physics::rebaseOrigin()
+{
+	m_originShiftPending = false;
+	const btVector3 translation(-m_originShift[0], -m_originShift[1], -m_originShift[2]);
+	for (int i = 0; i < 3; ++i)
+		m_originOffset[i] += m_originShift[i];
+	// nodes with deferred transformations are written before the shift, their stale poses would be wrong afterwards
+	flushTransforms();
+
+	// bodies, ghost objects and ragdoll colliders, the overlapping pairs and contact manifolds stay valid
+	const int numObjects = m_physicsWorld->getNumCollisionObjects();
+	for (int i = 0; i < numObjects; ++i)
+	{
+		btCollisionObject* object = m_physicsWorld->getCollisionObjectArray()[i];
+		PhysicsNode* node = (PhysicsNode*) object->getUserPointer();
+		if (node)
+			node->shiftOrigin(translation);
+		else
+		{
+			object->getWorldTransform().getOrigin() += translation;
+			object->getInterpolationWorldTransform().getOrigin() += translation;
+		}
+	}
+	m_pairCache->shiftOrigin(translation, m_dispatcher);
+	for (int i = 0; i < m_dispatcher->getNumManifolds(); ++i)
+	{
+		btPersistentManifold* manifold = m_dispatcher->getManifoldByIndexInternal(i);
+		for (int j = 0; j < manifold->getNumContacts(); ++j)
+		{
+			manifold->getContactPoint(j).m_positionWorldOnA += translation;
+			manifold->getContactPoint(j).m_positionWorldOnB += translation;
+		}
+	}
+	// nodes on worker threads are moved once they have been cooked
+	for (unsigned int i = 0; i < m_cookingNodes.size(); ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			m_cookingNodes[i]->m_cookingShift[j] += translation[j];
+	}
+
+	// constraints to the world keep their world frame in the fixed body's frame
+	for (int i = 0; i < m_physicsWorld->getNumConstraints(); ++i)
+	{
+		btTypedConstraint* constraint = m_physicsWorld->getConstraint(i);
+		if (&constraint->getRigidBodyB() != &btTypedConstraint::getFixedBody())
+			continue;
+		switch (constraint->getConstraintType())
+		{
+		case POINT2POINT_CONSTRAINT_TYPE:
+			{
+				btPoint2PointConstraint* point = static_cast<btPoint2PointConstraint*>(constraint);
+				point->setPivotB(point->getPivotInB() + translation);
+			}
+			break;
+		case HINGE_CONSTRAINT_TYPE:
+			static_cast<btHingeConstraint*>(constraint)->getBFrame().getOrigin() += translation;
+			break;
+		case SLIDER_CONSTRAINT_TYPE:
+			static_cast<btSliderConstraint*>(constraint)->getFrameOffsetB().getOrigin() += translation;
+			break;
+		case D6_SPRING_2_CONSTRAINT_TYPE:
+			static_cast<btGeneric6DofSpring2Constraint*>(constraint)->getFrameOffsetB().getOrigin() += translation;
+			break;
+		default:
+			break;
+		}
+	}
+
+	for (unsigned int i = 0; i < m_ragdolls.size(); ++i)
+		m_ragdolls[i]->shiftOrigin(translation);
+	for (int i = 0; i < m_characters->numCharacters(); ++i)
+		m_characters->character(i)->shiftOrigin(translation);
+	for (int i = 0; i < 3; ++i)
+		m_lodViewpoint[i] += translation[i];
+	m_partition.shiftOrigin(m_originShift[0], m_originShift[1], m_originShift[2]);
+	m_originShift[0] = m_originShift[1] = m_originShift[2] = 0;
+
+	// Horde3D keeps the local transformations, the absolute ones of all nodes follow the root node, whose
+	// own transformation set by the application is kept
+	float tx, ty, tz, rx, ry, rz, sx, sy, sz;
+	h3dGetNodeTransform(H3DRootNode, &tx, &ty, &tz, &rx, &ry, &rz, &sx, &sy, &sz);
+	h3dSetNodeTransform(H3DRootNode, tx + translation.x(), ty + translation.y(), tz + translation.z(), rx, ry, rz, sx, sy, sz);
+	// Moving the root flags all nodes as transformed. The scene sync would teleport and wake up every body,
+	// so the flags of the nodes driven by physics are reset.
+	for (int i = 0; i < numObjects; ++i)
+	{
+		const PhysicsNode* node = (const PhysicsNode*) m_physicsWorld->getCollisionObjectArray()[i]->getUserPointer();
+		if (node)
+			h3dCheckNodeTransFlag(node->m_hordeID, true);
+	}
+	for (unsigned int i = 0; i < m_cookingNodes.size(); ++i)
+		h3dCheckNodeTransFlag(m_cookingNodes[i]->m_hordeID, true);
+	for (int i = 0; i < m_triggers.numTriggers(); ++i)
+		h3dCheckNodeTransFlag(m_triggers.trigger(i)->hordeID(), true);
+}
+
+void Physics::setDebugDraw( int cameraID, int categories, int materialRes, int maxLines )
+{
+	if (cameraID == 0 || categories == 0)
+	{
+		m_physicsWorld->setDebugDrawer(0);
+		delete m_debugDrawer;
+		m_debugDrawer = 0;
+		return;
+	}
+	if (!m_debugDrawer)
+		m_debugDrawer = new DebugDrawer();
+	m_debugDrawer->setup(cameraID, categories, materialRes, maxLines);
+	// the world draws the shapes and constraints through its own debug drawer
+	m_physicsWorld->setDebugDrawer(m_debugDrawer);
+}
+
+void Physics::setOverlapFilter( Horde3DPhysics::OverlapFilter filter, void* userData )
+{
+	m_overlapFilter.filter = filter;
+	m_overlapFilter.userData = userData;
+	// pairs that already exist are not filtered again
+	m_pairCache->getOverlappingPairCache()->setOverlapFilterCallback(filter ? &m_overlapFilter : 0);
+}
+
+bool Physics::OverlapFilterCallback::needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const
+{
+	// the test of btOverlappingPairCache without a filter callback
+	if (!(proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) || !(proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask))
+		return false;
+	// objects that don't belong to a node are passed as 0
+	const int id0 = ((const btCollisionObject*) proxy0->m_clientObject)->getUserIndex();
+	const int id1 = ((const btCollisionObject*) proxy1->m_clientObject)->getUserIndex();
+	return filter(id0 > 0 ? id0 : 0, id1 > 0 ? id1 : 0, userData);
+}
+
+void Physics::createTrigger( const CollisionShape& shape, int hordeID )
+{
+	if (shape.compound || (shape.type != CollisionShape::Box && shape.type != CollisionShape::Sphere))
+	{
+		printf("Trigger of node '%s' has to be a box or a sphere\n", h3dGetNodeParamStr(hordeID, H3DNodeParams::NameStr));
+		return;
+	}
+	const float* x = 0;
+	h3dGetNodeTransMats(hordeID, 0, &x);
+	if (!x)
+		return;
+	Vec3f t, r, s;
+	Matrix4f(x).decompose(t, r, s);
+	ShapeRecipe recipe;
+	recipe.type = shape.type;
+	memcpy(recipe.extents, shape.extents, sizeof(recipe.extents));
+	recipe.radius = shape.radius;
+	const float scaling[3] = { s.x, s.y, s.z };
+
+	removeTrigger(hordeID);
+	Trigger* trigger = new Trigger(hordeID, acquireSharedShape(recipe, scaling));
+	trigger->setTransformation(x);
+	h3dCheckNodeTransFlag(hordeID, true);
+	// static geometry and other triggers are not reported, so their pairs are never created
+	m_physicsWorld->addCollisionObject(trigger->ghostObject(), btBroadphaseProxy::SensorTrigger, 
+		btBroadphaseProxy::AllFilter ^ (btBroadphaseProxy::StaticFilter | btBroadphaseProxy::SensorTrigger));
+	m_triggers.add(trigger);
+}
+
+bool Physics::removeTrigger( int hordeID )
+{
+	Trigger* trigger = m_triggers.remove(hordeID);
+	if (!trigger)
+		return false;
+	m_physicsWorld->removeCollisionObject(trigger->ghostObject());
+	releaseSharedShape(trigger->ghostObject()->getCollisionShape());
+	delete trigger;
+	return true;
+}
+
+void Physics::submitCommand( PhysicsCommand* command )
+{
+	if (!isOwnerThread())
+		m_commands.push(command);
+	else if (executeCommand(command))
+		delete command;
+	else
+		m_pendingCommands.push_back(command);
+}
+
+void Physics::executeCommands()
+{
+	// the retried commands are older than the queued ones
+	vector<PhysicsCommand*> commands;
+	commands.swap(m_pendingCommands);
+	while (PhysicsCommand* command = m_commands.pop())
+		commands.push_back(command);
+
+	for (unsigned int i = 0; i < commands.size(); ++i)
+	{
+		if (executeCommand(commands[i]))
+			delete commands[i];
+		else
+			m_pendingCommands.push_back(commands[i]);
+	}
+}
+
+bool Physics::executeCommand( PhysicsCommand* command )
+{
+	switch (command->type)
+	{
+	case PhysicsCommand::CreateNode:
+		createPhysicsNode(command->hordeID, command->xmlText.c_str());
+		return true;
+	case PhysicsCommand::CreateNodes:
+		createPhysicsNodes(command->hordeID);
+		return true;
+	case PhysicsCommand::RemoveNode:
+		removePhysicsNode(command->hordeID);
+		return true;
+	case PhysicsCommand::CreateCharacter:
+		createCharacter(command->hordeID, command->values[0], command->values[1], command->values[2]);
+		return true;
+	case PhysicsCommand::RemoveCharacter:
+		removeCharacter(command->hordeID);
+		return true;
+	case PhysicsCommand::MoveCharacter:
+	case PhysicsCommand::JumpCharacter:
+		if (Character* character = m_characters->find(command->hordeID))
+		{
+			if (command->type == PhysicsCommand::MoveCharacter)
+				character->setVelocity(btVector3(command->values[0], command->values[1], command->values[2]));
+			else
+				character->controller()->jump();
+		}
+		return true;
+	case PhysicsCommand::VehicleControls:
+		if (Vehicle* vehicle = m_vehicles->find(command->hordeID))
+			vehicle->setControls(command->values[0], command->values[1], command->values[2]);
+		else if (PhysicsNode* node = findNode(command->hordeID))
+			// the chassis may still be cooking
+			return !node->needsCooking();
+		return true;
+	default:
+		break;
+	}
+
+	PhysicsNode* node = findNode(command->hordeID);
+	if (!node)
+		return true;
+	if (node->needsCooking())
+		return false;
+	if (command->type == PhysicsCommand::ApplyImpulse)
+		node->applyImpulse(&command->values[0], &command->values[3]);
+	else
+	{
+		node->teleport(command->values);
+		// static nodes are not synchronized by render()
+		if (!node->m_motionState)
+			node->update();
+		// cooked nodes are added to the world by the next render() call
+		if (node->m_rigidBody->getBroadphaseHandle())
+			m_physicsWorld->updateSingleAabb(node->m_rigidBody);
+	}
+	return true;
 }
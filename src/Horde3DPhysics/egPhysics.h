@@ -25,25 +25,45 @@
 #pragma once
 
 #include <Horde3D/Horde3D.h>
+#include <Horde3D/utMath.h>
 
+#include <cstring>
 #include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
 #include <Bullet/btBulletDynamicsCommon.h>
+#include <Bullet/BulletDynamics/ConstraintSolver/btGeneric6DofSpring2Constraint.h>
 
-/// Helper struct for loading collision objects
-struct CollisionShape
-{
-	enum Type {Box, Sphere, Mesh};
-	Type type;
-	float mass;
-	bool kinematic;
+#include "egTaskScheduler.h"
+#include "egParallelDynamicsWorld.h"
+#include "egParallelDispatcher.h"
+#include "egAttachment.h"
+#include "egPhysicsBlob.h"
+#include "egCommandQueue.h"
+#include "egWorldSnapshot.h"
+#include "egRagdoll.h"
+#include "egCharacter.h"
+#include "egVehicle.h"
+#include "egTrigger.h"
+#include "egDebugDrawer.h"
+#include "egWorldPartition.h"
+#include "egBroadphase.h"
+#include "egSceneSearch.h"
 
-	union
-	{
-		float extents[3];
-		float radius;
-	};
-
-	CollisionShape() : type(Mesh), mass(0.0f), kinematic(false) {}
+/// Collision geometry gathered from the Horde3D scene graph, cooked into a btCollisionShape later on
+struct ShapeRecipe
+{
+	CollisionShape::Type		type;
+	float						extents[3];
+	float						radius;
+	/// Vertex positions of a mesh shape
+	std::vector<float>			vertices;
+	/// Triangle list indices into the vertex positions of a mesh shape
+	std::vector<unsigned int>	indices;
+	/// Transformation relative to the model node (OpenGL matrix without scale), used by compound shapes only
+	float						transformation[16];
+	float						scaling[3];
 };
 
 /**
@@ -56,8 +76,11 @@ class PhysicsNode
 public:
 	/** 
 	 * Constructor
+	 * 
+	 * Gathers all data needed to build the collision shape from the scene graph. The shape and
+	 * the rigid body will be created by cook().
 	 * @param shape information data about the collision shape
-	 * @param meshNodeID id of the mesh node needed in case the collision shape is of type mesh
+	 * @param hordeID id of the Horde3D node, needed in case the collision shape is of type mesh
 	 */
 	PhysicsNode( CollisionShape shape, int hordeID);
 	/// Destructor
@@ -72,20 +95,187 @@ public:
 	 */
 	void update();
 
+	/**
+	 * Transfers the given transformation to the node this node is attached to
+	 * @param x absolute transformation calculated by calcTransformation
+	 */
+	void update(const float* x);
+
+	/**
+	 * Calculates the absolute transformation of the rigid body including the scale
+	 * Does not access the Horde3D engine, so it is safe to call it from a worker thread.
+	 * @param x receives the OpenGL matrix
+	 */
+	void calcTransformation(float* x) const;
+
+	/**
+	 * Transfers a transformation whose transfer has been deferred by deferUpdate
+	 */
+	void flush() { if (m_updateDeferred) update(); }
+
+	/**
+	 * Reads the current pose of the body, does not access the Horde3D engine
+	 * @return true if the pose differs from the one read by the previous call
+	 */
+	bool updatePose();
+
+	/**
+	 * Returns the pose read by updatePose, the position followed by the rotation quaternion (x, y, z, w)
+	 */
+	const float* pose() const { return m_pose; }
+
+	/**
+	 * Builds the collision shapes, computes the inertia and creates the rigid body.
+	 * Does not access the Horde3D engine, so it is safe to call it from a worker thread.
+	 */
+	void cook();
+
+	/**
+	 * Returns true if the collision shape still has to be cooked
+	 */
+	bool needsCooking() const { return m_cookState != Cooked; }
+
+	/**
+	 * Returns true if the collision data could be retrieved from the scene graph
+	 */
+	bool isValid() const { return !m_recipes.empty() || m_rigidBody != 0; }
+
+	/**
+	 * Applies an impulse to a dynamic body and wakes it up
+	 * @param impulse the impulse in world coordinates
+	 * @param relativePosition point of application relative to the center of mass
+	 */
+	void applyImpulse(const float* impulse, const float* relativePosition);
+
+	/**
+	 * Moves the body to a new transformation, the velocities are kept
+	 * @param x absolute transformation (OpenGL matrix), its scale is ignored
+	 */
+	void teleport(const float* x);
+
+	/**
+	 * Sets the transformation a kinematic body will move to during the next simulation step
+	 * @param x absolute transformation (OpenGL matrix), its scale is ignored
+	 */
+	void setKinematicTarget(const float* x);
+
 private:
-		
+	/**
+	 * Puts the body to sleep for the simulation LOD, the current velocities are saved for the extrapolation
+	 */
+	void lodSleep();
+
+	/**
+	 * Wakes up a body that has been put to sleep by lodSleep and restores its velocities
+	 * @return true if the body has been sleeping
+	 */
+	bool lodWake();
+
+	/**
+	 * Moves a body that has been put to sleep by lodSleep along its saved velocities
+	 * @param timeStep the simulation time to extrapolate
+	 */
+	void lodExtrapolate(btScalar timeStep);
+
+	/**
+	 * Skips the transfer of the transformation while the node is not visible, it will be done by flush()
+	 */
+	void deferUpdate();
+
+	/**
+	 * Moves the body, its motion state and the cached positions of the node
+	 * @param translation offset added to all positions
+	 */
+	void shiftOrigin(const btVector3& translation);
+
+	/**
+	 * Applies the origin shifts that happened while the node was being cooked, has to be called once it has been cooked
+	 */
+	void applyCookingShift();
+
+	/**
+	 * Returns the broadphase filter of the body, the layers of the attachment or Bullet's defaults
+	 */
+	void collisionFilter(short& group, short& mask) const;
+
+	/**
+	 * Checks if the body or the node at its last transferred position may be visible
+	 * @param frustum the planes of the camera frustum, normals pointing inside
+	 */
+	bool isVisible(const Horde3D::Plane* frustum) const;
+
+	/// Cooking state of the collision shape
+	enum CookState { Gathered, Queued, Cooked };
+
+	/// Task function running cook() on a worker thread
+	static void cookTask(void* node) { ((PhysicsNode*) node)->cook(); }
+
+	/**
+	 * Copies the triangle data of a mesh or model node
+	 * @param hordeID id of the Horde3D mesh or model node providing the geometry
+	 * @param recipe recipe receiving the vertex and index data
+	 * @return false if the geometry couldn't be retrieved
+	 */
+	bool gatherMesh(int hordeID, ShapeRecipe& recipe);
+
+	/**
+	 * Gathers the shapes of all mesh nodes below the given node for a compound collision shape
+	 * @param parentID id of the Horde3D node whose children will be added
+	 * @param modelTrans inverted absolute transformation of the model node the compound belongs to
+	 */
+	void gatherChildShapes(int parentID, const Horde3D::Matrix4f& modelTrans);
+
+	/**
+	 * Creates the collision shape for a recipe
+	 * @param recipe the gathered shape data
+	 * @param dynamic true if the shape will be used by a dynamic body (convex approximation)
+	 */
+	btCollisionShape* cookShape(const ShapeRecipe& recipe, bool dynamic);
+
+	/// Information about the collision shape taken from the attachment
+	CollisionShape					m_shape;
+	/// Shapes gathered from the scene graph, released after cooking
+	std::vector<ShapeRecipe>		m_recipes;
+	/// Initial absolute transformation (OpenGL matrix without scale)
+	float							m_startTransformation[16];
+	/// Scale of the Horde3D node, applied as local scaling of the collision shape
+	float							m_scaling[3];
+	/// Current cooking state, changed by worker threads
+	std::atomic<int>				m_cookState;
+
 	/// Motion state for dynamic objects
 	btDefaultMotionState*			m_motionState;
 	/// The main rigid body physics object
 	btRigidBody*					m_rigidBody;
 	/// The collision shape used for the physics engine
 	btCollisionShape*				m_collisionShape;
-	/// Triangle Collision Mesh, allocated only if the collision shape is of type Mesh
-	btTriangleMesh*					m_btTriangleMesh;
-	/// needed to avoid strange effects when physics transformation get updated from the outside
-	bool							m_selfUpdate;
+	/// true if the collision shape is shared with other nodes and owned by Physics
+	bool							m_sharedShape;
+	/// Triangle Collision Meshes, allocated only if the collision shape is of type Mesh or a compound
+	std::vector<btTriangleMesh*>	m_btTriangleMeshes;
+	/// Child shapes of a compound collision shape
+	std::vector<btCollisionShape*>	m_childShapes;
 	/// ID within the Horde3D scenegraph
 	int								m_hordeID;
+	/// true if the body has been put to sleep by the simulation LOD
+	bool							m_lodAsleep;
+	/// true if the body had contacts during the last simulated step
+	bool							m_lodTouching;
+	/// Simulation time that has been extrapolated since the body has been put to sleep
+	float							m_lodSkipped;
+	/// Velocities of a body put to sleep by the simulation LOD
+	float							m_lodLinearVelocity[3];
+	float							m_lodAngularVelocity[3];
+	/// true if the transfer of the current transformation to Horde3D has been deferred
+	bool							m_updateDeferred;
+	/// Bounding box of the Horde3D node at the last transferred position (min, max)
+	float							m_deferredBounds[6];
+	/// Distance the Horde3D node extends beyond the collision shape
+	float							m_visibilityMargin;
+	/// Pose of the body exported by the last render() call (position and rotation quaternion)
+	float							m_pose[7];
+	/// Translation of the origin shifts that happened while the node was being cooked
+	float							m_cookingShift[3];
 };
 
 /**
@@ -96,6 +286,7 @@ private:
  */
 class Physics
 {
+	friend class PhysicsNode;
 
 public:
 	/**
@@ -120,7 +311,7 @@ public:
 	void addNode(PhysicsNode* node);
 
 	/**
-	 * Removes the node from the world (does not delete the instance)
+	 * Removes the node and the constraints connected to it from the world (does not delete the instance)
 	 * @param node pointer to the instance that should be removed
 	 */
 	void removeNode( PhysicsNode* node );
@@ -138,28 +329,621 @@ public:
 	 */
 	static void createPhysicsNode( int hordeID, const char *xmlText);
 
+	/**
+	 * Creates the physics nodes for all nodes with a physics attachment within a scene graph branch
+	 *
+	 * Primitive collision shapes with equal dimensions are shared and the rigid bodies are inserted 
+	 * into the broadphase in one sorted batch after all nodes have been created.
+	 * @param rootID the id of the root node of the Horde3D scene graph branch
+	 */
+	static void createPhysicsNodes( int rootID );
+
+	/**
+	 * Compiles the physics attachments of a scene graph branch into a binary blob
+	 * @param rootID the id of the root node of the Horde3D scene graph branch
+	 * @param fileName path of the blob file
+	 * @return false if an attachment is invalid or the file couldn't be written
+	 */
+	static bool bakePhysicsNodes( int rootID, const char* fileName );
+
+	/**
+	 * Creates the physics nodes of a scene graph branch from a blob written by bakePhysicsNodes
+	 *
+	 * Works like createPhysicsNodes, but the attachments are read from the memory mapped blob instead
+	 * of being parsed.
+	 * @param rootID the id of the root node of the Horde3D scene graph branch
+	 * @param fileName path of the blob file
+	 * @return false if the blob couldn't be loaded or doesn't match the scene graph branch, no node is created in that case
+	 */
+	static bool loadPhysicsNodes( int rootID, const char* fileName );
+
 	/**
 	 * Static function that has to be called when a node with a physics attachment has been removed from the scene graph
 	 * @param hordeID the id of the Horde3D node
 	 */
 	static void removePhysicsNode( int hordeID);
 
+	/**
+	 * Enables or disables cooking of collision meshes on worker threads
+	 * 
+	 * In asynchronous mode nodes with mesh shapes are registered immediately but inserted into the world
+	 * by the first render() call after their cooking has finished.
+	 * @param enable true to cook on worker threads
+	 */
+	void setAsyncCooking( bool enable );
+
+	/**
+	 * Returns the cooking progress of all nodes created since the last time no cooking was pending
+	 * @return value between 0 and 1, 1 if no cooking is pending
+	 */
+	float cookingProgress() const;
+
+	/**
+	 * Enables or disables processing the narrowphase, solving independent simulation islands and 
+	 * calculating the transformations on the scheduler
+	 * @param enable true to simulate in parallel, the narrowphase, the solver and the vehicle rays stay serial unless this 
+	 * library is built with HORDEPHYSICS_BULLET_NO_PROFILE against a Bullet built without its profiler, which is not thread safe
+	 */
+	void setParallelSimulation( bool enable );
+
+	/**
+	 * Sets the scheduler all parallel work runs on
+	 * @param scheduler the scheduler, 0 to use the built-in work stealing scheduler
+	 */
+	void setScheduler( Horde3DPhysics::ITaskScheduler* scheduler );
+
+	/**
+	 * Returns the physics node attached to the given Horde3D node
+	 * @param hordeID the id of the Horde3D node
+	 * @return pointer to the physics node or 0 if the node has no physics representation
+	 */
+	PhysicsNode* findNode( int hordeID );
+
+	/**
+	 * Configures the distance based level of detail of the simulation
+	 *
+	 * Dynamic bodies closer to the viewpoint than nearDistance are simulated at the full rate. Bodies up to
+	 * farDistance take part in every midInterval-th simulation step only, in between they are kept asleep and 
+	 * their transformations are extrapolated from their last velocities. Bodies further away are frozen and put 
+	 * back to sleep whenever a collision wakes them up. 
+	 * @param nearDistance distance up to which bodies are simulated at the full rate
+	 * @param farDistance distance up to which bodies are simulated at all, 0 disables the LOD
+	 * @param midInterval number of simulation steps between two steps of a mid range body
+	 */
+	void setSimulationLOD( float nearDistance, float farDistance, int midInterval );
+
+	/**
+	 * Sets the position the distances of the simulation LOD are measured from, usually the camera position
+	 */
+	void setLODViewpoint( float x, float y, float z );
+
+	/**
+	 * Configures the world partition, see WorldPartition
+	 * @param cellSize edge length of the cells, 0 disables the partition and restores all evicted bodies
+	 * @param activeCells distance of the cells with simulated bodies, in cells from the focus cell
+	 * @param loadedCells distance of the cells with sleeping bodies
+	 */
+	void setWorldPartition( float cellSize, int activeCells, int loadedCells );
+
+	/**
+	 * Sets the position the cells of the world partition are loaded around, the partition is a 2D grid
+	 * in the XZ plane so the height isn't needed
+	 */
+	void setPartitionFocus( float x, float z );
+
+	/**
+	 * Returns the number of bodies evicted by the world partition
+	 */
+	int numEvictedBodies() const { return m_partition.numEvicted(); }
+
+	/**
+	 * Moves the origin of the physics world and the Horde3D scene to the given position, applied by the next 
+	 * render() call after the scene sync. Several shifts before that call add up.
+	 * @param x,y,z new origin relative to the current one
+	 */
+	void shiftOrigin( float x, float y, float z );
+
+	/**
+	 * Sets the distance of the origin focus from the origin that triggers a shift of the origin to the focus
+	 * @param distance the threshold, 0 disables the automatic shift
+	 */
+	void setOriginShiftThreshold( float distance );
+
+	/**
+	 * Sets the position the origin is shifted to once it is further away than the threshold, usually the player position
+	 */
+	void setOriginFocus( float x, float y, float z );
+
+	/**
+	 * Returns the current origin relative to the initial one
+	 */
+	void originOffset( double* x, double* y, double* z ) const;
+
+	/**
+	 * Sets the camera whose frustum decides which transformations are transferred to Horde3D
+	 *
+	 * Transformations of bodies outside the frustum are not transferred until they become visible or
+	 * flushTransforms() is called.
+	 * @param cameraID the id of the Horde3D camera node, 0 transfers all transformations every frame
+	 */
+	void setVisibilityCamera( int cameraID );
+
+	/**
+	 * Transfers the deferred transformations of all nodes to Horde3D
+	 */
+	void flushTransforms();
+
+	/**
+	 * Returns true if called by the thread that created the Physics instance
+	 *
+	 * Only this thread may change the world and access Horde3D, all other threads have to submit commands.
+	 */
+	bool isOwnerThread() const { return std::this_thread::get_id() == m_ownerThread; }
+
+	/**
+	 * Executes a command immediately if called by the owner thread, otherwise queues it for the next render()
+	 *
+	 * May be called from any thread without locking. Commands targeting a node that is still being cooked
+	 * are retried by each render() call until the node has been added to the world.
+	 * @param command the command allocated with new, it is deleted after its execution
+	 */
+	void submitCommand( PhysicsCommand* command );
+
+	/**
+	 * Enables or disables transferring transformations changed in Horde3D to the physics world
+	 *
+	 * If enabled, render() checks the transformation flag of each node before the simulation step. Moved
+	 * dynamic and static bodies are teleported. Kinematic bodies move to the transformation of their
+	 * Horde3D node during the step whether the sync is enabled or not.
+	 * @param enable true to transfer changed transformations, enabled by default
+	 */
+	void setSceneSync( bool enable );
+
+	/**
+	 * Enables or disables the export of the poses of all bodies that have moved during render()
+	 */
+	void setPoseExport( bool enable );
+
+	/**
+	 * Returns the poses exported by the last render() call
+	 * @param count receives the number of poses
+	 * @return contiguous array of poses, valid until the next render() call
+	 */
+	const Horde3DPhysics::PhysicsPose* poses( int& count ) const;
+
+	/**
+	 * Enables or disables transferring the simulated transformations to the Horde3D scene graph
+	 * @param enable false to skip all scene graph writes, the poses may be exported instead
+	 */
+	void setSceneWrites( bool enable );
+
+	/**
+	 * Enables or disables building a snapshot of the world at the end of each render() call
+	 *
+	 * The snapshot serves read-only queries from any thread without interfering with the simulation.
+	 * @param enable true to build snapshots
+	 */
+	void setQuerySnapshots( bool enable );
+
+	/**
+	 * Returns the snapshot built by the last render() call, may be called from any thread
+	 * @return the snapshot or an empty pointer if snapshots are disabled
+	 */
+	std::shared_ptr<const WorldSnapshot> snapshot() const { return std::atomic_load(&m_snapshot); }
+
+	/**
+	 * Creates a kinematic character controller moving the given node, replaces an existing character of the node
+	 * @param hordeID the id of the Horde3D node
+	 * @param radius radius of the character's capsule
+	 * @param height total height of the capsule
+	 * @param stepHeight maximum height of steps the character climbs
+	 */
+	void createCharacter( int hordeID, float radius, float height, float stepHeight );
+
+	/**
+	 * Removes and deletes the character of a node
+	 * @return false if the node has no character
+	 */
+	bool removeCharacter( int hordeID );
+
+	/**
+	 * Returns the character of a node or 0
+	 */
+	Character* character( int hordeID ) const { return m_characters->find(hordeID); }
+
+	/**
+	 * Returns the trigger events found by the last render() call
+	 * @param count receives the number of events
+	 */
+	const Horde3DPhysics::TriggerEvent* triggerEvents( int& count ) const { return m_triggers.events(count); }
+
+	/**
+	 * Sets the maximum number of trigger events reported by a single render() call
+	 */
+	void setTriggerEventCapacity( int capacity ) { m_triggers.setEventCapacity(capacity); }
+
+	/**
+	 * Sets a callback deciding about the broadphase pairs that pass the collision filter
+	 * @param filter the callback or 0 to use the collision filter only
+	 * @param userData value passed to the callback
+	 */
+	void setOverlapFilter( Horde3DPhysics::OverlapFilter filter, void* userData );
+
+	/**
+	 * Enables the debug view drawn by render()
+	 * @param cameraID camera node the lines are projected with, 0 disables the debug view
+	 * @param categories Horde3DPhysics::DebugDrawCategories flags, 0 disables the debug view
+	 * @param materialRes overlay material
+	 * @param maxLines number of lines drawn at most per frame
+	 */
+	void setDebugDraw( int cameraID, int categories, int materialRes, int maxLines );
+
+	/**
+	 * Returns the number of lines the last render() call couldn't draw within the budget of the debug view
+	 */
+	int debugDrawSkippedLines() const { return m_debugDrawer ? m_debugDrawer->numSkippedLines() : 0; }
+
+	/**
+	 * Returns the vehicle whose chassis is the given node or 0
+	 */
+	Vehicle* vehicle( int hordeID ) const { return m_vehicles->find(hordeID); }
+
 private:
 	/// Private constructor (Singleton)
 	Physics();
 	/// Private destructor 
 	~Physics();
 
+	/**
+	 * Inserts all nodes into the world whose cooking has been finished
+	 */
+	void addCookedNodes();
+
+	/**
+	 * Waits until all queued nodes have been cooked
+	 */
+	void waitForCooking();
+
+	/**
+	 * Executes the queued commands and the ones waiting for their node to be cooked
+	 */
+	void executeCommands();
+
+	/**
+	 * Executes a single command
+	 * @return false if the command has to wait until its node has been cooked
+	 */
+	bool executeCommand( PhysicsCommand* command );
+
+	/**
+	 * Returns the scheduler passed to setScheduler or the built-in one
+	 */
+	Horde3DPhysics::ITaskScheduler* scheduler();
+
+	/**
+	 * Assigns the dynamic bodies to their LOD tier before each simulation step
+	 * @param timeStep the duration of the following simulation step
+	 */
+	void updateLOD( btScalar timeStep );
+
+	/// Internal tick callback of the physics world calling updateLOD and updating the ragdoll joint limits
+	static void preTickCallback( btDynamicsWorld* world, btScalar timeStep );
+
+	/**
+	 * Calculates the frustum planes of the visibility camera
+	 */
+	void updateFrustum();
+
+	/**
+	 * Adds newly created nodes to the world, sorted along the first broadphase axis
+	 * @param nodes the nodes that haven't been added to the world before
+	 */
+	void addNodes( std::vector<PhysicsNode*>& nodes );
+
+	/**
+	 * Creates a physics node and its collision shape or queues it for cooking
+	 * @param shape information about the collision shape
+	 * @param hordeID the id of the Horde3D node
+	 * @return the new node or 0 if the collision data couldn't be retrieved or the shape is a ragdoll,
+	 * which is added to the world immediately
+	 */
+	PhysicsNode* prepareNode( const CollisionShape& shape, int hordeID );
+
+	/**
+	 * Creates the physics nodes of a scene graph branch in one batch
+	 * @param rootID the id of the root node of the Horde3D scene graph branch
+	 * @param hordeIDs the nodes with a physics attachment, parents have to be listed before their children
+	 * @param shapes the collision shape information of each node
+	 */
+	void createBranch( int rootID, const std::vector<int>& hordeIDs, const std::vector<CollisionShape>& shapes );
+
+	/**
+	 * Stores the Constraint elements of an attachment until resolveConstraints() creates them
+	 * @param hordeID the id of the node the attachment belongs to
+	 * @param constraints the definitions read from the attachment
+	 * @param count number of definitions
+	 */
+	void queueConstraints( int hordeID, const ConstraintDefinition* constraints, int count );
+
+	/**
+	 * Finds the target nodes of the queued constraints by name and creates the constraints
+	 *
+	 * Constraints whose nodes are still being cooked stay queued, constraints to an evicted target are parked
+	 * until restoreBody() recreates it and constraints of nodes without a physics body are dropped. Called at the end of a batch or by render() after single nodes have been created, since
+	 * the target of a constraint may be created after the node defining it.
+	 */
+	void resolveConstraints();
+
+	/**
+	 * Creates a constraint in the current pose of its bodies
+	 * @param definition the values of the Constraint element
+	 * @param hordeID the node the pivot and axis of the definition are relative to
+	 * @param bodyA body of the node
+	 * @param bodyB body of the target node or the fixed body
+	 * @return the new constraint or 0 if the definition is invalid
+	 */
+	btTypedConstraint* createConstraint( const ConstraintDefinition& definition, int hordeID, btRigidBody& bodyA, btRigidBody& bodyB );
+
+	/**
+	 * Adds new constraints to the world, grouped by the island they connect
+	 * @param constraints the constraints and whether their bodies collide with each other
+	 */
+	void addConstraints( std::vector< std::pair<btTypedConstraint*, bool> >& constraints );
+
+	/// Removes and deletes all constraints connected to a body
+	void removeConstraints( btRigidBody* body );
+
+	/**
+	 * Keeps the constraints other nodes define on a body that is about to be evicted, they are queued again 
+	 * by restoreBody() once the body is back
+	 * @param node the node whose body is evicted
+	 */
+	void parkConstraints( PhysicsNode* node );
+
+	/// Constraint element waiting for the bodies of its nodes
+	struct PendingConstraint
+	{
+		int						hordeID;
+		ConstraintDefinition	definition;
+	};
+
+	/**
+	 * Stores the Vehicle element of an attachment until resolveVehicles() creates the vehicle
+	 * @param hordeID the id of the chassis node
+	 * @param vehicle the definition read from the attachment, ignored if it has no wheels
+	 */
+	void queueVehicle( int hordeID, const VehicleDefinition& vehicle );
+
+	/**
+	 * Creates the vehicles of all queued Vehicle elements whose chassis is part of the world
+	 *
+	 * Vehicles whose chassis is still being cooked stay queued, vehicles of nodes without a dynamic body
+	 * are dropped.
+	 */
+	void resolveVehicles();
+
+	/// Removes and deletes the vehicle using the body as chassis
+	void removeVehicle( btRigidBody* chassis );
+
+	/**
+	 * Translates all bodies, broadphase proxies and cached positions by the pending origin shift in one pass 
+	 * and moves the Horde3D root node by the accumulated offset
+	 */
+	void rebaseOrigin();
+
+	/**
+	 * Evicts, puts to sleep or wakes up the bodies depending on their cells and restores the bodies of 
+	 * cells that are not evicted anymore
+	 */
+	void updatePartition();
+
+	/**
+	 * Recreates an evicted body from the attachment of its node and queues the constraints parked for it
+	 * @param state the state stored on eviction
+	 */
+	void restoreBody( const WorldPartition::BodyState& state );
+
+	/**
+	 * Applies the state of an evicted body to its recreated node
+	 * @param node the recreated node, its body may not be part of the world yet
+	 * @param state the state stored on eviction
+	 */
+	void restoreState( PhysicsNode* node, const WorldPartition::BodyState& state );
+
+	/**
+	 * Creates a trigger volume for a box or sphere attachment and adds it to the world
+	 * @param shape the collision shape information of the attachment
+	 * @param hordeID the id of the Horde3D node
+	 */
+	void createTrigger( const CollisionShape& shape, int hordeID );
+
+	/**
+	 * Removes and deletes the trigger of a node
+	 * @return false if the node has no trigger
+	 */
+	bool removeTrigger( int hordeID );
+
+	/// Vehicle element waiting for the body of its chassis node
+	struct PendingVehicle
+	{
+		int						hordeID;
+		VehicleDefinition		definition;
+	};
+
+	/**
+	 * Returns the collision shape information of a node's attachment, taken from the blob while one is loaded
+	 * @param hordeID the id of the Horde3D node
+	 * @param shape collision shape information that will be filled
+	 * @return true if the node has a physics attachment
+	 */
+	bool attachedShape( int hordeID, CollisionShape& shape ) const;
+
+	/**
+	 * Checks if the node is part of a model with a compound physics representation
+	 * @param hordeID the id of the Horde3D node
+	 */
+	bool hasCompoundAncestor( int hordeID );
+
+	/**
+	 * Returns a primitive collision shape that may be shared by several nodes
+	 * @param recipe the box or sphere recipe of the shape
+	 * @param scaling local scaling of the shape
+	 */
+	btCollisionShape* acquireSharedShape( const ShapeRecipe& recipe, const float* scaling );
+
+	/**
+	 * Releases a shape returned by acquireSharedShape, deletes it if it is not used anymore
+	 * @param shape the shared shape
+	 */
+	void releaseSharedShape( btCollisionShape* shape );
+
+	/**
+	 * Deletes a collision shape of a removed node once no snapshot references it anymore
+	 */
+	void retire( btCollisionShape* shape );
+
+	/**
+	 * Deletes the triangles of a removed mesh shape once no snapshot references them anymore
+	 */
+	void retire( btStridingMeshInterface* mesh );
+
+	/**
+	 * Transfers the transformations of all nodes that have been moved in Horde3D since the last render() call,
+	 * only those of kinematic nodes if the scene sync is disabled
+	 */
+	void syncSceneTransforms();
+
+	/**
+	 * Copies the collision objects into a snapshot and publishes it for the queries
+	 */
+	void updateSnapshot();
+
+	/// Passes the pairs accepted by the collision filter to the overlap filter of the application
+	struct OverlapFilterCallback : public btOverlapFilterCallback
+	{
+		virtual bool needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const;
+
+		Horde3DPhysics::OverlapFilter	filter;
+		void*							userData;
+	};
+
+	/// Key identifying shareable primitive collision shapes (type, dimensions and scaling)
+	struct SharedShapeKey
+	{
+		float values[7];
+		bool operator<(const SharedShapeKey& other) const { return memcmp(values, other.values, sizeof(values)) < 0; }
+	};
+
 private:
 
 	btDynamicsWorld*			m_physicsWorld;
 	// Default Collision Configuration (TODO: what can be configured using this variable?)
 	btDefaultCollisionConfiguration* m_configuration;
 	btCollisionDispatcher*		m_dispatcher;
-	btBroadphaseInterface*		m_pairCache;
-	btConstraintSolver*			m_constraintSolver;
-	btClock*					m_clock;
+	ShiftableAxisSweep*			m_pairCache;
+	btMultiBodyConstraintSolver*	m_constraintSolver;
+	/// Start of the current frame, btClock is not available if Bullet is built with BT_NO_PROFILE
+	std::chrono::steady_clock::time_point	m_frameStart;
 	std::vector<PhysicsNode*>	m_physicsNodes;
+	/// Nodes with a kinematic body, driven by the transformations of their Horde3D nodes
+	std::vector<PhysicsNode*>	m_kinematicNodes;
+	/// Articulated bodies, they are not represented by physics nodes
+	std::vector<Ragdoll*>		m_ragdolls;
+	/// Kinematic characters, updated by a single action of the world
+	CharacterBatch*				m_characters;
+	/// Maintains the overlapping pairs of the characters' ghost objects
+	btGhostPairCallback*		m_ghostPairCallback;
+	/// Constraints created from attachments
+	std::vector<btTypedConstraint*>	m_constraints;
+	std::vector<PendingConstraint>	m_pendingConstraints;
+	/// Definitions of the constraints in m_constraints, needed to recreate them after their target has been evicted
+	std::map<btTypedConstraint*, PendingConstraint>	m_constraintSources;
+	/// Constraints of loaded nodes waiting for their evicted target, keyed by the id of the target
+	std::vector< std::pair<int, PendingConstraint> >	m_parkedConstraints;
+	/// Raycast vehicles, updated by a single action of the world
+	VehicleBatch*				m_vehicles;
+	std::vector<PendingVehicle>	m_pendingVehicles;
+	/// true if single nodes have queued constraints or vehicles that render() has to resolve
+	bool						m_resolvePending;
+	/// Trigger volumes and their events, the ghost objects have no user pointer
+	TriggerBatch				m_triggers;
+	OverlapFilterCallback		m_overlapFilter;
+	/// Debug view, 0 if it is disabled
+	DebugDrawer*				m_debugDrawer;
+	WorldPartition				m_partition;
+	/// true if the cells have to be updated by the next render() call
+	bool						m_partitionChanged;
+	/// Restored nodes whose state is applied once they have been cooked
+	std::vector< std::pair<PhysicsNode*, WorldPartition::BodyState> >	m_pendingRestores;
+	/// Current origin relative to the initial one, the Horde3D root node has been moved by its negation
+	double						m_originOffset[3];
+	/// Shift requested for the next render() call, relative to the current origin
+	float						m_originShift[3];
+	bool						m_originShiftPending;
+	/// Distance of the origin focus that triggers a shift, 0 if disabled
+	float						m_originShiftThreshold;
+	/// Nodes whose collision shapes are being cooked asynchronously
+	std::vector<PhysicsNode*>	m_cookingNodes;
+	/// Number of nodes that have been cooked asynchronously since cooking was last idle
+	int							m_cookedNodes;
+	/// Scheduler passed to initPhysics, 0 if the built-in scheduler is used
+	Horde3DPhysics::ITaskScheduler*	m_scheduler;
+	/// Built-in work stealing scheduler, created when it is needed the first time
+	TaskScheduler*				m_ownScheduler;
+	/// true if collision meshes are cooked on the scheduler
+	bool						m_asyncCooking;
+	/// true if the narrowphase, the constraint solver and the transformation sync run on the scheduler
+	bool						m_parallelSimulation;
+	/// Transformations calculated by the sync pass and whether they are transferred to Horde3D
+	std::vector<float>			m_syncTransformations;
+	std::vector<unsigned char>	m_syncVisible;
+	/// true if the transformations are transferred to the Horde3D scene graph
+	bool						m_sceneWrites;
+	/// true if the poses of moved bodies are exported
+	bool						m_poseExport;
+	/// Flags of the bodies that moved during the last step, set by the sync pass
+	std::vector<unsigned char>	m_syncMoved;
+	/// Poses exported by the last render() call
+	std::vector<Horde3DPhysics::PhysicsPose>	m_poses;
+	/// Primitive collision shapes shared by several nodes
+	std::map<SharedShapeKey, btCollisionShape*>	m_sharedShapes;
+	/// Reference counts of the shared collision shapes
+	std::map<btCollisionShape*, int>			m_sharedShapeRefs;
+	/// Descriptors of the blob that is being loaded by loadPhysicsNodes, 0 otherwise
+	const std::map<int, const PhysicsDescriptor*>*	m_bakedAttachments;
+	/// Simulation LOD distances, the LOD is disabled if m_lodFar is 0
+	float						m_lodNear;
+	float						m_lodFar;
+	/// Number of simulation steps between two steps of a mid range body
+	int							m_lodInterval;
+	/// Position the LOD distances are measured from
+	float						m_lodViewpoint[3];
+	/// Number of simulation steps since the LOD has been enabled
+	unsigned int				m_lodTick;
+	/// Camera node used to defer the transfer of invisible transformations, 0 if disabled
+	int							m_visibilityCamera;
+	/// Frustum planes of the visibility camera, normals pointing inside
+	Horde3D::Plane				m_frustum[6];
+	/// Thread that created the instance and owns the world
+	std::thread::id				m_ownerThread;
+	/// Commands submitted by other threads
+	CommandQueue				m_commands;
+	/// Commands waiting for their node to be cooked, in submission order
+	std::vector<PhysicsCommand*>	m_pendingCommands;
+	/// true if transformations changed in Horde3D are transferred to the physics world
+	bool						m_sceneSync;
+	/// Nodes moved in Horde3D, collected by syncSceneTransforms
+	std::vector<PhysicsNode*>	m_movedNodes;
+	/// true if render() builds a snapshot for the queries
+	bool						m_querySnapshots;
+	/// Snapshot queried by other threads, replaced atomically by render()
+	std::shared_ptr<const WorldSnapshot>	m_snapshot;
+	/// Two snapshots used alternately, a new one is allocated if a query still holds the one to be rebuilt
+	std::shared_ptr<WorldSnapshot>	m_snapshotBuffers[2];
+	/// Index of the published snapshot buffer
+	int							m_snapshotIndex;
+	/// Collects the collision data of removed nodes while snapshots may reference it
+	std::shared_ptr<RetiredCollisionData>	m_retired;
 	
 	static Physics*				m_instance;
 };
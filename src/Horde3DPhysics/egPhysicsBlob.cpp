@@ -0,0 +1,550 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egPhysicsBlob.h"
+#include <Horde3D/Horde3D.h>
+
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+	const char blobMagic[4] = { 'H', '3', 'P', 'B' };
+
+	/// Names are compared and copied with the str functions, so they must not run past their buffers
+	bool terminated(const char* text, size_t size)
+	{
+		return memchr(text, 0, size) != 0;
+	}
+
+	/// FNV-1a over a node path and its attachment, the terminators keep "ab" + "c" apart from "a" + "bc"
+	unsigned int hashAttachment(unsigned int hash, const char* path, const char* attachment)
+	{
+		const char* strings[] = { path, attachment };
+		for (int i = 0; i < 2; ++i)
+		{
+			const char* c = strings[i];
+			do
+			{
+				hash ^= (unsigned char) *c;
+				hash *= 16777619u;
+			} while (*c++ != 0);
+		}
+		return hash;
+	}
+
+	const unsigned int hashSeed = 2166136261u;
+
+	/// Callback of the depth first scene graph traversal shared by baking and loading
+	struct NodeVisitor
+	{
+		virtual ~NodeVisitor() {}
+		/// path is 0 if it exceeds PhysicsDescriptor::MaxPathLength
+		virtual void visit(int hordeID, const char* path) = 0;
+	};
+
+	void traverse(int hordeID, char* path, size_t length, NodeVisitor& visitor)
+	{
+		visitor.visit(hordeID, length < PhysicsDescriptor::MaxPathLength ? path : 0);
+
+		H3DNode child = 0;
+		for (int i = 0; (child = h3dGetNodeChild(hordeID, i)) != 0; ++i)
+		{
+			const char* name = h3dGetNodeParamStr(child, H3DNodeParams::NameStr);
+			const size_t separator = length > 0 ? 1 : 0;
+			const size_t childLength = length + separator + strlen(name);
+			if (childLength < PhysicsDescriptor::MaxPathLength)
+			{
+				if (separator) path[length] = '/';
+				memcpy(path + length + separator, name, childLength - length - separator + 1);
+			}
+			traverse(child, path, childLength, visitor);
+			if (length < PhysicsDescriptor::MaxPathLength)
+				path[length] = 0;
+		}
+	}
+
+	/// Collects all nodes with an attachment
+	struct AttachmentCollector : public NodeVisitor
+	{
+		void visit(int hordeID, const char* path)
+		{
+			const char* attachment = h3dGetNodeParamStr(hordeID, H3DNodeParams::AttachmentStr);
+			if (!attachment || *attachment == 0)
+				return;
+			hordeIDs.push_back(hordeID);
+			paths.push_back(path ? path : "");
+			pathValid.push_back(path != 0);
+		}
+
+		vector<int>		hordeIDs;
+		vector<string>	paths;
+		vector<bool>	pathValid;
+	};
+
+	/// Hashes all attachments in traversal order
+	struct AttachmentHasher : public NodeVisitor
+	{
+		AttachmentHasher() : hash(hashSeed) {}
+
+		void visit(int hordeID, const char* path)
+		{
+			const char* attachment = h3dGetNodeParamStr(hordeID, H3DNodeParams::AttachmentStr);
+			if (attachment && *attachment != 0)
+				hash = hashAttachment(hash, path ? path : "", attachment);
+		}
+
+		unsigned int	hash;
+	};
+
+	/// Matches the descriptors in traversal order
+	struct DescriptorResolver : public NodeVisitor
+	{
+		DescriptorResolver(const PhysicsDescriptor* descriptors, int count, int* hordeIDs) :
+			descriptors(descriptors), count(count), next(0), hordeIDs(hordeIDs) {}
+
+		void visit(int hordeID, const char* path)
+		{
+			if (path && next < count && strcmp(descriptors[next].path, path) == 0)
+				hordeIDs[next++] = hordeID;
+		}
+
+		const PhysicsDescriptor*	descriptors;
+		int							count;
+		int							next;
+		int*						hordeIDs;
+	};
+}
+
+PhysicsBlob::PhysicsBlob() : m_header(0), m_descriptors(0), m_constraints(0), m_vehicles(0), m_size(0)
+#ifdef _WIN32
+	, m_file(0), m_mapping(0)
+#endif
+{
+}
+
+PhysicsBlob::~PhysicsBlob()
+{
+	close();
+}
+
+bool PhysicsBlob::bake(int rootID, const char* fileName)
+{
+	char path[PhysicsDescriptor::MaxPathLength] = { 0 };
+	AttachmentCollector collector;
+	traverse(rootID, path, 0, collector);
+
+	bool valid = true;
+	unsigned int attachmentHash = hashSeed;
+	vector<PhysicsDescriptor> descriptors;
+	vector<ConstraintDescriptor> constraints;
+	vector<VehicleDescriptor> vehicles;
+	descriptors.reserve(collector.hordeIDs.size());
+	for (unsigned int i = 0; i < collector.hordeIDs.size(); ++i)
+	{
+		const char* attachment = h3dGetNodeParamStr(collector.hordeIDs[i], H3DNodeParams::AttachmentStr);
+		attachmentHash = hashAttachment(attachmentHash, collector.paths[i].c_str(), attachment);
+		CollisionShape shape;
+		ConstraintDefinition definitions[ConstraintDefinition::MaxPerAttachment];
+		int numDefinitions = 0;
+		VehicleDefinition vehicle;
+		if (!AttachmentParser::parse(attachment, shape, definitions, ConstraintDefinition::MaxPerAttachment, &numDefinitions, &vehicle))
+			continue;
+		if (!collector.pathValid[i])
+		{
+			printf("Invalid physics attachment of node '%s': path exceeds %d characters\n",
+				h3dGetNodeParamStr(collector.hordeIDs[i], H3DNodeParams::NameStr), PhysicsDescriptor::MaxPathLength - 1);
+			valid = false;
+			continue;
+		}
+		if (!validate(collector.hordeIDs[i], collector.paths[i].c_str(), shape))
+		{
+			valid = false;
+			continue;
+		}
+
+		PhysicsDescriptor descriptor;
+		// zero the unused parts of the path so equal scenes result in equal files
+		memset(&descriptor, 0, sizeof(descriptor));
+		memcpy(descriptor.path, collector.paths[i].c_str(), collector.paths[i].size() + 1);
+		descriptor.type = shape.type;
+		descriptor.flags = (shape.kinematic ? PhysicsDescriptor::Kinematic : 0) | (shape.compound ? PhysicsDescriptor::Compound : 0) |
+			(shape.trigger ? PhysicsDescriptor::Trigger : 0);
+		descriptor.mass = shape.mass;
+		if (shape.type == CollisionShape::Box)
+			memcpy(descriptor.extents, shape.extents, sizeof(descriptor.extents));
+		else if (shape.type == CollisionShape::Sphere || shape.type == CollisionShape::Ragdoll)
+			descriptor.radius = shape.radius;
+		descriptor.friction = shape.friction;
+		descriptor.restitution = shape.restitution;
+		descriptor.jointLimit = shape.jointLimit;
+		descriptor.jointMotor = shape.jointMotor;
+		descriptor.group = shape.group;
+		descriptor.mask = shape.mask;
+		descriptors.push_back(descriptor);
+
+		for (int j = 0; j < numDefinitions; ++j)
+		{
+			if (!validate(collector.paths[i].c_str(), definitions[j]))
+			{
+				valid = false;
+				continue;
+			}
+			// value initialization zeroes the descriptor before the definition's constructor runs
+			ConstraintDescriptor constraint = ConstraintDescriptor();
+			constraint.descriptor = (unsigned int) descriptors.size() - 1;
+			constraint.definition = definitions[j];
+			// the definition copies the whole name buffer, the parts behind the name are zeroed again
+			const size_t nameLength = strlen(constraint.definition.target);
+			memset(constraint.definition.target + nameLength, 0, ConstraintDefinition::MaxNameLength - nameLength);
+			constraints.push_back(constraint);
+		}
+
+		if (vehicle.numWheels > 0)
+		{
+			if (!validate(collector.paths[i].c_str(), vehicle))
+			{
+				valid = false;
+				continue;
+			}
+			VehicleDescriptor descriptor = VehicleDescriptor();
+			descriptor.descriptor = (unsigned int) descriptors.size() - 1;
+			descriptor.definition = vehicle;
+			for (int j = 0; j < VehicleDefinition::MaxWheels; ++j)
+			{
+				WheelDefinition& wheel = descriptor.definition.wheels[j];
+				if (j >= vehicle.numWheels)
+					memset(&wheel, 0, sizeof(wheel));
+				else
+				{
+					const size_t nameLength = strlen(wheel.node);
+					memset(wheel.node + nameLength, 0, ConstraintDefinition::MaxNameLength - nameLength);
+				}
+			}
+			vehicles.push_back(descriptor);
+		}
+	}
+	if (!valid)
+		return false;
+
+	FILE* file = fopen(fileName, "wb");
+	if (!file)
+	{
+		printf("Couldn't write physics blob %s\n", fileName);
+		return false;
+	}
+	PhysicsBlobHeader header;
+	memcpy(header.magic, blobMagic, sizeof(header.magic));
+	header.version = Version;
+	header.descriptorSize = sizeof(PhysicsDescriptor);
+	header.numDescriptors = (unsigned int) descriptors.size();
+	header.constraintSize = sizeof(ConstraintDescriptor);
+	header.numConstraints = (unsigned int) constraints.size();
+	header.vehicleSize = sizeof(VehicleDescriptor);
+	header.numVehicles = (unsigned int) vehicles.size();
+	header.attachmentHash = attachmentHash;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+	if (!descriptors.empty())
+		written = written && fwrite(&descriptors[0], sizeof(PhysicsDescriptor), descriptors.size(), file) == descriptors.size();
+	if (!constraints.empty())
+		written = written && fwrite(&constraints[0], sizeof(ConstraintDescriptor), constraints.size(), file) == constraints.size();
+	if (!vehicles.empty())
+		written = written && fwrite(&vehicles[0], sizeof(VehicleDescriptor), vehicles.size(), file) == vehicles.size();
+	written = fclose(file) == 0 && written;
+	if (!written)
+		printf("Couldn't write physics blob %s\n", fileName);
+	return written;
+}
+
+bool PhysicsBlob::validate(int hordeID, const char* path, const CollisionShape& shape)
+{
+	const char* error = 0;
+	// the negated comparisons also reject NaN
+	if (!(shape.mass >= 0.0f && shape.mass <= FLT_MAX))
+		error = "mass has to be a finite, non negative number";
+	else if (!(shape.friction >= 0.0f && shape.friction <= FLT_MAX))
+		error = "friction has to be a finite, non negative number";
+	else if (!(shape.restitution >= 0.0f && shape.restitution <= 1.0f))
+		error = "restitution has to be between 0 and 1";
+	else if (shape.trigger && (shape.compound || (shape.type != CollisionShape::Box && shape.type != CollisionShape::Sphere)))
+		error = "triggers have to be box or sphere shapes";
+	else if (shape.compound)
+	{
+		if (h3dGetNodeType(hordeID) != H3DNodeTypes::Model)
+			error = "compound shapes can only be attached to model nodes";
+	}
+	else switch (shape.type)
+	{
+	case CollisionShape::Box:
+		if (!(shape.extents[0] > 0.0f && shape.extents[1] > 0.0f && shape.extents[2] > 0.0f))
+			error = "box extents have to be positive";
+		break;
+	case CollisionShape::Sphere:
+		if (!(shape.radius > 0.0f))
+			error = "sphere radius has to be positive";
+		break;
+	case CollisionShape::Mesh:
+		if (h3dGetNodeType(hordeID) != H3DNodeTypes::Mesh && h3dGetNodeType(hordeID) != H3DNodeTypes::Model)
+			error = "mesh shapes can only be attached to mesh or model nodes";
+		break;
+	case CollisionShape::Ragdoll:
+		if (h3dGetNodeType(hordeID) != H3DNodeTypes::Model)
+			error = "ragdolls can only be attached to model nodes";
+		else if (!(shape.radius > 0.0f && shape.mass > 0.0f))
+			error = "ragdoll radius and mass have to be positive";
+		else if (!(shape.jointLimit >= 0.0f && shape.jointLimit <= 180.0f && shape.jointMotor >= 0.0f && shape.jointMotor <= FLT_MAX))
+			error = "ragdoll limit has to be between 0 and 180 degrees, motor has to be non negative";
+		break;
+	}
+
+	if (error)
+	{
+		printf("Invalid physics attachment of node '%s': %s\n", path, error);
+		return false;
+	}
+	return true;
+}
+
+bool PhysicsBlob::validate(const char* path, const ConstraintDefinition& constraint)
+{
+	const char* error = 0;
+	const float axisLength2 = constraint.axis[0] * constraint.axis[0] + constraint.axis[1] * constraint.axis[1] + 
+		constraint.axis[2] * constraint.axis[2];
+	if (!(axisLength2 > 0.0f && axisLength2 <= FLT_MAX))
+		error = "the axis has to be a finite, non zero vector";
+	else if (!(constraint.stiffness >= 0.0f && constraint.stiffness <= FLT_MAX && constraint.damping >= 0.0f && constraint.damping <= FLT_MAX))
+		error = "stiffness and damping have to be finite, non negative numbers";
+	else if (!(constraint.breakingImpulse >= 0.0f && constraint.breakingImpulse <= FLT_MAX))
+		error = "breaking has to be a finite, non negative number";
+	else if (constraint.type == ConstraintDefinition::Hinge && constraint.low <= constraint.high && 
+		!(constraint.low >= -180.0f && constraint.high <= 180.0f))
+		error = "hinge limits have to be between -180 and 180 degrees";
+
+	if (error)
+	{
+		printf("Invalid constraint of node '%s': %s\n", path, error);
+		return false;
+	}
+	return true;
+}
+
+bool PhysicsBlob::validate(const char* path, const VehicleDefinition& vehicle)
+{
+	const char* error = 0;
+	const float parameters[] = { vehicle.stiffness, vehicle.compression, vehicle.damping, vehicle.maxTravel, vehicle.frictionSlip,
+		vehicle.maxForce, vehicle.rollInfluence };
+	for (unsigned int i = 0; i < sizeof(parameters) / sizeof(parameters[0]) && !error; ++i)
+	{
+		if (!(parameters[i] >= 0.0f && parameters[i] <= FLT_MAX))
+			error = "suspension and tire parameters have to be finite, non negative numbers";
+	}
+	for (int i = 0; i < vehicle.numWheels && !error; ++i)
+	{
+		if (vehicle.wheels[i].node[0] == 0)
+			error = "wheel without node";
+		else if (!(vehicle.wheels[i].radius > 0.0f && vehicle.wheels[i].radius <= FLT_MAX))
+			error = "wheel radius has to be positive";
+		else if (!(vehicle.wheels[i].suspension >= 0.0f && vehicle.wheels[i].suspension <= FLT_MAX))
+			error = "suspension length has to be a finite, non negative number";
+	}
+
+	if (error)
+	{
+		printf("Invalid vehicle of node '%s': %s\n", path, error);
+		return false;
+	}
+	return true;
+}
+
+bool PhysicsBlob::open(const char* fileName)
+{
+	close();
+
+	const void* data = 0;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	m_file = file;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size) && size.QuadPart >= (LONGLONG) sizeof(PhysicsBlobHeader))
+	{
+		m_size = (size_t) size.QuadPart;
+		m_mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+		if (m_mapping)
+			data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	int file = ::open(fileName, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat info;
+	if (fstat(file, &info) == 0 && info.st_size >= (off_t) sizeof(PhysicsBlobHeader))
+	{
+		m_size = (size_t) info.st_size;
+		void* mapped = mmap(0, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapped != MAP_FAILED)
+			data = mapped;
+	}
+	// the mapping stays valid after closing the descriptor
+	::close(file);
+#endif
+	if (!data)
+	{
+		close();
+		return false;
+	}
+	m_header = static_cast<const PhysicsBlobHeader*>(data);
+	m_descriptors = reinterpret_cast<const PhysicsDescriptor*>(m_header + 1);
+
+	const char* error = 0;
+	if (memcmp(m_header->magic, blobMagic, sizeof(blobMagic)) != 0)
+		error = "not a physics blob";
+	else if (m_header->version != Version || m_header->descriptorSize != sizeof(PhysicsDescriptor) || 
+		m_header->constraintSize != sizeof(ConstraintDescriptor) || m_header->vehicleSize != sizeof(VehicleDescriptor))
+		error = "baked by an incompatible version";
+	else if ((m_size - sizeof(PhysicsBlobHeader)) / sizeof(PhysicsDescriptor) < m_header->numDescriptors ||
+		(m_size - sizeof(PhysicsBlobHeader) - m_header->numDescriptors * sizeof(PhysicsDescriptor)) / sizeof(ConstraintDescriptor) <
+		m_header->numConstraints ||
+		(m_size - sizeof(PhysicsBlobHeader) - m_header->numDescriptors * sizeof(PhysicsDescriptor) - 
+		m_header->numConstraints * sizeof(ConstraintDescriptor)) / sizeof(VehicleDescriptor) < m_header->numVehicles)
+		error = "file is truncated";
+	else
+	{
+		m_constraints = reinterpret_cast<const ConstraintDescriptor*>(m_descriptors + m_header->numDescriptors);
+		m_vehicles = reinterpret_cast<const VehicleDescriptor*>(m_constraints + m_header->numConstraints);
+		for (unsigned int i = 0; i < m_header->numDescriptors && !error; ++i)
+		{
+			if (!terminated(m_descriptors[i].path, PhysicsDescriptor::MaxPathLength) || m_descriptors[i].type > CollisionShape::Ragdoll)
+				error = "invalid descriptor";
+		}
+		for (unsigned int i = 0; i < m_header->numConstraints && !error; ++i)
+		{
+			const ConstraintDefinition& definition = m_constraints[i].definition;
+			if (m_constraints[i].descriptor >= m_header->numDescriptors)
+				error = "constraint of an unknown node";
+			else if (!terminated(definition.target, ConstraintDefinition::MaxNameLength) || 
+				(unsigned int) definition.type > ConstraintDefinition::Spring)
+				error = "invalid constraint";
+		}
+		for (unsigned int i = 0; i < m_header->numVehicles && !error; ++i)
+		{
+			const VehicleDefinition& definition = m_vehicles[i].definition;
+			if (m_vehicles[i].descriptor >= m_header->numDescriptors || definition.numWheels < 0 || 
+				definition.numWheels > VehicleDefinition::MaxWheels)
+				error = "invalid vehicle";
+			for (int j = 0; j < definition.numWheels && !error; ++j)
+			{
+				if (!terminated(definition.wheels[j].node, ConstraintDefinition::MaxNameLength))
+					error = "invalid vehicle";
+			}
+		}
+	}
+	if (error)
+	{
+		printf("Couldn't load physics blob %s: %s\n", fileName, error);
+		close();
+		return false;
+	}
+	return true;
+}
+
+void PhysicsBlob::close()
+{
+#ifdef _WIN32
+	if (m_header)
+		UnmapViewOfFile(m_header);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+	m_file = m_mapping = 0;
+#else
+	if (m_header)
+		munmap(const_cast<PhysicsBlobHeader*>(m_header), m_size);
+#endif
+	m_header = 0;
+	m_descriptors = 0;
+	m_constraints = 0;
+	m_vehicles = 0;
+	m_size = 0;
+}
+
+int PhysicsBlob::resolveNodes(int rootID, int* hordeIDs) const
+{
+	const int count = numDescriptors();
+	for (int i = 0; i < count; ++i)
+		hordeIDs[i] = 0;
+
+	char path[PhysicsDescriptor::MaxPathLength] = { 0 };
+	DescriptorResolver resolver(m_descriptors, count, hordeIDs);
+	traverse(rootID, path, 0, resolver);
+	return resolver.next;
+}
+
+bool PhysicsBlob::isCurrent(int rootID) const
+{
+	if (!m_header)
+		return false;
+	char path[PhysicsDescriptor::MaxPathLength] = { 0 };
+	AttachmentHasher hasher;
+	traverse(rootID, path, 0, hasher);
+	return hasher.hash == m_header->attachmentHash;
+}
+
+void PhysicsBlob::toCollisionShape(const PhysicsDescriptor& descriptor, CollisionShape& shape)
+{
+	shape.type = static_cast<CollisionShape::Type>(descriptor.type);
+	shape.mass = descriptor.mass;
+	shape.kinematic = (descriptor.flags & PhysicsDescriptor::Kinematic) != 0;
+	shape.compound = (descriptor.flags & PhysicsDescriptor::Compound) != 0;
+	shape.trigger = (descriptor.flags & PhysicsDescriptor::Trigger) != 0;
+	if (shape.type == CollisionShape::Box)
+		memcpy(shape.extents, descriptor.extents, sizeof(shape.extents));
+	else
+		shape.radius = descriptor.radius;
+	shape.friction = descriptor.friction;
+	shape.restitution = descriptor.restitution;
+	shape.jointLimit = descriptor.jointLimit;
+	shape.jointMotor = descriptor.jointMotor;
+	shape.group = (short) descriptor.group;
+	shape.mask = (short) descriptor.mask;
+}
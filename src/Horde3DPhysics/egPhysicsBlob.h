@@ -0,0 +1,175 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include "egAttachment.h"
+
+#include <cstddef>
+
+/// File header of a baked physics blob
+struct PhysicsBlobHeader
+{
+	/// "H3PB"
+	char			magic[4];
+	unsigned int	version;
+	/// sizeof(PhysicsDescriptor) of the baking library, guards against layout changes without a version bump
+	unsigned int	descriptorSize;
+	unsigned int	numDescriptors;
+	/// sizeof(ConstraintDescriptor) of the baking library
+	unsigned int	constraintSize;
+	unsigned int	numConstraints;
+	/// sizeof(VehicleDescriptor) of the baking library
+	unsigned int	vehicleSize;
+	unsigned int	numVehicles;
+	/// Hash of the node paths and attachment strings the blob has been baked from
+	unsigned int	attachmentHash;
+};
+
+/// Precompiled physics attachment of a single node, stored directly in the blob
+struct PhysicsDescriptor
+{
+	enum Flags
+	{
+		Kinematic = 1,
+		Compound = 2,
+		Trigger = 4
+	};
+	enum { MaxPathLength = 256 };
+
+	/// Node names from below the root node separated by '/', empty for the root node itself
+	char			path[MaxPathLength];
+	/// CollisionShape::Type
+	unsigned int	type;
+	unsigned int	flags;
+	float			mass;
+	float			extents[3];
+	float			radius;
+	float			friction;
+	float			restitution;
+	float			jointLimit;
+	float			jointMotor;
+	/// Collision filter bits, the layers have to be defined in the same order when baking and loading
+	int				group;
+	int				mask;
+};
+
+/// Precompiled Constraint element of an attachment, the constraints follow the descriptors in the blob
+struct ConstraintDescriptor
+{
+	/// Index of the descriptor of the node the constraint is attached to
+	unsigned int			descriptor;
+	ConstraintDefinition	definition;
+};
+
+/// Precompiled Vehicle element of an attachment, the vehicles follow the constraints in the blob
+struct VehicleDescriptor
+{
+	/// Index of the descriptor of the chassis node
+	unsigned int			descriptor;
+	VehicleDefinition		definition;
+};
+
+/**
+ * \brief Binary representation of all physics attachments of a scene
+ *
+ * The attachments below a root node are parsed and validated once by bake() and written as an array of
+ * PhysicsDescriptor structs. At runtime the file is memory mapped and the descriptors are used in place, so
+ * loading a scene doesn't need any text parsing.
+ * Descriptors are stored in the order of a depth first traversal of the scene graph, they are matched by
+ * walking the same traversal at load time. The Constraint elements of the attachments follow as an array of
+ * ConstraintDescriptor structs referencing their descriptor by index, followed by the VehicleDescriptor structs
+ * of the Vehicle elements.
+ * The header stores a hash of the attachment strings, so a blob whose scene has been edited after baking is
+ * detected by isCurrent() without parsing anything.
+ */
+class PhysicsBlob
+{
+public:
+	enum { Version = 7 };
+
+	PhysicsBlob();
+	~PhysicsBlob();
+
+	/**
+	 * Compiles the physics attachments of a scene graph branch into a blob file
+	 * @param rootID the Horde3D node whose subtree (including the node itself) will be baked
+	 * @param fileName path of the blob file that will be written
+	 * @return false if an attachment is invalid or the file could not be written
+	 */
+	static bool bake(int rootID, const char* fileName);
+
+	/**
+	 * Memory maps a blob file and checks its header
+	 * @param fileName path of the blob file
+	 * @return true if the file is a blob of the current version
+	 */
+	bool open(const char* fileName);
+	/// Releases the mapping, the descriptors are invalid afterwards
+	void close();
+
+	int numDescriptors() const { return m_header ? (int) m_header->numDescriptors : 0; }
+	const PhysicsDescriptor* descriptors() const { return m_descriptors; }
+	int numConstraints() const { return m_header ? (int) m_header->numConstraints : 0; }
+	const ConstraintDescriptor* constraints() const { return m_constraints; }
+	int numVehicles() const { return m_header ? (int) m_header->numVehicles : 0; }
+	const VehicleDescriptor* vehicles() const { return m_vehicles; }
+
+	/**
+	 * Finds the nodes of all descriptors below the given root node
+	 * @param rootID the node the blob has been baked for (or another instance of the same scene)
+	 * @param hordeIDs array of numDescriptors() entries receiving the node of each descriptor, 0 if not found
+	 * @return number of descriptors whose node has been found
+	 */
+	int resolveNodes(int rootID, int* hordeIDs) const;
+
+	/**
+	 * Checks whether the attachments below a root node are still the ones the blob has been baked from
+	 * @param rootID the node the blob has been baked for (or another instance of the same scene)
+	 * @return false if an attachment has been added, removed or changed since baking
+	 */
+	bool isCurrent(int rootID) const;
+
+	/// Converts a descriptor back into the attachment data it has been baked from
+	static void toCollisionShape(const PhysicsDescriptor& descriptor, CollisionShape& shape);
+
+private:
+	/// Checks an attachment for values that would create an invalid rigid body
+	static bool validate(int hordeID, const char* path, const CollisionShape& shape);
+	/// Checks a constraint for values the constraint solver can't handle
+	static bool validate(const char* path, const ConstraintDefinition& constraint);
+	/// Checks the suspension and wheels of a vehicle
+	static bool validate(const char* path, const VehicleDefinition& vehicle);
+
+	const PhysicsBlobHeader*	m_header;
+	const PhysicsDescriptor*	m_descriptors;
+	const ConstraintDescriptor*	m_constraints;
+	const VehicleDescriptor*	m_vehicles;
+	size_t						m_size;
+#ifdef _WIN32
+	void*						m_file;
+	void*						m_mapping;
+#endif
+};
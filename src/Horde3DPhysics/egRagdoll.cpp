@@ -0,0 +1,312 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egRagdoll.h"
+#include "egSceneSearch.h"
+#include <Horde3D/Horde3D.h>
+#include <Horde3D/utMath.h>
+#include <cstdio>
+
+using namespace std;
+using namespace Horde3D;
+
+namespace
+{
+	/// Part of the limit violation corrected by the motors in one simulation step
+	const btScalar LimitCorrection = 0.2f;
+}
+
+Ragdoll::Ragdoll(const CollisionShape& shape, int hordeID) : m_multiBody(0), m_world(0), m_jointLimit(shape.jointLimit * SIMD_RADS_PER_DEG),
+	m_motorImpulse(shape.jointMotor), m_limitImpulse(shape.mass),
+	m_group(shape.group ? shape.group : short(btBroadphaseProxy::DefaultFilter)), m_mask(shape.mask ? shape.mask : short(btBroadphaseProxy::AllFilter)), 
+	m_hordeID(hordeID)
+{
+	vector<int> jointIDs;
+	SceneSearch::findNodes(hordeID, "", H3DNodeTypes::Joint, jointIDs);
+	if (jointIDs.empty())
+	{
+		printf("The model of the ragdoll doesn't contain any joint\n");
+		return;
+	}
+
+	// Current pose of the joints without scale, parents are found before their children
+	btAlignedObjectArray<btTransform> poses;
+	for (unsigned int i = 0; i < jointIDs.size(); ++i)
+	{
+		int parent = -1;
+		if (!m_joints.empty())
+		{
+			const int parentID = h3dGetNodeParent(jointIDs[i]);
+			for (unsigned int j = 0; j < m_joints.size() && parent < 0; ++j)
+			{
+				if (m_joints[j].hordeID == parentID)
+					parent = j;
+			}
+			// joints that are not part of the first skeleton
+			if (parent < 0)
+				continue;
+		}
+		const float* x = 0;
+		h3dGetNodeTransMats(jointIDs[i], 0, &x);
+		Matrix4f jointTrans( x );
+		Vec3f t, r, s;
+		jointTrans.decompose(t, r, s);
+		jointTrans.scale( 1.0f / s.x, 1.0f / s.y, 1.0f / s.z );
+		btTransform pose;
+		pose.setFromOpenGLMatrix(jointTrans.x);
+		poses.push_back(pose);
+
+		Joint joint = { jointIDs[i], parent, { s.x, s.y, s.z }, { 0, 0, 0 } };
+		m_joints.push_back(joint);
+	}
+	const int numJoints = (int) m_joints.size();
+
+	// The link of a joint reaches to the average position of its child joints
+	btAlignedObjectArray<btVector3> boneEnds;
+	boneEnds.resize(numJoints, btVector3(0, 0, 0));
+	vector<int> numChildren(numJoints, 0);
+	for (int i = 1; i < numJoints; ++i)
+	{
+		boneEnds[m_joints[i].parent] += poses[i].getOrigin();
+		++numChildren[m_joints[i].parent];
+	}
+
+	// Link frames are located at the center of mass and rotated like their joints
+	btAlignedObjectArray<btTransform> links;
+	vector<btCollisionShape*> linkShapes;
+	vector<btScalar> lengths;
+	btScalar totalLength = 0;
+	for (int i = 0; i < numJoints; ++i)
+	{
+		btTransform link = poses[i];
+		btVector3 bone(0, 0, 0);
+		if (numChildren[i] > 0)
+			bone = boneEnds[i] / btScalar(numChildren[i]) - poses[i].getOrigin();
+		btScalar length = bone.length();
+		if (length > shape.radius * 2)
+		{
+			link.setOrigin(poses[i].getOrigin() + bone * 0.5f);
+			// capsules are aligned to the y axis
+			btCapsuleShape* capsule = new btCapsuleShape(shape.radius, length - shape.radius * 2);
+			btCompoundShape* compound = new btCompoundShape();
+			const btVector3 direction = poses[i].getBasis().transpose() * bone / length;
+			compound->addChildShape(btTransform(shortestArcQuat(btVector3(0, 1, 0), direction), btVector3(0, 0, 0)), capsule);
+			m_shapes.push_back(capsule);
+			m_shapes.push_back(compound);
+			linkShapes.push_back(compound);
+		}
+		else
+		{
+			length = shape.radius * 2;
+			m_shapes.push_back(new btSphereShape(shape.radius));
+			linkShapes.push_back(m_shapes.back());
+		}
+		const btVector3 pivotToCom = poses[i].getBasis().transpose() * (link.getOrigin() - poses[i].getOrigin());
+		for (int j = 0; j < 3; ++j)
+			m_joints[i].pivotToCom[j] = pivotToCom[j];
+		links.push_back(link);
+		lengths.push_back(length);
+		totalLength += length;
+	}
+
+	// The root joint is the base, all other joints are spherical joints of the links
+	btVector3 inertia(0, 0, 0);
+	btScalar mass = shape.mass * lengths[0] / totalLength;
+	linkShapes[0]->calculateLocalInertia(mass, inertia);
+	m_multiBody = new btMultiBody(numJoints - 1, mass, inertia, false, true);
+	for (int i = 1; i < numJoints; ++i)
+	{
+		const int parent = m_joints[i].parent;
+		mass = shape.mass * lengths[i] / totalLength;
+		linkShapes[i]->calculateLocalInertia(mass, inertia);
+		const btQuaternion rotParentToThis = links[i].getRotation().inverse() * links[parent].getRotation();
+		const btVector3 parentComToPivot = links[parent].getBasis().transpose() * (poses[i].getOrigin() - links[parent].getOrigin());
+		const btVector3 pivotToCom(m_joints[i].pivotToCom[0], m_joints[i].pivotToCom[1], m_joints[i].pivotToCom[2]);
+		m_multiBody->setupSpherical(i - 1, mass, inertia, parent - 1, rotParentToThis, parentComToPivot, pivotToCom, true);
+	}
+	m_multiBody->finalizeMultiDof();
+	// capsules of neighboring bones overlap at their joints
+	m_multiBody->setHasSelfCollision(false);
+
+	for (int i = 0; i < numJoints; ++i)
+	{
+		btMultiBodyLinkCollider* collider = new btMultiBodyLinkCollider(m_multiBody, i - 1);
+		collider->setCollisionShape(linkShapes[i]);
+		collider->setWorldTransform(links[i]);
+		collider->setFriction(shape.friction);
+		collider->setRestitution(shape.restitution);
+		collider->setUserIndex(hordeID);
+		if (i == 0)
+			m_multiBody->setBaseCollider(collider);
+		else
+			m_multiBody->getLink(i - 1).m_collider = collider;
+		m_colliders.push_back(collider);
+	}
+
+	if (m_jointLimit > 0 || m_motorImpulse > 0)
+	{
+		for (int i = 0; i < numJoints - 1; ++i)
+		{
+			for (int dof = 0; dof < 3; ++dof)
+				m_motors.push_back(new btMultiBodyJointMotor(m_multiBody, i, dof, 0, m_motorImpulse));
+		}
+	}
+
+	const btQuaternion baseRotation = links[0].getRotation();
+	for (int i = 0; i < 3; ++i)
+		m_startTransformation[i] = links[0].getOrigin()[i];
+	for (int i = 0; i < 4; ++i)
+		m_startTransformation[3 + i] = baseRotation[i];
+	reset();
+}
+
+Ragdoll::~Ragdoll()
+{
+	removeFromWorld();
+	for (unsigned int i = 0; i < m_motors.size(); ++i)
+		delete m_motors[i];
+	for (unsigned int i = 0; i < m_colliders.size(); ++i)
+		delete m_colliders[i];
+	delete m_multiBody;
+	for (unsigned int i = 0; i < m_shapes.size(); ++i)
+		delete m_shapes[i];
+}
+
+void Ragdoll::addToWorld(btMultiBodyDynamicsWorld* world)
+{
+	removeFromWorld();
+	m_world = world;
+	m_world->addMultiBody(m_multiBody);
+	for (unsigned int i = 0; i < m_colliders.size(); ++i)
+		m_world->addCollisionObject(m_colliders[i], m_group, m_mask);
+	for (unsigned int i = 0; i < m_motors.size(); ++i)
+		m_world->addMultiBodyConstraint(m_motors[i]);
+}
+
+void Ragdoll::removeFromWorld()
+{
+	if (!m_world)
+		return;
+	for (unsigned int i = 0; i < m_motors.size(); ++i)
+		m_world->removeMultiBodyConstraint(m_motors[i]);
+	for (unsigned int i = 0; i < m_colliders.size(); ++i)
+		m_world->removeCollisionObject(m_colliders[i]);
+	m_world->removeMultiBody(m_multiBody);
+	m_world = 0;
+}
+
+void Ragdoll::shiftOrigin(const btVector3& translation)
+{
+	m_multiBody->setBasePos(m_multiBody->getBasePos() + translation);
+	for (int i = 0; i < 3; ++i)
+		m_startTransformation[i] += translation[i];
+}
+
+void Ragdoll::reset()
+{
+	const btTransform start(btQuaternion(m_startTransformation[3], m_startTransformation[4], m_startTransformation[5], m_startTransformation[6]),
+		btVector3(m_startTransformation[0], m_startTransformation[1], m_startTransformation[2]));
+	m_multiBody->setBaseWorldTransform(start);
+	m_multiBody->setBaseVel(btVector3(0, 0, 0));
+	m_multiBody->setBaseOmega(btVector3(0, 0, 0));
+	// the links have been set up in the start pose, so all joints are at their zero rotation
+	for (int i = 0; i < m_multiBody->getNumLinks(); ++i)
+	{
+		btScalar rotation[4] = { 0, 0, 0, 1 };
+		btScalar velocity[3] = { 0, 0, 0 };
+		m_multiBody->setJointPosMultiDof(i, rotation);
+		m_multiBody->setJointVelMultiDof(i, velocity);
+	}
+	m_multiBody->clearForcesAndTorques();
+	btAlignedObjectArray<btQuaternion> scratchRotations;
+	btAlignedObjectArray<btVector3> scratchOrigins;
+	m_multiBody->updateCollisionObjectWorldTransforms(scratchRotations, scratchOrigins);
+	m_multiBody->wakeUp();
+}
+
+void Ragdoll::updateJointLimits(btScalar timeStep)
+{
+	if (m_jointLimit <= 0 || !m_multiBody->isAwake())
+		return;
+	for (int i = 0; i < m_multiBody->getNumLinks(); ++i)
+	{
+		// The rotation vector of the joint has the same coordinates in the parent and the link frame
+		const btScalar* q = m_multiBody->getJointPosMultiDof(i);
+		btQuaternion rotation(q[0], q[1], q[2], q[3]);
+		if (rotation.w() < 0)
+			rotation = -rotation;
+		const btVector3 angles = rotation.getAxis() * rotation.getAngle();
+		for (int dof = 0; dof < 3; ++dof)
+		{
+			btMultiBodyJointMotor* motor = m_motors[i * 3 + dof];
+			const btScalar excess = btFabs(angles[dof]) - m_jointLimit;
+			if (excess > 0)
+			{
+				motor->setVelocityTarget((angles[dof] > 0 ? -excess : excess) * LimitCorrection / timeStep);
+				motor->setMaxAppliedImpulse(m_limitImpulse);
+			}
+			else
+			{
+				motor->setVelocityTarget(0);
+				motor->setMaxAppliedImpulse(m_motorImpulse);
+			}
+		}
+	}
+}
+
+void Ragdoll::update()
+{
+	if (!m_multiBody->isAwake())
+		return;
+
+	// Absolute transformations of the joints including their scale
+	const int numJoints = (int) m_joints.size();
+	m_jointTransformations.resize(numJoints * 16);
+	for (int i = 0; i < numJoints; ++i)
+	{
+		const btTransform& link = m_colliders[i]->getWorldTransform();
+		const Joint& joint = m_joints[i];
+		const btVector3 origin = link.getOrigin() - link.getBasis() * btVector3(joint.pivotToCom[0], joint.pivotToCom[1], joint.pivotToCom[2]);
+		float* x = &m_jointTransformations[i * 16];
+		link.getBasis().scaled(btVector3(joint.scaling[0], joint.scaling[1], joint.scaling[2])).getOpenGLSubMatrix(x);
+		x[12] = origin.x();
+		x[13] = origin.y();
+		x[14] = origin.z();
+		x[15] = 1.0f;
+	}
+
+	// Relative transformations are calculated from the joint transformations above, only the parent of
+	// the root joint is read from Horde3D, before any joint has been changed
+	const float* parentMat = 0;
+	h3dGetNodeTransMats(h3dGetNodeParent(m_joints[0].hordeID), 0, &parentMat);
+	if (!parentMat)
+		return;
+	const Matrix4f rootParent = Matrix4f(parentMat).inverted();
+	for (int i = 0; i < numJoints; ++i)
+	{
+		const Matrix4f parent = i == 0 ? rootParent : Matrix4f(&m_jointTransformations[m_joints[i].parent * 16]).inverted();
+		h3dSetNodeTransMat(m_joints[i].hordeID, (parent * Matrix4f(&m_jointTransformations[i * 16])).x);
+	}
+}
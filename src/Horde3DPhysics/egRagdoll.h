@@ -0,0 +1,140 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <vector>
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <Bullet/BulletDynamics/Featherstone/btMultiBody.h>
+#include <Bullet/BulletDynamics/Featherstone/btMultiBodyLinkCollider.h>
+#include <Bullet/BulletDynamics/Featherstone/btMultiBodyJointMotor.h>
+#include <Bullet/BulletDynamics/Featherstone/btMultiBodyDynamicsWorld.h>
+
+#include "egAttachment.h"
+
+/**
+ * \brief Articulated body built from the joint hierarchy of a Horde3D model
+ *
+ * The root joint of the skeleton becomes the base of a btMultiBody, every other joint a link connected to 
+ * its parent by a spherical joint. Each link is a capsule reaching from its joint to the average position
+ * of its child joints, leaf joints get a sphere. The mass of the attachment is distributed by the length
+ * of the links.
+ *
+ * Every degree of freedom of a joint has a velocity motor. Within the limit it holds the joint with the
+ * motor impulse of the attachment. Beyond the limit it drives the joint back, which approximates a limit 
+ * for spherical joints (btMultiBodyJointLimitConstraint supports single degree of freedom joints only).
+ */
+class Ragdoll
+{
+public:
+	/**
+	 * Constructor
+	 *
+	 * Reads the joints of the model and builds the multi body in the current pose of the model
+	 * @param shape information about the ragdoll taken from the attachment
+	 * @param hordeID id of the Horde3D model node
+	 */
+	Ragdoll(const CollisionShape& shape, int hordeID);
+	/// Destructor, removes the ragdoll from the world
+	~Ragdoll();
+
+	/**
+	 * Returns true if the model has a skeleton the multi body could be built from
+	 */
+	bool isValid() const { return m_multiBody != 0; }
+
+	/**
+	 * Returns the id of the Horde3D model node
+	 */
+	int hordeID() const { return m_hordeID; }
+
+	/**
+	 * Adds the multi body, its colliders and its motors to the world
+	 */
+	void addToWorld(btMultiBodyDynamicsWorld* world);
+
+	/**
+	 * Moves the ragdoll back to the pose it has been created in and stops it
+	 */
+	void reset();
+
+	/**
+	 * Sets the motor targets enforcing the joint limits, called before each simulation step
+	 * @param timeStep duration of the following simulation step
+	 */
+	void updateJointLimits(btScalar timeStep);
+
+	/**
+	 * Moves the base and the start pose, the colliders are moved together with all objects of the world
+	 * @param translation offset added to all positions
+	 */
+	void shiftOrigin(const btVector3& translation);
+
+	/**
+	 * Transfers the transformations of the links to the joint nodes of the model
+	 */
+	void update();
+
+private:
+	/// Joint node of the model, the first one is the base of the multi body, joint i + 1 is link i
+	struct Joint
+	{
+		int		hordeID;
+		/// Index of the parent joint, -1 for the base
+		int		parent;
+		/// Scale of the joint node
+		float	scaling[3];
+		/// Vector from the joint to the center of mass of its link, in the frame of the link
+		float	pivotToCom[3];
+	};
+
+	/// Removes the multi body from the world it has been added to
+	void removeFromWorld();
+
+	std::vector<Joint>					m_joints;
+	btMultiBody*						m_multiBody;
+	/// Colliders of the base and the links, in the order of the joints
+	std::vector<btMultiBodyLinkCollider*>	m_colliders;
+	/// Collision shapes of the links, including the children of compound shapes
+	std::vector<btCollisionShape*>		m_shapes;
+	/// Three motors for each link
+	std::vector<btMultiBodyJointMotor*>	m_motors;
+	/// World the multi body has been added to
+	btMultiBodyDynamicsWorld*			m_world;
+	/// Absolute transformations of the joints calculated by update()
+	std::vector<float>					m_jointTransformations;
+	/// Transformation of the base the ragdoll has been created with (position and rotation quaternion)
+	float								m_startTransformation[7];
+	/// Joint limit in radians, 0 if the joints are not limited
+	float								m_jointLimit;
+	/// Maximum impulse of the motors within the limit and when enforcing the limit
+	float								m_motorImpulse;
+	float								m_limitImpulse;
+	/// Broadphase filter of the colliders
+	short								m_group;
+	short								m_mask;
+	/// ID within the Horde3D scenegraph
+	int									m_hordeID;
+};
@@ -0,0 +1,59 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+#include "egSceneSearch.h"
+#include <Horde3D/Horde3D.h>
+#include <cstring>
+
+using namespace std;
+
+int SceneSearch::findNode(int startID, const char* name, int type)
+{
+	vector<int> nodes;
+	visit(startID, name, type, nodes, true);
+	return nodes.empty() ? 0 : nodes[0];
+}
+
+void SceneSearch::findNodes(int startID, const char* name, int type, vector<int>& nodes)
+{
+	visit(startID, name, type, nodes, false);
+}
+
+bool SceneSearch::visit(int hordeID, const char* name, int type, vector<int>& nodes, bool first)
+{
+	if ((type == H3DNodeTypes::Undefined || h3dGetNodeType(hordeID) == type) &&
+		(*name == 0 || strcmp(h3dGetNodeParamStr(hordeID, H3DNodeParams::NameStr), name) == 0))
+	{
+		nodes.push_back(hordeID);
+		if (first)
+			return true;
+	}
+	int child = 0;
+	for (int i = 0; (child = h3dGetNodeChild(hordeID, i)) != 0; ++i)
+	{
+		if (visit(child, name, type, nodes, first))
+			return true;
+	}
+	return false;
+}
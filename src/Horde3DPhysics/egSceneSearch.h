@@ -0,0 +1,61 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+#pragma once
+
+#include <vector>
+
+/**
+ * \brief Node searches walking the Horde3D scene graph
+ *
+ * Horde3D keeps the results of h3dFindNodes in a single global buffer. Searching with it while an 
+ * application iterates over its own search results, e.g. when creating physics nodes in a loop over
+ * h3dGetNodeFindResult, would replace the application's results. These functions walk the hierarchy
+ * with h3dGetNodeChild instead and visit the nodes in the same order as h3dFindNodes.
+ */
+class SceneSearch
+{
+public:
+	/**
+	 * Returns the first node with the given name and type in the branch of a node, including the node itself
+	 * @param startID the node the search starts at
+	 * @param name the name of the node, an empty string matches any name
+	 * @param type the H3DNodeTypes of the node, H3DNodeTypes::Undefined matches any type
+	 * @return the node or 0 if there is no such node
+	 */
+	static int findNode(int startID, const char* name, int type);
+
+	/**
+	 * Appends all nodes with the given name and type in the branch of a node, including the node itself
+	 * @param startID the node the search starts at
+	 * @param name the name of the nodes, an empty string matches any name
+	 * @param type the H3DNodeTypes of the nodes, H3DNodeTypes::Undefined matches any type
+	 * @param nodes array receiving the nodes, parents precede their children
+	 */
+	static void findNodes(int startID, const char* name, int type, std::vector<int>& nodes);
+
+private:
+	/// Visits a node and its children, stops after the first match if first is true
+	static bool visit(int hordeID, const char* name, int type, std::vector<int>& nodes, bool first);
+};
@@ -0,0 +1,226 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+#include "egTaskScheduler.h"
+#include <algorithm>
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+using namespace std;
+
+namespace
+{
+	/// Scheduler the calling thread is a worker of
+	THREAD_LOCAL const TaskScheduler*	currentScheduler = 0;
+	/// Index of the calling thread within its scheduler
+	THREAD_LOCAL int					currentIndex = 0;
+}
+
+TaskScheduler::TaskScheduler(int numThreads) : m_numTasks(0), m_shutdown(false)
+{
+	if (numThreads <= 0)
+		numThreads = max((int) thread::hardware_concurrency() - 1, 1);
+	for (int i = 0; i <= numThreads; ++i)
+		m_queues.push_back(new WorkQueue());
+	for (int i = 0; i < numThreads; ++i)
+		m_threads.push_back(thread(&TaskScheduler::workerLoop, this, i));
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_condition.notify_all();
+	for (unsigned int i = 0; i < m_threads.size(); ++i)
+		m_threads[i].join();
+	for (unsigned int i = 0; i < m_queues.size(); ++i)
+		delete m_queues[i];
+}
+
+int TaskScheduler::threadIndex() const
+{
+	return currentScheduler == this ? currentIndex : numThreads();
+}
+
+void TaskScheduler::submit(TaskFunction function, void* data)
+{
+	Task task = { function, data };
+	push(threadIndex(), task);
+	notify(false);
+}
+
+void TaskScheduler::notify(bool all)
+{
+	{
+		// synchronizes with workers that are about to sleep
+		lock_guard<mutex> lock(m_mutex);
+	}
+	if (all)
+		m_condition.notify_all();
+	else
+		m_condition.notify_one();
+}
+
+void TaskScheduler::parallelFor(int count, int grainSize, RangeFunction function, void* data)
+{
+	if (count <= 0)
+		return;
+	grainSize = max(grainSize, 1);
+	const int numChunks = (count + grainSize - 1) / grainSize;
+	const bool external = currentScheduler != this;
+	unique_lock<recursive_mutex> externalLock(m_externalMutex, defer_lock);
+	if (external)
+		externalLock.lock();
+	const int self = threadIndex();
+	if (numChunks == 1 || m_threads.empty())
+	{
+		function(0, count, self, data);
+		return;
+	}
+
+	RangeBatch batch;
+	batch.scheduler = this;
+	batch.count = count;
+	batch.grainSize = grainSize;
+	batch.function = function;
+	batch.data = data;
+	batch.next = 0;
+	// one helper per worker at most, each of them claims chunks until none are left
+	const int numHelpers = min(numChunks - 1, numThreads());
+	batch.helpers = numHelpers;
+	const int numQueues = (int) m_queues.size();
+	for (int i = 0; i < numHelpers; ++i)
+	{
+		Task task = { &RangeBatch::help, &batch };
+		push((self + 1 + i) % numQueues, task);
+	}
+	notify(true);
+
+	batch.run(self);
+	// helpers that haven't started yet are taken back instead of waiting for busy workers
+	batch.helpers -= cancel(&batch);
+	while (batch.helpers > 0)
+		this_thread::yield();
+}
+
+void TaskScheduler::RangeBatch::run(int threadIndex)
+{
+	const int numChunks = (count + grainSize - 1) / grainSize;
+	for (int chunk = next++; chunk < numChunks; chunk = next++)
+	{
+		const int begin = chunk * grainSize;
+		function(begin, min(begin + grainSize, count), threadIndex, data);
+	}
+}
+
+void TaskScheduler::RangeBatch::help(void* batch)
+{
+	RangeBatch* range = (RangeBatch*) batch;
+	range->run(range->scheduler->threadIndex());
+	--range->helpers;
+}
+
+void TaskScheduler::push(int queue, const Task& task)
+{
+	{
+		lock_guard<mutex> lock(m_queues[queue]->mutex);
+		m_queues[queue]->tasks.push_back(task);
+	}
+	++m_numTasks;
+}
+
+bool TaskScheduler::pop(int queue, Task& task)
+{
+	const int numQueues = (int) m_queues.size();
+	for (int i = 0; i < numQueues; ++i)
+	{
+		WorkQueue* workQueue = m_queues[(queue + i) % numQueues];
+		lock_guard<mutex> lock(workQueue->mutex);
+		if (workQueue->tasks.empty())
+			continue;
+		// own tasks are taken LIFO while their data is still in the cache, stolen ones FIFO
+		if (i == 0)
+		{
+			task = workQueue->tasks.back();
+			workQueue->tasks.pop_back();
+		}
+		else
+		{
+			task = workQueue->tasks.front();
+			workQueue->tasks.pop_front();
+		}
+		--m_numTasks;
+		return true;
+	}
+	return false;
+}
+
+int TaskScheduler::cancel(void* data)
+{
+	int removed = 0;
+	for (unsigned int i = 0; i < m_queues.size(); ++i)
+	{
+		WorkQueue* workQueue = m_queues[i];
+		lock_guard<mutex> lock(workQueue->mutex);
+		for (deque<Task>::iterator iter = workQueue->tasks.begin(); iter != workQueue->tasks.end(); )
+		{
+			if (iter->data == data)
+			{
+				iter = workQueue->tasks.erase(iter);
+				--m_numTasks;
+				++removed;
+			}
+			else
+				++iter;
+		}
+	}
+	return removed;
+}
+
+void TaskScheduler::workerLoop(int index)
+{
+	currentScheduler = this;
+	currentIndex = index;
+	for (;;)
+	{
+		Task task;
+		if (pop(index, task))
+		{
+			task.function(task.data);
+			continue;
+		}
+		unique_lock<mutex> lock(m_mutex);
+		while (m_numTasks == 0 && !m_shutdown)
+			m_condition.wait(lock);
+		// remaining tasks are still executed on shutdown
+		if (m_numTasks == 0)
+			return;
+	}
+}
@@ -0,0 +1,155 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "Horde3DPhysics.h"
+
+/**
+ * \brief Work stealing pool of worker threads, the default Horde3DPhysics::ITaskScheduler
+ *
+ * Each worker has its own task queue. Workers execute the newest task of their own queue first and steal the
+ * oldest task of another queue once their own queue runs empty. Tasks submitted from other threads are
+ * stolen from a shared queue. Threads that are not a worker share the thread index numThreads(), so their
+ * parallelFor calls are serialized.
+ *
+ * A thread waiting for its parallelFor only processes chunks of that call. It never runs other queued tasks,
+ * which would stall the caller with long background work like the cooking of collision meshes.
+ */
+class TaskScheduler : public Horde3DPhysics::ITaskScheduler
+{
+public:
+	/**
+	 * Constructor
+	 * @param numThreads number of worker threads, 0 uses one thread less than available hardware threads
+	 */
+	TaskScheduler(int numThreads = 0);
+	/// Destructor, waits until all submitted tasks have been executed
+	~TaskScheduler();
+
+	/**
+	 * Returns the number of worker threads
+	 */
+	int numThreads() const { return (int) m_threads.size(); }
+
+	int numThreadIndices() const { return numThreads() + 1; }
+	int threadIndex() const;
+	void submit(TaskFunction function, void* data);
+	void parallelFor(int count, int grainSize, RangeFunction function, void* data);
+
+private:
+	/// Queued function call
+	struct Task
+	{
+		TaskFunction	function;
+		void*			data;
+	};
+
+	/// Task queue of a single worker, the queue at index numThreads() receives the tasks of other threads
+	struct WorkQueue
+	{
+		std::mutex			mutex;
+		std::deque<Task>	tasks;
+	};
+
+	/// Chunks of a parallelFor call, claimed one after another by the caller and the helping workers
+	struct RangeBatch
+	{
+		TaskScheduler*		scheduler;
+		int					count;
+		int					grainSize;
+		RangeFunction		function;
+		void*				data;
+		/// Index of the next chunk that has not been claimed
+		std::atomic<int>	next;
+		/// Number of helper tasks that have been queued and neither finished nor taken back
+		std::atomic<int>	helpers;
+
+		/// Processes chunks until all of them have been claimed
+		void run(int threadIndex);
+		/// Task function of the helpers
+		static void help(void* batch);
+	};
+
+	/// Main loop of each worker thread
+	void workerLoop(int index);
+
+	/**
+	 * Appends a task to a queue
+	 * @param queue index of the queue
+	 */
+	void push(int queue, const Task& task);
+
+	/**
+	 * Takes the newest task of the given queue or steals the oldest task of another queue
+	 * @param queue index of the queue of the calling thread
+	 * @param task receives the task
+	 * @return false if all queues are empty
+	 */
+	bool pop(int queue, Task& task);
+
+	/**
+	 * Removes the queued tasks with the given data
+	 * @return number of removed tasks
+	 */
+	int cancel(void* data);
+
+	/// Wakes up sleeping workers after tasks have been queued
+	void notify(bool all);
+
+	std::vector<std::thread>	m_threads;
+	std::vector<WorkQueue*>		m_queues;
+	/// Number of queued tasks, workers sleep while it is zero
+	std::atomic<int>			m_numTasks;
+	std::mutex					m_mutex;
+	std::condition_variable		m_condition;
+	bool						m_shutdown;
+	/// Serializes the parallelFor calls of threads that are not a worker, they share a thread index
+	std::recursive_mutex		m_externalMutex;
+};
+
+/**
+ * Runs a function object through ITaskScheduler::parallelFor
+ * @param scheduler the scheduler, 0 processes all indices on the calling thread with thread index 0
+ * @param function called with the first and the end index of a range and the index of the executing thread
+ */
+template<class Function>
+void parallelFor(Horde3DPhysics::ITaskScheduler* scheduler, int count, int grainSize, const Function& function)
+{
+	struct Invoker
+	{
+		static void invoke(int begin, int end, int threadIndex, void* data) { (*(const Function*) data)(begin, end, threadIndex); }
+	};
+	if (scheduler)
+		scheduler->parallelFor(count, grainSize, &Invoker::invoke, (void*) &function);
+	else if (count > 0)
+		function(0, count, 0);
+}
@@ -0,0 +1,194 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egTrigger.h"
+#include <algorithm>
+
+using namespace std;
+
+Trigger::Trigger(int hordeID, btCollisionShape* shape) : m_hordeID(hordeID)
+{
+	m_ghostObject = new btGhostObject();
+	m_ghostObject->setCollisionShape(shape);
+	m_ghostObject->setCollisionFlags(btCollisionObject::CF_NO_CONTACT_RESPONSE);
+	m_ghostObject->setUserIndex(hordeID);
+}
+
+Trigger::~Trigger()
+{
+	delete m_ghostObject;
+}
+
+void Trigger::setTransformation(const float* x)
+{
+	btTransform transformation;
+	transformation.setFromOpenGLMatrix(x);
+	// the scale is part of the collision shape
+	btMatrix3x3& basis = transformation.getBasis();
+	for (int i = 0; i < 3; ++i)
+	{
+		const btVector3 column = basis.getColumn(i).normalized();
+		basis[0][i] = column[0];
+		basis[1][i] = column[1];
+		basis[2][i] = column[2];
+	}
+	m_ghostObject->setWorldTransform(transformation);
+}
+
+int Trigger::findChanges()
+{
+	m_current.clear();
+	const int numOverlaps = m_ghostObject->getNumOverlappingObjects();
+	for (int i = 0; i < numOverlaps; ++i)
+	{
+		const int id = m_ghostObject->getOverlappingObject(i)->getUserIndex();
+		if (id > 0)
+			m_current.push_back(id);
+	}
+	// the links of a ragdoll share the node id
+	sort(m_current.begin(), m_current.end());
+	m_current.erase(unique(m_current.begin(), m_current.end()), m_current.end());
+
+	m_changes.clear();
+	Horde3DPhysics::TriggerEvent event;
+	event.trigger = m_hordeID;
+	vector<int>::const_iterator current = m_current.begin(), previous = m_overlaps.begin();
+	while (current != m_current.end() || previous != m_overlaps.end())
+	{
+		if (previous == m_overlaps.end() || (current != m_current.end() && *current < *previous))
+		{
+			event.other = *current++;
+			event.entered = true;
+			m_changes.push_back(event);
+		}
+		else if (current == m_current.end() || *previous < *current)
+		{
+			event.other = *previous++;
+			event.entered = false;
+			m_changes.push_back(event);
+		}
+		else
+		{
+			++current;
+			++previous;
+		}
+	}
+	return (int) m_changes.size();
+}
+
+void Trigger::commitChanges(Horde3DPhysics::TriggerEvent* events, int count)
+{
+	copy(m_changes.begin(), m_changes.begin() + count, events);
+	if (count == (int) m_changes.size())
+	{
+		m_overlaps.swap(m_current);
+		return;
+	}
+	// the remaining changes are found again by the next call
+	for (int i = 0; i < count; ++i)
+	{
+		if (m_changes[i].entered)
+			m_overlaps.insert(lower_bound(m_overlaps.begin(), m_overlaps.end(), m_changes[i].other), m_changes[i].other);
+		else
+			m_overlaps.erase(lower_bound(m_overlaps.begin(), m_overlaps.end(), m_changes[i].other));
+	}
+}
+
+TriggerBatch::TriggerBatch() : m_events(1024), m_numEvents(0), m_firstTrigger(0)
+{
+}
+
+TriggerBatch::~TriggerBatch()
+{
+	for (unsigned int i = 0; i < m_triggers.size(); ++i)
+		delete m_triggers[i];
+}
+
+void TriggerBatch::add(Trigger* trigger)
+{
+	m_triggers.push_back(trigger);
+}
+
+Trigger* TriggerBatch::remove(int hordeID)
+{
+	for (unsigned int i = 0; i < m_triggers.size(); ++i)
+	{
+		if (m_triggers[i]->hordeID() == hordeID)
+		{
+			Trigger* trigger = m_triggers[i];
+			m_triggers.erase(m_triggers.begin() + i);
+			return trigger;
+		}
+	}
+	return 0;
+}
+
+void TriggerBatch::setEventCapacity(int capacity)
+{
+	m_events.resize(max(capacity, 1));
+	m_numEvents = 0;
+}
+
+void TriggerBatch::update(Horde3DPhysics::ITaskScheduler* scheduler)
+{
+	const int numTriggers = (int) m_triggers.size();
+	m_numChanges.resize(numTriggers);
+	parallelFor(scheduler, numTriggers, 64, [this](int begin, int end, int)
+	{
+		for (int i = begin; i < end; ++i)
+			m_numChanges[i] = m_triggers[i]->findChanges();
+	});
+
+	// Triggers whose events don't fit keep their previous overlaps and report them next time, starting with
+	// the first one that has been skipped
+	m_numEvents = 0;
+	const int capacity = (int) m_events.size();
+	const int first = m_firstTrigger < numTriggers ? m_firstTrigger : 0;
+	m_firstTrigger = 0;
+	bool skipped = false;
+	for (int n = 0; n < numTriggers; ++n)
+	{
+		const int i = (first + n) % numTriggers;
+		if (m_numChanges[i] == 0)
+			continue;
+		// a trigger with more changes than the capacity reports as many as possible
+		const int numEvents = min(m_numChanges[i], capacity - m_numEvents);
+		if (numEvents < m_numChanges[i] && (m_numEvents > 0 || skipped))
+		{
+			if (!skipped)
+				m_firstTrigger = i;
+			skipped = true;
+			continue;
+		}
+		m_triggers[i]->commitChanges(&m_events[m_numEvents], numEvents);
+		m_numEvents += numEvents;
+	}
+}
+
+const Horde3DPhysics::TriggerEvent* TriggerBatch::events(int& count) const
+{
+	count = m_numEvents;
+	return m_numEvents > 0 ? &m_events[0] : 0;
+}
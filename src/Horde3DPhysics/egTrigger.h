@@ -0,0 +1,137 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <vector>
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <Bullet/BulletCollision/CollisionDispatch/btGhostObject.h>
+
+#include "egTaskScheduler.h"
+
+/**
+ * \brief Volume reporting the nodes whose collision objects overlap it
+ *
+ * The ghost object has no contact response, its pairs are skipped by the narrowphase, so the overlaps are
+ * those of the bounding boxes maintained by the broadphase. Objects are identified by the Horde3D node id
+ * stored as their user index, objects without node id are ignored.
+ */
+class Trigger
+{
+public:
+	/**
+	 * Constructor
+	 * @param hordeID id of the Horde3D node
+	 * @param shape collision shape of the volume, it is not deleted by the trigger
+	 */
+	Trigger(int hordeID, btCollisionShape* shape);
+	~Trigger();
+
+	int hordeID() const { return m_hordeID; }
+	btGhostObject* ghostObject() { return m_ghostObject; }
+
+	/**
+	 * Moves the volume to a new transformation
+	 * @param x absolute transformation (OpenGL matrix), its scale is ignored
+	 */
+	void setTransformation(const float* x);
+
+	/**
+	 * Compares the current overlaps to those of the last committed call
+	 *
+	 * Does not access the Horde3D engine nor modify the world, so it may be called for different triggers at the same time.
+	 * @return number of events that would be committed
+	 */
+	int findChanges();
+
+	/**
+	 * Writes the changes found by findChanges and makes them part of the reference for the next call
+	 * @param events array receiving the events
+	 * @param count number of changes to commit, the others will be found again by the next findChanges call
+	 */
+	void commitChanges(Horde3DPhysics::TriggerEvent* events, int count);
+
+private:
+	btGhostObject*		m_ghostObject;
+	/// Sorted ids of the overlapping nodes reported so far
+	std::vector<int>	m_overlaps;
+	/// Sorted ids of the currently overlapping nodes, kept to reuse the memory
+	std::vector<int>	m_current;
+	/// Events found by findChanges
+	std::vector<Horde3DPhysics::TriggerEvent>	m_changes;
+	/// ID within the Horde3D scenegraph
+	int					m_hordeID;
+};
+
+/**
+ * \brief All triggers of the world and the events of the last update
+ *
+ * The events are written to a buffer allocated once with a fixed capacity. The events of a trigger that
+ * don't fit into the buffer anymore are reported by the next update, which starts with that trigger, so
+ * no overlap is lost and entering and leaving always come in pairs.
+ */
+class TriggerBatch
+{
+public:
+	TriggerBatch();
+	/// Destructor, deletes the remaining triggers
+	~TriggerBatch();
+
+	void add(Trigger* trigger);
+	/**
+	 * Removes a trigger from the batch without deleting it
+	 * @return the trigger or 0 if the node has no trigger
+	 */
+	Trigger* remove(int hordeID);
+
+	int numTriggers() const { return (int) m_triggers.size(); }
+	Trigger* trigger(int index) const { return m_triggers[index]; }
+
+	/**
+	 * Sets the maximum number of events reported by a single update
+	 */
+	void setEventCapacity(int capacity);
+
+	/**
+	 * Replaces the events with the overlaps that have begun or ended since the last update
+	 * @param scheduler scheduler comparing the overlaps of the triggers in parallel or 0
+	 */
+	void update(Horde3DPhysics::ITaskScheduler* scheduler);
+
+	/**
+	 * Returns the events of the last update
+	 * @param count receives the number of events
+	 */
+	const Horde3DPhysics::TriggerEvent* events(int& count) const;
+
+private:
+	std::vector<Trigger*>		m_triggers;
+	/// Number of changes found for each trigger
+	std::vector<int>			m_numChanges;
+	std::vector<Horde3DPhysics::TriggerEvent>	m_events;
+	int							m_numEvents;
+	/// Trigger whose events didn't fit during the last update
+	int							m_firstTrigger;
+};
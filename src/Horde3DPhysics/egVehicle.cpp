@@ -0,0 +1,271 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egVehicle.h"
+#include "egSceneSearch.h"
+#include <Horde3D/Horde3D.h>
+#include <Horde3D/utMath.h>
+#include <cstdio>
+
+using namespace std;
+using namespace Horde3D;
+
+namespace
+{
+	/// Collects the objects whose bounding boxes overlap the suspension rays of a vehicle
+	struct CandidateCollector : public btBroadphaseAabbCallback
+	{
+		CandidateCollector(const btCollisionObject* chassis) : chassis(chassis) {}
+
+		virtual bool process(const btBroadphaseProxy* proxy)
+		{
+			const btCollisionObject* object = (const btCollisionObject*) proxy->m_clientObject;
+			// the wheels stand on rigid bodies only, not on the chassis itself, characters or triggers
+			const btRigidBody* body = btRigidBody::upcast(object);
+			if (body && body != chassis && body->hasContactResponse())
+				candidates.push_back(object);
+			return true;
+		}
+
+		const btCollisionObject*						chassis;
+		btAlignedObjectArray<const btCollisionObject*>	candidates;
+	};
+}
+
+Vehicle::Vehicle(btRigidBody* chassis, int hordeID, const VehicleDefinition& definition) : m_vehicle(0), m_hordeID(hordeID)
+{
+	m_tuning.m_suspensionStiffness = definition.stiffness;
+	m_tuning.m_suspensionCompression = definition.compression;
+	m_tuning.m_suspensionDamping = definition.damping;
+	m_tuning.m_maxSuspensionTravelCm = definition.maxTravel;
+	m_tuning.m_frictionSlip = definition.frictionSlip;
+	m_tuning.m_maxSuspensionForce = definition.maxForce;
+
+	m_raycaster.hits = 0;
+	m_raycaster.numHits = m_raycaster.next = 0;
+	m_vehicle = new btRaycastVehicle(m_tuning, chassis, &m_raycaster);
+	// x points to the right, y up and z forward
+	m_vehicle->setCoordinateSystem(0, 1, 2);
+
+	const btTransform chassisInv = chassis->getWorldTransform().inverse();
+	for (int i = 0; i < definition.numWheels; ++i)
+	{
+		const WheelDefinition& wheel = definition.wheels[i];
+		const int wheelID = SceneSearch::findNode(hordeID, wheel.node, H3DNodeTypes::Undefined);
+		if (wheelID == 0)
+		{
+			printf("Wheel node '%s' of vehicle '%s' not found\n", wheel.node, h3dGetNodeParamStr(hordeID, H3DNodeParams::NameStr));
+			continue;
+		}
+		const float* x = 0;
+		h3dGetNodeTransMats(wheelID, 0, &x);
+		const btVector3 connection = chassisInv * btVector3(x[12], x[13], x[14]);
+		btWheelInfo& info = m_vehicle->addWheel(connection, btVector3(0, -1, 0), btVector3(-1, 0, 0), wheel.suspension, wheel.radius,
+			m_tuning, wheel.front);
+		info.m_rollInfluence = definition.rollInfluence;
+
+		// the wheel node keeps its orientation relative to the rotating and steered wheel
+		m_vehicle->updateWheelTransform(m_vehicle->getNumWheels() - 1, false);
+		float wheelTrans[16];
+		m_vehicle->getWheelTransformWS(m_vehicle->getNumWheels() - 1).getOpenGLMatrix(wheelTrans);
+		const Matrix4f offset = Matrix4f(wheelTrans).inverted() * Matrix4f(x);
+		m_wheelOffsets.insert(m_wheelOffsets.end(), offset.x, offset.x + 16);
+		m_wheelIDs.push_back(wheelID);
+	}
+	m_hits.resize(m_wheelIDs.size());
+}
+
+Vehicle::~Vehicle()
+{
+	delete m_vehicle;
+}
+
+void Vehicle::setControls(float engineForce, float brake, float steering)
+{
+	for (int i = 0; i < m_vehicle->getNumWheels(); ++i)
+	{
+		const bool front = m_vehicle->getWheelInfo(i).m_bIsFrontWheel;
+		m_vehicle->applyEngineForce(front ? 0 : engineForce, i);
+		m_vehicle->setSteeringValue(front ? steering : 0, i);
+		m_vehicle->setBrake(brake, i);
+	}
+	// parked vehicles fall asleep like any other body
+	m_vehicle->getRigidBody()->activate();
+}
+
+void Vehicle::castRays(btCollisionWorld* world)
+{
+	// Rays are calculated exactly like btRaycastVehicle::rayCast does
+	const int numWheels = m_vehicle->getNumWheels();
+	btVector3 aabbMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT), aabbMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+	for (int i = 0; i < numWheels; ++i)
+	{
+		btWheelInfo& wheel = m_vehicle->getWheelInfo(i);
+		m_vehicle->updateWheelTransformsWS(wheel, false);
+		const btVector3& from = wheel.m_raycastInfo.m_hardPointWS;
+		const btVector3 to = from + wheel.m_raycastInfo.m_wheelDirectionWS * (wheel.getSuspensionRestLength() + wheel.m_wheelsRadius);
+		aabbMin.setMin(from);
+		aabbMin.setMin(to);
+		aabbMax.setMax(from);
+		aabbMax.setMax(to);
+	}
+
+	// One broadphase query for all wheels of the vehicle
+	CandidateCollector collector(m_vehicle->getRigidBody());
+	world->getBroadphase()->aabbTest(aabbMin, aabbMax, collector);
+
+	for (int i = 0; i < numWheels; ++i)
+	{
+		const btWheelInfo& wheel = m_vehicle->getWheelInfo(i);
+		const btVector3& from = wheel.m_raycastInfo.m_hardPointWS;
+		const btVector3 to = from + wheel.m_raycastInfo.m_wheelDirectionWS * (wheel.getSuspensionRestLength() + wheel.m_wheelsRadius);
+		btCollisionWorld::ClosestRayResultCallback callback(from, to);
+		const btTransform fromTrans(btQuaternion::getIdentity(), from), toTrans(btQuaternion::getIdentity(), to);
+		for (int j = 0; j < collector.candidates.size(); ++j)
+		{
+			btCollisionObject* object = const_cast<btCollisionObject*>(collector.candidates[j]);
+			btCollisionWorld::rayTestSingle(fromTrans, toTrans, object, object->getCollisionShape(), object->getWorldTransform(), callback);
+		}
+
+		WheelHit& hit = m_hits[i];
+		hit.object = callback.m_collisionObject;
+		hit.fraction = callback.m_closestHitFraction;
+		for (int j = 0; j < 3; ++j)
+		{
+			hit.point[j] = callback.m_hitPointWorld[j];
+			hit.normal[j] = callback.m_hitNormalWorld[j];
+		}
+	}
+	m_raycaster.hits = m_hits.empty() ? 0 : &m_hits[0];
+	m_raycaster.numHits = (int) m_hits.size();
+	m_raycaster.next = 0;
+}
+
+void* Vehicle::Raycaster::castRay(const btVector3& /*from*/, const btVector3& /*to*/, btVehicleRaycasterResult& result)
+{
+	if (next >= numHits)
+		return 0;
+	const WheelHit& hit = hits[next++];
+	if (!hit.object)
+		return 0;
+	result.m_hitPointInWorld.setValue(hit.point[0], hit.point[1], hit.point[2]);
+	result.m_hitNormalInWorld.setValue(hit.normal[0], hit.normal[1], hit.normal[2]);
+	result.m_hitNormalInWorld.normalize();
+	result.m_distFraction = hit.fraction;
+	return (void*) hit.object;
+}
+
+void Vehicle::update()
+{
+	const float* parentMat = 0;
+	h3dGetNodeTransMats(m_hordeID, 0, &parentMat);
+	if (!parentMat)
+		return;
+	const Matrix4f parentInv = Matrix4f(parentMat).inverted();
+	for (unsigned int i = 0; i < m_wheelIDs.size(); ++i)
+	{
+		// the chassis node has just been updated, the wheels are interpolated like the chassis
+		m_vehicle->updateWheelTransform(i, true);
+		float wheelTrans[16];
+		m_vehicle->getWheelTransformWS(i).getOpenGLMatrix(wheelTrans);
+		const Matrix4f absTrans = Matrix4f(wheelTrans) * Matrix4f(&m_wheelOffsets[i * 16]);
+		// wheel nodes may be nested below other children of the chassis
+		const int parentID = h3dGetNodeParent(m_wheelIDs[i]);
+		if (parentID == m_hordeID)
+			h3dSetNodeTransMat(m_wheelIDs[i], (parentInv * absTrans).x);
+		else
+		{
+			const float* wheelParentMat = 0;
+			h3dGetNodeTransMats(parentID, 0, &wheelParentMat);
+			h3dSetNodeTransMat(m_wheelIDs[i], (Matrix4f(wheelParentMat).inverted() * absTrans).x);
+		}
+	}
+}
+
+VehicleBatch::~VehicleBatch()
+{
+	for (unsigned int i = 0; i < m_vehicles.size(); ++i)
+		delete m_vehicles[i];
+}
+
+void VehicleBatch::add(Vehicle* vehicle)
+{
+	m_vehicles.push_back(vehicle);
+}
+
+Vehicle* VehicleBatch::remove(const btRigidBody* chassis)
+{
+	for (unsigned int i = 0; i < m_vehicles.size(); ++i)
+	{
+		if (m_vehicles[i]->chassis() == chassis)
+		{
+			Vehicle* vehicle = m_vehicles[i];
+			m_vehicles.erase(m_vehicles.begin() + i);
+			return vehicle;
+		}
+	}
+	return 0;
+}
+
+Vehicle* VehicleBatch::find(int hordeID) const
+{
+	for (unsigned int i = 0; i < m_vehicles.size(); ++i)
+	{
+		if (m_vehicles[i]->hordeID() == hordeID)
+			return m_vehicles[i];
+	}
+	return 0;
+}
+
+void VehicleBatch::updateAction(btCollisionWorld* collisionWorld, btScalar deltaTimeStep)
+{
+	m_awakeVehicles.clear();
+	for (unsigned int i = 0; i < m_vehicles.size(); ++i)
+	{
+		if (m_vehicles[i]->chassis()->isActive())
+			m_awakeVehicles.push_back(m_vehicles[i]);
+	}
+
+#ifdef HORDEPHYSICS_BULLET_NO_PROFILE
+	Horde3DPhysics::ITaskScheduler* scheduler = m_scheduler;
+#else
+	// the ray tests of some shapes are profiled, Bullet's profiler is not thread safe
+	Horde3DPhysics::ITaskScheduler* scheduler = 0;
+#endif
+	// All suspension rays are cast before any vehicle applies its impulses
+	parallelFor(scheduler, (int) m_awakeVehicles.size(), 16, [this, collisionWorld](int begin, int end, int)
+	{
+		for (int i = begin; i < end; ++i)
+			m_awakeVehicles[i]->castRays(collisionWorld);
+	});
+	for (unsigned int i = 0; i < m_awakeVehicles.size(); ++i)
+		m_awakeVehicles[i]->vehicle()->updateVehicle(deltaTimeStep);
+}
+
+void VehicleBatch::debugDraw(btIDebugDraw* debugDrawer)
+{
+	for (unsigned int i = 0; i < m_vehicles.size(); ++i)
+		m_vehicles[i]->vehicle()->debugDraw(debugDrawer);
+}
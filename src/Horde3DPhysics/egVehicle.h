@@ -0,0 +1,152 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <vector>
+#include <Bullet/btBulletDynamicsCommon.h>
+
+#include "egAttachment.h"
+#include "egTaskScheduler.h"
+
+/**
+ * \brief Raycast vehicle using the rigid body of a physics node as chassis
+ *
+ * The wheels are child nodes of the chassis node, their positions at creation become the connection points
+ * of the suspension. The suspension rays are not cast by btRaycastVehicle itself: the VehicleBatch casts
+ * the rays of all vehicles in one pass before the vehicles are updated, the raycaster of the vehicle only 
+ * hands out the results of that pass.
+ */
+class Vehicle
+{
+public:
+	/**
+	 * Constructor
+	 * @param chassis rigid body of the chassis node, it has to be part of the world
+	 * @param hordeID id of the chassis node
+	 * @param definition the values of the Vehicle element
+	 */
+	Vehicle(btRigidBody* chassis, int hordeID, const VehicleDefinition& definition);
+	~Vehicle();
+
+	/**
+	 * Returns true if at least one wheel node has been found
+	 */
+	bool isValid() const { return !m_wheelIDs.empty(); }
+
+	int hordeID() const { return m_hordeID; }
+	btRaycastVehicle* vehicle() { return m_vehicle; }
+	btRigidBody* chassis() { return m_vehicle->getRigidBody(); }
+
+	/**
+	 * Sets the engine force of the rear wheels, the brake force of all wheels and the steering angle of the front wheels
+	 */
+	void setControls(float engineForce, float brake, float steering);
+
+	/**
+	 * Calculates the suspension rays of all wheels and casts them against the objects of the world
+	 *
+	 * May be called for different vehicles at the same time, the world is only read.
+	 */
+	void castRays(btCollisionWorld* world);
+
+	/**
+	 * Transfers the transformations of the wheels to their Horde3D nodes
+	 */
+	void update();
+
+private:
+	/// Result of a suspension ray
+	struct WheelHit
+	{
+		const btCollisionObject*	object;
+		float						point[3];
+		float						normal[3];
+		float						fraction;
+	};
+
+	/// Hands out the results of castRays() in the order btRaycastVehicle requests them
+	struct Raycaster : public btVehicleRaycaster
+	{
+		virtual void* castRay(const btVector3& from, const btVector3& to, btVehicleRaycasterResult& result);
+
+		const WheelHit*		hits;
+		int					numHits;
+		int					next;
+	};
+
+	btRaycastVehicle*		m_vehicle;
+	Raycaster				m_raycaster;
+	btRaycastVehicle::btVehicleTuning	m_tuning;
+	std::vector<WheelHit>	m_hits;
+	/// Horde3D nodes of the wheels
+	std::vector<int>		m_wheelIDs;
+	/// Transformation of each wheel node relative to its wheel, 16 floats per wheel
+	std::vector<float>		m_wheelOffsets;
+	/// ID within the Horde3D scenegraph
+	int						m_hordeID;
+};
+
+/**
+ * \brief Single action updating all vehicles of the world
+ *
+ * Each simulation step first casts the suspension rays of all awake vehicles, in parallel if a scheduler
+ * is set and the library is built with HORDEPHYSICS_BULLET_NO_PROFILE, and then updates the vehicles one after 
+ * another. Vehicles of sleeping chassis are skipped.
+ */
+class VehicleBatch : public btActionInterface
+{
+public:
+	VehicleBatch() : m_scheduler(0) {}
+	/// Destructor, deletes the remaining vehicles
+	virtual ~VehicleBatch();
+
+	/**
+	 * Sets the thread pool the rays are cast on
+	 * @param scheduler the scheduler or 0 to cast all rays on the simulating thread
+	 */
+	void setScheduler(Horde3DPhysics::ITaskScheduler* scheduler) { m_scheduler = scheduler; }
+
+	void add(Vehicle* vehicle);
+	/**
+	 * Removes a vehicle from the batch without deleting it
+	 * @return the vehicle or 0 if there is no vehicle for the chassis
+	 */
+	Vehicle* remove(const btRigidBody* chassis);
+	/// Returns the vehicle of a chassis node or 0
+	Vehicle* find(int hordeID) const;
+
+	int numVehicles() const { return (int) m_vehicles.size(); }
+	Vehicle* vehicle(int index) const { return m_vehicles[index]; }
+
+	virtual void updateAction(btCollisionWorld* collisionWorld, btScalar deltaTimeStep);
+	virtual void debugDraw(btIDebugDraw* debugDrawer);
+
+private:
+	Horde3DPhysics::ITaskScheduler*	m_scheduler;
+	std::vector<Vehicle*>			m_vehicles;
+	/// Vehicles updated in the current step
+	std::vector<Vehicle*>			m_awakeVehicles;
+};
@@ -0,0 +1,136 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egWorldPartition.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+void WorldPartition::setup(float cellSize, int activeCells, int loadedCells)
+{
+	m_cellSize = cellSize > 0 ? cellSize : 0;
+	m_activeCells = max(activeCells, 0);
+	m_loadedCells = max(loadedCells, m_activeCells);
+}
+
+bool WorldPartition::setFocus(float x, float z)
+{
+	const int focusX = cell(x + m_origin[0]), focusZ = cell(z + m_origin[2]);
+	if (focusX == m_focusX && focusZ == m_focusZ)
+		return false;
+	m_focusX = focusX;
+	m_focusZ = focusZ;
+	return true;
+}
+
+int WorldPartition::cell(double coordinate) const
+{
+	return m_cellSize > 0 ? (int) floor(coordinate / m_cellSize) : 0;
+}
+
+WorldPartition::Ring WorldPartition::ring(float x, float z) const
+{
+	const int distance = max(abs(cell(x + m_origin[0]) - m_focusX), abs(cell(z + m_origin[2]) - m_focusZ));
+	if (distance <= m_activeCells)
+		return Active;
+	return distance <= m_loadedCells ? Sleeping : Evicted;
+}
+
+void WorldPartition::store(const BodyState& state)
+{
+	// the position is independent of later origin shifts while the body is evicted
+	BodyState stored = state;
+	for (int i = 0; i < 3; ++i)
+		stored.position[i] += m_origin[i];
+	m_cells[key(cell(stored.position[0]), cell(stored.position[2]))].push_back(stored);
+}
+
+void WorldPartition::load(vector<BodyState>& states, bool all)
+{
+	for (map<long long, vector<BodyState> >::iterator iter = m_cells.begin(); iter != m_cells.end(); )
+	{
+		const int x = (int) (iter->first >> 32), z = (int) (iter->first & 0xffffffff);
+		if (!all && max(abs(x - m_focusX), abs(z - m_focusZ)) > m_loadedCells)
+		{
+			++iter;
+			continue;
+		}
+		for (unsigned int i = 0; i < iter->second.size(); ++i)
+		{
+			states.push_back(iter->second[i]);
+			for (int j = 0; j < 3; ++j)
+				states.back().position[j] -= m_origin[j];
+		}
+		m_cells.erase(iter++);
+	}
+}
+
+void WorldPartition::forget(int hordeID)
+{
+	for (map<long long, vector<BodyState> >::iterator iter = m_cells.begin(); iter != m_cells.end(); ++iter)
+	{
+		vector<BodyState>& cell = iter->second;
+		for (unsigned int i = 0; i < cell.size(); ++i)
+		{
+			if (cell[i].hordeID == hordeID)
+			{
+				cell.erase(cell.begin() + i);
+				if (cell.empty())
+					m_cells.erase(iter);
+				return;
+			}
+		}
+	}
+}
+
+bool WorldPartition::isEvicted(int hordeID) const
+{
+	for (map<long long, vector<BodyState> >::const_iterator iter = m_cells.begin(); iter != m_cells.end(); ++iter)
+	{
+		for (unsigned int i = 0; i < iter->second.size(); ++i)
+		{
+			if (iter->second[i].hordeID == hordeID)
+				return true;
+		}
+	}
+	return false;
+}
+
+int WorldPartition::numEvicted() const
+{
+	int count = 0;
+	for (map<long long, vector<BodyState> >::const_iterator iter = m_cells.begin(); iter != m_cells.end(); ++iter)
+		count += (int) iter->second.size();
+	return count;
+}
+
+void WorldPartition::shiftOrigin(float x, float y, float z)
+{
+	m_origin[0] += x;
+	m_origin[1] += y;
+	m_origin[2] += z;
+}
@@ -0,0 +1,125 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <vector>
+#include <map>
+
+/**
+ * \brief Grid of cells around a focus point deciding which bodies are simulated
+ *
+ * The cells divide the XZ plane. Bodies in cells up to activeCells away from the focus cell are simulated,
+ * bodies up to loadedCells away are kept asleep and the bodies of all other cells are evicted: their state
+ * is stored in a compact buffer of their cell and their physics nodes are deleted until the focus comes 
+ * close again. The cells stay in place when the origin of the world is shifted.
+ */
+class WorldPartition
+{
+public:
+	/// Part of the grid a cell belongs to
+	enum Ring { Active, Sleeping, Evicted };
+
+	/// State of an evicted body
+	struct BodyState
+	{
+		/// Horde3D node the body is recreated for from its attachment
+		int		hordeID;
+		/// false for static and kinematic bodies, they only need their node
+		bool	dynamic;
+		bool	sleeping;
+		/// Position relative to the current origin, kept relative to the initial origin while the body is evicted
+		double	position[3];
+		float	rotation[4];
+		float	linearVelocity[3];
+		float	angularVelocity[3];
+	};
+
+	WorldPartition() : m_cellSize(0), m_activeCells(0), m_loadedCells(0), m_focusX(0), m_focusZ(0)
+	{
+		m_origin[0] = m_origin[1] = m_origin[2] = 0;
+	}
+
+	/**
+	 * Configures the grid
+	 * @param cellSize edge length of the cells, 0 disables the partition
+	 * @param activeCells distance of the cells with simulated bodies, in cells from the focus cell
+	 * @param loadedCells distance of the cells with sleeping bodies, at least activeCells
+	 */
+	void setup(float cellSize, int activeCells, int loadedCells);
+
+	bool isEnabled() const { return m_cellSize > 0; }
+
+	/**
+	 * Moves the focus
+	 * @return true if the focus has entered another cell
+	 */
+	bool setFocus(float x, float z);
+
+	/// Returns the ring of the cell containing a position
+	Ring ring(float x, float z) const;
+
+	/// Stores the state of a body evicted from the cell containing its position
+	void store(const BodyState& state);
+
+	/**
+	 * Moves the states of all cells that are not evicted anymore to the given array
+	 * @param states array the states are appended to
+	 * @param all true to take the states of all cells
+	 */
+	void load(std::vector<BodyState>& states, bool all);
+
+	/// Drops the state of a node that has been removed
+	void forget(int hordeID);
+
+	/// Returns true if the body of the node is evicted
+	bool isEvicted(int hordeID) const;
+
+	/// Returns the number of evicted bodies
+	int numEvicted() const;
+
+	/**
+	 * Moves the origin the positions passed to the partition are relative to
+	 * @param x,y,z new origin relative to the current one
+	 */
+	void shiftOrigin(float x, float y, float z);
+
+private:
+	/// Returns the cell containing a coordinate along one axis
+	int cell(double coordinate) const;
+	/// Key of a cell in the cell map
+	static long long key(int x, int z) { return ((long long) x << 32) | (unsigned int) z; }
+
+	float			m_cellSize;
+	int				m_activeCells;
+	int				m_loadedCells;
+	/// Cell containing the focus
+	int				m_focusX;
+	int				m_focusZ;
+	/// Current origin relative to the initial one
+	double			m_origin[3];
+	/// Bodies of the evicted cells
+	std::map<long long, std::vector<BodyState> >	m_cells;
+};
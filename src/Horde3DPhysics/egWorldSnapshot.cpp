@@ -0,0 +1,292 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egWorldSnapshot.h"
+#include <Bullet/btBulletDynamicsCommon.h>
+#include <algorithm>
+#include <cfloat>
+
+using namespace std;
+
+namespace
+{
+	/// Maximum number of entries per leaf of the bounding volume hierarchy
+	const int LeafSize = 4;
+	/// Maximum depth of the hierarchy, median splits keep it logarithmic
+	const int MaxDepth = 64;
+
+	/// Orders entries along an axis by the center of their bounding boxes
+	template<class Entry> struct CenterLess
+	{
+		int axis;
+		bool operator()(const Entry& a, const Entry& b) const
+		{
+			return a.aabbMin[axis] + a.aabbMax[axis] < b.aabbMin[axis] + b.aabbMax[axis];
+		}
+	};
+
+	inline bool boxesOverlap(const float* minA, const float* maxA, const float* minB, const float* maxB)
+	{
+		return minA[0] <= maxB[0] && maxA[0] >= minB[0] && minA[1] <= maxB[1] && maxA[1] >= minB[1] &&
+			minA[2] <= maxB[2] && maxA[2] >= minB[2];
+	}
+
+	/// Slab test of the ray from + t * direction, 0 <= t <= maxFraction against a box
+	inline bool rayHitsBox(const float* from, const float* invDirection, float maxFraction, const float* boxMin, const float* boxMax)
+	{
+		float tMin = 0, tMax = maxFraction;
+		for (int i = 0; i < 3; ++i)
+		{
+			float t0 = (boxMin[i] - from[i]) * invDirection[i];
+			float t1 = (boxMax[i] - from[i]) * invDirection[i];
+			if (t0 > t1) swap(t0, t1);
+			if (t0 > tMin) tMin = t0;
+			if (t1 < tMax) tMax = t1;
+			if (tMin > tMax) return false;
+		}
+		return true;
+	}
+
+	/// Records the closest hit of btCollisionWorld::rayTestSingle without accessing the collision object
+	struct SnapshotRayCallback : public btCollisionWorld::RayResultCallback
+	{
+		btVector3	m_normal;
+		bool		m_normalInWorldSpace;
+		bool		m_hit;
+
+		SnapshotRayCallback(btScalar maxFraction) : m_normalInWorldSpace(true), m_hit(false) { m_closestHitFraction = maxFraction; }
+
+		virtual btScalar addSingleResult(btCollisionWorld::LocalRayResult& rayResult, bool normalInWorldSpace)
+		{
+			m_closestHitFraction = rayResult.m_hitFraction;
+			m_normal = rayResult.m_hitNormalLocal;
+			m_normalInWorldSpace = normalInWorldSpace;
+			m_hit = true;
+			return m_closestHitFraction;
+		}
+	};
+}
+
+RetiredCollisionData::~RetiredCollisionData()
+{
+	for (unsigned int i = 0; i < shapes.size(); ++i)
+		delete shapes[i];
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+		delete meshes[i];
+	// unlink containers nobody else holds one by one instead of recursing through the whole chain
+	shared_ptr<RetiredCollisionData> following;
+	following.swap(next);
+	while (following && following.use_count() == 1)
+	{
+		shared_ptr<RetiredCollisionData> after;
+		after.swap(following->next);
+		following = after;
+	}
+}
+
+void WorldSnapshot::clear()
+{
+	m_entries.clear();
+	m_nodes.clear();
+	m_retired.reset();
+}
+
+void WorldSnapshot::add( const btCollisionObject* object, int hordeID )
+{
+	const btBroadphaseProxy* proxy = object->getBroadphaseHandle();
+	if (!proxy)
+		return;
+	Entry entry;
+	entry.hordeID = hordeID;
+	entry.shape = object->getCollisionShape();
+	const btTransform& transformation = object->getWorldTransform();
+	for (int i = 0; i < 3; ++i)
+	{
+		entry.aabbMin[i] = proxy->m_aabbMin[i];
+		entry.aabbMax[i] = proxy->m_aabbMax[i];
+		entry.origin[i] = transformation.getOrigin()[i];
+		for (int j = 0; j < 3; ++j)
+			entry.basis[i * 3 + j] = transformation.getBasis()[i][j];
+	}
+	m_entries.push_back(entry);
+}
+
+void WorldSnapshot::build()
+{
+	m_nodes.clear();
+	if (!m_entries.empty())
+	{
+		m_nodes.reserve(m_entries.size() / LeafSize * 2 + 1);
+		buildNode(0, (int) m_entries.size());
+	}
+}
+
+int WorldSnapshot::buildNode( int begin, int end )
+{
+	const int index = (int) m_nodes.size();
+	m_nodes.push_back(BvhNode());
+
+	BvhNode node;
+	float centerMin[3], centerMax[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		node.aabbMin[i] = centerMin[i] = FLT_MAX;
+		node.aabbMax[i] = centerMax[i] = -FLT_MAX;
+	}
+	for (int e = begin; e < end; ++e)
+	{
+		const Entry& entry = m_entries[e];
+		for (int i = 0; i < 3; ++i)
+		{
+			node.aabbMin[i] = min(node.aabbMin[i], entry.aabbMin[i]);
+			node.aabbMax[i] = max(node.aabbMax[i], entry.aabbMax[i]);
+			const float center = entry.aabbMin[i] + entry.aabbMax[i];
+			centerMin[i] = min(centerMin[i], center);
+			centerMax[i] = max(centerMax[i], center);
+		}
+	}
+
+	if (end - begin <= LeafSize)
+	{
+		node.first = begin;
+		node.count = end - begin;
+	}
+	else
+	{
+		// median split along the axis with the largest spread of the box centers
+		CenterLess<Entry> less;
+		less.axis = 0;
+		for (int i = 1; i < 3; ++i)
+		{
+			if (centerMax[i] - centerMin[i] > centerMax[less.axis] - centerMin[less.axis])
+				less.axis = i;
+		}
+		const int middle = (begin + end) / 2;
+		nth_element(m_entries.begin() + begin, m_entries.begin() + middle, m_entries.begin() + end, less);
+		buildNode(begin, middle);
+		node.first = buildNode(middle, end);
+		node.count = 0;
+	}
+	m_nodes[index] = node;
+	return index;
+}
+
+int WorldSnapshot::castRay( const float* from, const float* to, float* hitPoint, float* hitNormal ) const
+{
+	if (m_nodes.empty())
+		return 0;
+
+	float direction[3], invDirection[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		direction[i] = to[i] - from[i];
+		// a large factor instead of infinity avoids NaN for rays starting on a box face
+		invDirection[i] = direction[i] != 0 ? 1.0f / direction[i] : FLT_MAX;
+	}
+	btTransform rayFrom, rayTo;
+	rayFrom.setIdentity();
+	rayFrom.setOrigin(btVector3(from[0], from[1], from[2]));
+	rayTo.setIdentity();
+	rayTo.setOrigin(btVector3(to[0], to[1], to[2]));
+
+	float closest = 1.0f;
+	int hitID = 0;
+	btVector3 normal(0, 0, 0);
+
+	int stack[MaxDepth];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const int index = stack[--stackSize];
+		const BvhNode& node = m_nodes[index];
+		if (!rayHitsBox(from, invDirection, closest, node.aabbMin, node.aabbMax))
+			continue;
+		if (node.count == 0)
+		{
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = index + 1;
+			continue;
+		}
+		for (int e = node.first; e < node.first + node.count; ++e)
+		{
+			const Entry& entry = m_entries[e];
+			if (!rayHitsBox(from, invDirection, closest, entry.aabbMin, entry.aabbMax))
+				continue;
+			const btMatrix3x3 basis(entry.basis[0], entry.basis[1], entry.basis[2], entry.basis[3], entry.basis[4], 
+				entry.basis[5], entry.basis[6], entry.basis[7], entry.basis[8]);
+			const btTransform transformation(basis, btVector3(entry.origin[0], entry.origin[1], entry.origin[2]));
+			SnapshotRayCallback callback(closest);
+			btCollisionWorld::rayTestSingle(rayFrom, rayTo, 0, entry.shape, transformation, callback);
+			if (callback.m_hit && callback.m_closestHitFraction < closest)
+			{
+				closest = callback.m_closestHitFraction;
+				hitID = entry.hordeID;
+				normal = callback.m_normalInWorldSpace ? callback.m_normal : basis * callback.m_normal;
+			}
+		}
+	}
+
+	if (hitID)
+	{
+		normal.safeNormalize();
+		for (int i = 0; i < 3; ++i)
+		{
+			if (hitPoint) hitPoint[i] = from[i] + direction[i] * closest;
+			if (hitNormal) hitNormal[i] = normal[i];
+		}
+	}
+	return hitID;
+}
+
+int WorldSnapshot::queryAabb( const float* aabbMin, const float* aabbMax, int* hordeIDs, int maxIDs ) const
+{
+	if (m_nodes.empty())
+		return 0;
+
+	int count = 0;
+	int stack[MaxDepth];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0 && count < maxIDs)
+	{
+		const int index = stack[--stackSize];
+		const BvhNode& node = m_nodes[index];
+		if (!boxesOverlap(aabbMin, aabbMax, node.aabbMin, node.aabbMax))
+			continue;
+		if (node.count == 0)
+		{
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = index + 1;
+			continue;
+		}
+		for (int e = node.first; e < node.first + node.count && count < maxIDs; ++e)
+		{
+			if (boxesOverlap(aabbMin, aabbMax, m_entries[e].aabbMin, m_entries[e].aabbMax))
+				hordeIDs[count++] = m_entries[e].hordeID;
+		}
+	}
+	return count;
+}
@@ -0,0 +1,134 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+
+class btCollisionObject;
+class btCollisionShape;
+class btStridingMeshInterface;
+
+/**
+ * \brief Collision data of removed nodes that snapshots built before the removal may still reference
+ *
+ * Each snapshot holds the container filled after it has been built, and every container holds the one
+ * of the next snapshot. This way the data is deleted as soon as the last snapshot that may reference 
+ * it has been released, on whichever thread that happens.
+ */
+struct RetiredCollisionData
+{
+	std::vector<btCollisionShape*>			shapes;
+	std::vector<btStridingMeshInterface*>	meshes;
+	/// Data retired after the next snapshot has been built
+	std::shared_ptr<RetiredCollisionData>	next;
+
+	~RetiredCollisionData();
+};
+
+/**
+ * \brief Read-only copy of the collision objects at the end of a frame
+ *
+ * Stores the bounding boxes, transformations and collision shapes of all collision objects together with
+ * a bounding volume hierarchy over the boxes. Once built, a snapshot is never changed again, so any number 
+ * of threads may query it while the world is being simulated.
+ */
+class WorldSnapshot
+{
+public:
+	/**
+	 * Removes all collision objects, keeps the allocated memory
+	 */
+	void clear();
+
+	/**
+	 * Copies the current state of a collision object that is part of the world
+	 * @param object the collision object
+	 * @param hordeID the id of the Horde3D node the object belongs to
+	 */
+	void add( const btCollisionObject* object, int hordeID );
+
+	/**
+	 * Builds the bounding volume hierarchy after all objects have been added
+	 */
+	void build();
+
+	/**
+	 * Finds the closest intersection of a line segment with the collision shapes
+	 * @param from start point of the ray
+	 * @param to end point of the ray
+	 * @param hitPoint receives the intersection point, may be 0
+	 * @param hitNormal receives the surface normal at the intersection point, may be 0
+	 * @return the id of the Horde3D node that has been hit, 0 if nothing has been hit
+	 */
+	int castRay( const float* from, const float* to, float* hitPoint, float* hitNormal ) const;
+
+	/**
+	 * Finds the collision objects whose bounding boxes overlap an axis aligned box
+	 * @param aabbMin minimum corner of the box
+	 * @param aabbMax maximum corner of the box
+	 * @param hordeIDs receives the ids of the Horde3D nodes
+	 * @param maxIDs size of the hordeIDs array
+	 * @return number of ids written to hordeIDs
+	 */
+	int queryAabb( const float* aabbMin, const float* aabbMax, int* hordeIDs, int maxIDs ) const;
+
+	/// Collision data retired after the snapshot has been built
+	std::shared_ptr<RetiredCollisionData>	m_retired;
+
+private:
+	/// Copied state of a collision object
+	struct Entry
+	{
+		int						hordeID;
+		const btCollisionShape*	shape;
+		float					aabbMin[3];
+		float					aabbMax[3];
+		/// Rotation (row major) and translation of the world transformation
+		float					basis[9];
+		float					origin[3];
+	};
+
+	/// Node of the bounding volume hierarchy, inner nodes are followed by their left child
+	struct BvhNode
+	{
+		float	aabbMin[3];
+		float	aabbMax[3];
+		/// First entry of a leaf, index of the right child of an inner node
+		int		first;
+		/// Number of entries of a leaf, 0 for inner nodes
+		int		count;
+	};
+
+	/**
+	 * Builds the hierarchy for a range of entries recursively
+	 * @return index of the created node
+	 */
+	int buildNode( int begin, int end );
+
+	std::vector<Entry>		m_entries;
+	std::vector<BvhNode>	m_nodes;
+};
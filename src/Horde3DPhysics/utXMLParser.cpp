@@ -471,6 +471,84 @@ typedef enum XMLTokenTypeTag
     eTokenError
 } XMLTokenType;
 
+// Memory blocks of a document parsed in arena mode (see XMLNode::parseStringArena).
+// The XMLNodeData structures, their arrays and strings are bump-allocated inside the blocks.
+// Nothing is released individually: the blocks are freed together with the last node of the document.
+typedef struct XMLArenaBlock
+{
+    struct XMLArenaBlock *pNext;
+    size_t               size, used;      // the data follows the (aligned) header
+} XMLArenaBlock;
+
+typedef struct XMLArena
+{
+    XMLArenaBlock   *pBlocks;           // the first block is the one currently filled
+    int             ref_count;          // number of XMLNodeData allocated inside the arena
+    XMLCSTR         lpSource;           // in situ buffer that is not part of the blocks (parseStringInSitu)
+    XMLCSTR         lpSourceEnd;
+} XMLArena;
+
+#define ARENA_ALIGN      8
+#define ARENA_BLOCKSIZE  65536
+#define ARENA_MINFIRSTBLOCKSIZE 4096
+#define ARENA_HEADERSIZE ((sizeof(XMLArenaBlock)+ARENA_ALIGN-1)&~(size_t)(ARENA_ALIGN-1))
+
+static inline char *arenaBlockData(XMLArenaBlock *b) { return ((char*)b)+ARENA_HEADERSIZE; }
+
+// The first block is sized to hold the document, small attachment strings don't need a full block
+static XMLArena *createArena(size_t firstBlockSize)
+{
+    if (firstBlockSize<ARENA_MINFIRSTBLOCKSIZE) firstBlockSize=ARENA_MINFIRSTBLOCKSIZE;
+    XMLArena *a=(XMLArena*)malloc(sizeof(XMLArena));
+    XMLArenaBlock *b=(XMLArenaBlock*)malloc(ARENA_HEADERSIZE+firstBlockSize);
+    b->pNext=NULL; b->size=firstBlockSize; b->used=0;
+    a->pBlocks=b;
+    a->ref_count=0;
+    a->lpSource=a->lpSourceEnd=NULL;
+    return a;
+}
+
+static void destroyArena(XMLArena *a)
+{
+    XMLArenaBlock *b=a->pBlocks;
+    while (b) { XMLArenaBlock *n=b->pNext; free(b); b=n; }
+    free(a);
+}
+
+static void *arenaAlloc(XMLArena *a, size_t size)
+{
+    size=(size+ARENA_ALIGN-1)&~(size_t)(ARENA_ALIGN-1);
+    XMLArenaBlock *b=a->pBlocks;
+    if (b->used+size>b->size)
+    {
+        if (size>ARENA_BLOCKSIZE/4)
+        {
+            // large arrays get a block of their own, the free space of the current block is kept
+            XMLArenaBlock *l=(XMLArenaBlock*)malloc(ARENA_HEADERSIZE+size);
+            l->pNext=b->pNext; l->size=l->used=size;
+            b->pNext=l;
+            return arenaBlockData(l);
+        }
+        b=(XMLArenaBlock*)malloc(ARENA_HEADERSIZE+ARENA_BLOCKSIZE);
+        b->pNext=a->pBlocks; b->size=ARENA_BLOCKSIZE; b->used=0;
+        a->pBlocks=b;
+    }
+    void *p=arenaBlockData(b)+b->used;
+    b->used+=size;
+    return p;
+}
+
+// Checks if a pointer has been allocated inside the arena or points into its in situ buffer.
+// Strings added to an arena document by the user are still allocated with malloc.
+static char arenaOwns(XMLArena *a, const void *p)
+{
+    const char *c=(const char*)p;
+    if ((c>=(const char*)a->lpSource)&&(c<(const char*)a->lpSourceEnd)) return TRUE;
+    for (XMLArenaBlock *b=a->pBlocks; b; b=b->pNext)
+        if ((c>=arenaBlockData(b))&&(c<arenaBlockData(b)+b->size)) return TRUE;
+    return FALSE;
+}
+
 // Main structure used for parsing XML
 typedef struct XML
 {
@@ -483,6 +561,9 @@ typedef struct XML
     XMLCSTR                lpNewElement;
     int                    cbNewElement;
     int                    nFirst;
+    XMLArena               *pArena;          // arena mode: strings are referenced in place
+    XMLSTR                 *pTerminators;    // ends of the in place strings, zero terminated after parsing
+    int                    nTerminators, maxTerminators;
 } XML;
 
 typedef struct
@@ -548,6 +629,29 @@ XMLError XMLNode::writeToFile(XMLCSTR filename, const char *encoding, char nForm
     return eXMLErrorNone;
 }
 
+// private:
+// Duplicate a string of the parsed document. In arena mode the string is either copied into
+// the arena or, if "inSitu" is set, referenced in place and zero terminated after parsing
+// (terminating it right away would break the tokenizer that still has to read the character).
+static XMLSTR parserStringDup(XML *pXML, XMLCSTR lpszData, int cbData, char inSitu)
+{
+    if (!pXML->pArena) return stringDup(lpszData,cbData);
+    if (inSitu)
+    {
+        if (pXML->nTerminators==pXML->maxTerminators)
+        {
+            pXML->maxTerminators=pXML->maxTerminators ? pXML->maxTerminators*2 : 256;
+            pXML->pTerminators=(XMLSTR*)realloc(pXML->pTerminators,pXML->maxTerminators*sizeof(XMLSTR));
+        }
+        pXML->pTerminators[pXML->nTerminators++]=(XMLSTR)lpszData+cbData;
+        return (XMLSTR)lpszData;
+    }
+    XMLSTR lpszNew=(XMLSTR)arenaAlloc(pXML->pArena,(cbData+1)*sizeof(XMLCHAR));
+    memcpy(lpszNew, lpszData, cbData*sizeof(XMLCHAR));
+    lpszNew[cbData]=(XMLCHAR)NULL;
+    return lpszNew;
+}
+
 // Duplicate a given string.
 XMLSTR stringDup(XMLCSTR lpszData, int cbData)
 {
@@ -641,6 +745,14 @@ XMLSTR fromXMLString(XMLCSTR s, int lo, XML *pXML)
     // out:  new allocated string converted from xml
     if (!s) return NULL;
 
+    if (pXML->pArena)
+    {
+        // strings without entities are used in place
+        int n=0;
+        while ((n<lo)&&(s[n])&&(s[n]!=_X('&'))) n++;
+        if ((n==lo)||(!s[n])) return parserStringDup(pXML,s,n,TRUE);
+    }
+
     int ll=0,j;
     XMLSTR d;
     XMLCSTR ss=s;
@@ -685,7 +797,8 @@ XMLSTR fromXMLString(XMLCSTR s, int lo, XML *pXML)
         ll++;
     }
 
-    d=(XMLSTR)malloc((ll+1)*sizeof(XMLCHAR));
+    if (pXML->pArena) d=(XMLSTR)arenaAlloc(pXML->pArena,(ll+1)*sizeof(XMLCHAR));
+    else d=(XMLSTR)malloc((ll+1)*sizeof(XMLCHAR));
     s=d;
     while (ll-->0)
     {
@@ -702,7 +815,7 @@ XMLSTR fromXMLString(XMLCSTR s, int lo, XML *pXML)
                         if ((*ss>=_X('0'))&&(*ss<=_X('9'))) j=(j<<4)+*ss-_X('0');
                         else if ((*ss>=_X('A'))&&(*ss<=_X('F'))) j=(j<<4)+*ss-_X('A')+10;
                         else if ((*ss>=_X('a'))&&(*ss<=_X('f'))) j=(j<<4)+*ss-_X('a')+10;
-                        else { free((void*)s); pXML->error=eXMLErrorUnknownCharacterEntity;return NULL;}
+                        else { if (!pXML->pArena) free((void*)s); pXML->error=eXMLErrorUnknownCharacterEntity;return NULL;}
                         ss++;
                     }
                 } else
@@ -710,7 +823,7 @@ XMLSTR fromXMLString(XMLCSTR s, int lo, XML *pXML)
                     while (*ss!=_X(';'))
                     {
                         if ((*ss>=_X('0'))&&(*ss<=_X('9'))) j=(j*10)+*ss-_X('0');
-                        else { free((void*)s); pXML->error=eXMLErrorUnknownCharacterEntity;return NULL;}
+                        else { if (!pXML->pArena) free((void*)s); pXML->error=eXMLErrorUnknownCharacterEntity;return NULL;}
                         ss++;
                     }
                 }
@@ -942,20 +1055,53 @@ static NextToken GetNextToken(XML *pXML, int *pcbToken, enum XMLTokenTypeTag *pT
     return result;
 }
 
+#define MEMORYINCREASE 50
+
+static inline void myFree(void *p) { if (p) free(p); };
+static inline void myFreeArray(XMLArena *a, void *p) { if (p&&!a) free(p); };
+static inline void myFreeString(XMLArena *a, XMLCSTR p) { if (p&&((!a)||(!arenaOwns(a,p)))) free((void*)p); };
+static inline void *myRealloc(XMLArena *a, void *p, int newsize, int memInc, int sizeofElem)
+{
+    if (a)
+    {
+        // Arrays inside the arena grow by doubling: with the fixed increments below,
+        // every node would reserve room for 50 children and attributes.
+        int n=newsize-1;
+        if (p==NULL) return arenaAlloc(a,4*sizeofElem);
+        if ((n>=4)&&((n&(n-1))==0))
+        {
+            void *q=arenaAlloc(a,2*n*sizeofElem);
+            memcpy(q,p,n*sizeofElem);
+            p=q;
+        }
+        return p;
+    }
+    if (p==NULL) { if (memInc) return malloc(memInc*sizeofElem); return malloc(sizeofElem); }
+    if ((memInc==0)||((newsize%memInc)==0)) p=realloc(p,(newsize+memInc)*sizeofElem);
+//    if (!p)
+//    {
+//        printf("XMLParser Error: Not enough memory! Aborting...\n"); exit(220);
+//    }
+    return p;
+}
+
 XMLCSTR XMLNode::updateName_WOSD(XMLSTR lpszName)
 {
     if (!d) { free(lpszName); return NULL; }
-    if (d->lpszName&&(lpszName!=d->lpszName)) free((void*)d->lpszName);
+    if (d->lpszName&&(lpszName!=d->lpszName)) myFreeString(d->pArena,d->lpszName);
     d->lpszName=lpszName;
     return lpszName;
 }
 
 // private:
 XMLNode::XMLNode(struct XMLNodeDataTag *p){ d=p; (p->ref_count)++; }
-XMLNode::XMLNode(XMLNodeData *pParent, XMLSTR lpszName, char isDeclaration)
+XMLNode::XMLNode(XMLNodeData *pParent, XMLSTR lpszName, char isDeclaration, XMLArena *pArena)
 {
-    d=(XMLNodeData*)malloc(sizeof(XMLNodeData));
+    if ((!pArena)&&pParent) pArena=pParent->pArena;
+    if (pArena) { d=(XMLNodeData*)arenaAlloc(pArena,sizeof(XMLNodeData)); pArena->ref_count++; }
+    else d=(XMLNodeData*)malloc(sizeof(XMLNodeData));
     d->ref_count=1;
+    d->pArena=pArena;
 
     d->lpszName=NULL;
     d->nChild= 0;
@@ -978,20 +1124,6 @@ XMLNode::XMLNode(XMLNodeData *pParent, XMLSTR lpszName, char isDeclaration)
 XMLNode XMLNode::createXMLTopNode_WOSD(XMLSTR lpszName, char isDeclaration) { return XMLNode(NULL,lpszName,isDeclaration); }
 XMLNode XMLNode::createXMLTopNode(XMLCSTR lpszName, char isDeclaration) { return XMLNode(NULL,stringDup(lpszName),isDeclaration); }
 
-#define MEMORYINCREASE 50
-
-static inline void myFree(void *p) { if (p) free(p); };
-static inline void *myRealloc(void *p, int newsize, int memInc, int sizeofElem)
-{
-    if (p==NULL) { if (memInc) return malloc(memInc*sizeofElem); return malloc(sizeofElem); }
-    if ((memInc==0)||((newsize%memInc)==0)) p=realloc(p,(newsize+memInc)*sizeofElem);
-//    if (!p)
-//    {
-//        printf("XMLParser Error: Not enough memory! Aborting...\n"); exit(220);
-//    }
-    return p;
-}
-
 // private:
 XMLElementPosition XMLNode::findPosition(XMLNodeData *d, int index, XMLElementType xxtype)
 {
@@ -1018,9 +1150,9 @@ void *XMLNode::addToOrder(int memoryIncrease,int *_pos, int nc, void *p, int siz
 {
     //  in: *_pos is the position inside d->pOrder ("-1" means "EndOf")
     // out: *_pos is the index inside p
-    p=myRealloc(p,(nc+1),memoryIncrease,size);
+    p=myRealloc(d->pArena,p,(nc+1),memoryIncrease,size);
     int n=d->nChild+d->nText+d->nClear;
-    d->pOrder=(int*)myRealloc(d->pOrder,n+1,memoryIncrease*3,sizeof(int));
+    d->pOrder=(int*)myRealloc(d->pArena,d->pOrder,n+1,memoryIncrease*3,sizeof(int));
     int pos=*_pos,*o=d->pOrder;
 
     if ((pos<0)||(pos>=n)) { *_pos=nc; o[n]=(int)((nc<<2)+xtype); return p; }
@@ -1057,7 +1189,7 @@ XMLAttribute *XMLNode::addAttribute_priv(int memoryIncrease,XMLSTR lpszName, XML
     if (!lpszName) return &emptyXMLAttribute;
     if (!d) { myFree(lpszName); myFree(lpszValuev); return &emptyXMLAttribute; }
     int nc=d->nAttribute;
-    d->pAttribute=(XMLAttribute*)myRealloc(d->pAttribute,(nc+1),memoryIncrease,sizeof(XMLAttribute));
+    d->pAttribute=(XMLAttribute*)myRealloc(d->pArena,d->pAttribute,(nc+1),memoryIncrease,sizeof(XMLAttribute));
     XMLAttribute *pAttr=d->pAttribute+nc;
     pAttr->lpszName = lpszName;
     pAttr->lpszValue = lpszValuev;
@@ -1128,7 +1260,7 @@ char XMLNode::parseClearTag(void *px, void *_pClear)
         pXML->nIndex += cbTemp+(int)xstrlen(pClear.lpszClose);
 
         // Add the clear node to the current element
-        addClear_priv(MEMORYINCREASE,stringDup(lpXML,cbTemp), pClear.lpszOpen, pClear.lpszClose,-1);
+        addClear_priv(MEMORYINCREASE,parserStringDup(pXML,lpXML,cbTemp,TRUE), pClear.lpszOpen, pClear.lpszClose,-1);
         return 0;
     }
 
@@ -1139,6 +1271,7 @@ char XMLNode::parseClearTag(void *px, void *_pClear)
 
 void XMLNode::exactMemory(XMLNodeData *d)
 {
+    if (d->pArena) return;
     if (d->pOrder)     d->pOrder=(int*)realloc(d->pOrder,(d->nChild+d->nText+d->nClear)*sizeof(int));
     if (d->pChild)     d->pChild=(XMLNode*)realloc(d->pChild,d->nChild*sizeof(XMLNode));
     if (d->pAttribute) d->pAttribute=(XMLAttribute*)realloc(d->pAttribute,d->nAttribute*sizeof(XMLAttribute));
@@ -1256,7 +1389,7 @@ int XMLNode::ParseXMLElement(void *pa)
                         // If the name of the new element differs from the name of
                         // the current element we need to add the new element to
                         // the current one and recurse
-                        pNew = addChild_priv(MEMORYINCREASE,stringDup(token.pStr,cbToken), nDeclaration,-1);
+                        pNew = addChild_priv(MEMORYINCREASE,parserStringDup(pXML,token.pStr,cbToken,FALSE), nDeclaration,-1);
 
                         while (!pNew.isEmpty())
                         {
@@ -1310,7 +1443,7 @@ int XMLNode::ParseXMLElement(void *pa)
                                         }
 
                                         // Add the new element and recurse
-                                        pNew = addChild_priv(MEMORYINCREASE,stringDup(pXML->lpNewElement,pXML->cbNewElement),0,-1);
+                                        pNew = addChild_priv(MEMORYINCREASE,parserStringDup(pXML,pXML->lpNewElement,pXML->cbNewElement,FALSE),0,-1);
                                         pXML->cbNewElement = 0;
                                     }
                                     else
@@ -1446,7 +1579,7 @@ int XMLNode::ParseXMLElement(void *pa)
                     // Eg.  'Attribute AnotherAttribute'
                     case eTokenText:
                         // Add the unvalued attribute to the list
-                        addAttribute_priv(MEMORYINCREASE,stringDup(lpszTemp,cbTemp), NULL);
+                        addAttribute_priv(MEMORYINCREASE,parserStringDup(pXML,lpszTemp,cbTemp,TRUE), NULL);
                         // Cache the token then indicate.  We are next to
                         // look for the equals attribute
                         lpszTemp = token.pStr;
@@ -1470,7 +1603,7 @@ int XMLNode::ParseXMLElement(void *pa)
                         if (cbTemp)
                         {
                             // Add the unvalued attribute to the list
-                            addAttribute_priv(MEMORYINCREASE,stringDup(lpszTemp,cbTemp), NULL);
+                            addAttribute_priv(MEMORYINCREASE,parserStringDup(pXML,lpszTemp,cbTemp,TRUE), NULL);
                         }
 
                         // If this is the end of the tag then return to the caller
@@ -1532,7 +1665,7 @@ int XMLNode::ParseXMLElement(void *pa)
                                 attrVal=fromXMLString(attrVal,cbToken,pXML);
                                 if (!attrVal) return FALSE;
                             }
-                            addAttribute_priv(MEMORYINCREASE,stringDup(lpszTemp,cbTemp),attrVal);
+                            addAttribute_priv(MEMORYINCREASE,parserStringDup(pXML,lpszTemp,cbTemp,TRUE),attrVal);
                         }
 
                         // Indicate we are searching for a new attribute
@@ -1580,7 +1713,7 @@ static void CountLinesAndColumns(XMLCSTR lpXML, int nUpto, XMLResults *pResults)
     assert(lpXML);
     assert(pResults);
 
-    struct XML xml={ lpXML,lpXML, 0, 0, eXMLErrorNone, NULL, 0, NULL, 0, TRUE };
+    struct XML xml={ lpXML,lpXML, 0, 0, eXMLErrorNone, NULL, 0, NULL, 0, TRUE, NULL, NULL, 0, 0 };
 
     pResults->nLine = 1;
     pResults->nColumn = 1;
@@ -1598,6 +1731,35 @@ static void CountLinesAndColumns(XMLCSTR lpXML, int nUpto, XMLResults *pResults)
 
 // Parse XML and return the root element.
 XMLNode XMLNode::parseString(XMLCSTR lpszXML, XMLCSTR tag, XMLResults *pResults)
+{
+    return parseString_priv(lpszXML,tag,pResults,NULL);
+}
+
+XMLNode XMLNode::parseStringArena(XMLCSTR lpszXML, XMLCSTR tag, XMLResults *pResults)
+{
+    if (!lpszXML) return parseString_priv(NULL,tag,pResults,NULL);
+
+    // The copy of the source and the nodes usually fit into the first block
+    size_t l=(xstrlen(lpszXML)+1)*sizeof(XMLCHAR);
+    XMLArena *pArena=createArena(l*3);
+    XMLSTR lpszCopy=(XMLSTR)arenaAlloc(pArena,l);
+    memcpy(lpszCopy,lpszXML,l);
+    return parseString_priv(lpszCopy,tag,pResults,pArena);
+}
+
+XMLNode XMLNode::parseStringInSitu(XMLSTR lpszXML, XMLCSTR tag, XMLResults *pResults)
+{
+    if (!lpszXML) return parseString_priv(NULL,tag,pResults,NULL);
+
+    size_t l=xstrlen(lpszXML)+1;
+    XMLArena *pArena=createArena(l*sizeof(XMLCHAR)*2);
+    pArena->lpSource=lpszXML;
+    pArena->lpSourceEnd=lpszXML+l;
+    return parseString_priv(lpszXML,tag,pResults,pArena);
+}
+
+// private:
+XMLNode XMLNode::parseString_priv(XMLCSTR lpszXML, XMLCSTR tag, XMLResults *pResults, XMLArena *pArena)
 {
     if (!lpszXML)
     {
@@ -1610,8 +1772,9 @@ XMLNode XMLNode::parseString(XMLCSTR lpszXML, XMLCSTR tag, XMLResults *pResults)
         return emptyXMLNode;
     }
 
-    XMLNode xnode(NULL,NULL,FALSE);
-    struct XML xml={ lpszXML, lpszXML, 0, 0, eXMLErrorNone, NULL, 0, NULL, 0, TRUE };
+    // In arena mode the arena is released together with the last node of the document
+    XMLNode xnode(NULL,NULL,FALSE,pArena);
+    struct XML xml={ lpszXML, lpszXML, 0, 0, eXMLErrorNone, NULL, 0, NULL, 0, TRUE, pArena, NULL, 0, 0 };
 
     // Create header element
     xnode.ParseXMLElement(&xml);
@@ -1665,17 +1828,24 @@ XMLNode XMLNode::parseString(XMLCSTR lpszXML, XMLCSTR tag, XMLResults *pResults)
             CountLinesAndColumns(xml.lpXML, xml.nIndex, pResults);
         }
     }
+
+    // The source isn't read anymore: zero terminate the strings that are used in place
+    if (!xnode.isEmpty())
+        for (int i=0; i<xml.nTerminators; i++) *(xml.pTerminators[i])=0;
+    myFree(xml.pTerminators);
     return xnode;
 }
 
-XMLNode XMLNode::parseFile(XMLCSTR filename, XMLCSTR tag, XMLResults *pResults)
+// Read a file and convert it to the character type of the library.
+// The returned buffer has to be free'd, the document starts at buffer+(*pHeaderSz).
+static unsigned char *loadXMLFile(XMLCSTR filename, int *pHeaderSz, XMLResults *pResults)
 {
     if (pResults) { pResults->nLine=0; pResults->nColumn=0; }
     FILE *f=xfopen(filename,_X("rb"));
-    if (f==NULL) { if (pResults) pResults->error=eXMLErrorFileNotFound; return emptyXMLNode; }
+    if (f==NULL) { if (pResults) pResults->error=eXMLErrorFileNotFound; return NULL; }
     fseek(f,0,SEEK_END);
     int l=ftell(f),headerSz=0;
-    if (!l) { if (pResults) pResults->error=eXMLErrorEmpty; fclose(f); return emptyXMLNode; }
+    if (!l) { if (pResults) pResults->error=eXMLErrorEmpty; fclose(f); return NULL; }
     fseek(f,0,SEEK_SET);
     unsigned char *buf=(unsigned char*)malloc(l+4);
     fread(buf,l,1,f);
@@ -1712,12 +1882,31 @@ XMLNode XMLNode::parseFile(XMLCSTR filename, XMLCSTR tag, XMLResults *pResults)
     }
 #endif
 
-    if (!buf) { if (pResults) pResults->error=eXMLErrorCharConversionError; return emptyXMLNode; }
+    if (!buf) { if (pResults) pResults->error=eXMLErrorCharConversionError; return NULL; }
+    *pHeaderSz=headerSz;
+    return buf;
+}
+
+XMLNode XMLNode::parseFile(XMLCSTR filename, XMLCSTR tag, XMLResults *pResults)
+{
+    int headerSz=0;
+    unsigned char *buf=loadXMLFile(filename,&headerSz,pResults);
+    if (!buf) return emptyXMLNode;
     XMLNode x=parseString((XMLSTR)(buf+headerSz),tag,pResults);
     free(buf);
     return x;
 }
 
+XMLNode XMLNode::parseFileArena(XMLCSTR filename, XMLCSTR tag, XMLResults *pResults)
+{
+    int headerSz=0;
+    unsigned char *buf=loadXMLFile(filename,&headerSz,pResults);
+    if (!buf) return emptyXMLNode;
+    XMLNode x=parseStringArena((XMLSTR)(buf+headerSz),tag,pResults);
+    free(buf);
+    return x;
+}
+
 static inline void charmemset(XMLSTR dest,XMLCHAR c,int l) { while (l--) *(dest++)=c; }
 // private:
 // Creates an user friendly XML string from a given element with
@@ -2019,7 +2208,7 @@ int XMLNode::detachFromParent(XMLNodeData *d)
     while (((void*)(pa[i].d))!=((void*)d)) i++;
     d->pParent->nChild--;
     if (d->pParent->nChild) memmove(pa+i,pa+i+1,(d->pParent->nChild-i)*sizeof(XMLNode));
-    else { free(pa); d->pParent->pChild=NULL; }
+    else { myFreeArray(d->pParent->pArena,pa); d->pParent->pChild=NULL; }
     return removeOrderElement(d->pParent,eNodeChild,i);
 }
 
@@ -2032,28 +2221,32 @@ void XMLNode::deleteNodeContent_priv(char isInDestuctor, char force)
     if ((d->ref_count==0)||force)
     {
         int i;
-        if (d->pParent) detachFromParent(d);
+        // the child array of the parent holds a reference that is dropped without a destructor call,
+        // otherwise a forced delete leaks the node data and, in arena mode, the whole arena
+        if (d->pParent) { detachFromParent(d); (d->ref_count)--; }
         for(i=0; i<d->nChild; i++) { d->pChild[i].d->pParent=NULL; d->pChild[i].deleteNodeContent_priv(1,force); }
-        myFree(d->pChild);
-        for(i=0; i<d->nText; i++) free((void*)d->pText[i]);
-        myFree(d->pText);
-        for(i=0; i<d->nClear; i++) free((void*)d->pClear[i].lpszValue);
-        myFree(d->pClear);
+        XMLArena *a=d->pArena;
+        myFreeArray(a,d->pChild);
+        for(i=0; i<d->nText; i++) myFreeString(a,d->pText[i]);
+        myFreeArray(a,d->pText);
+        for(i=0; i<d->nClear; i++) myFreeString(a,d->pClear[i].lpszValue);
+        myFreeArray(a,d->pClear);
         for(i=0; i<d->nAttribute; i++)
         {
-            free((void*)d->pAttribute[i].lpszName);
-            if (d->pAttribute[i].lpszValue) free((void*)d->pAttribute[i].lpszValue);
+            myFreeString(a,d->pAttribute[i].lpszName);
+            myFreeString(a,d->pAttribute[i].lpszValue);
         }
-        myFree(d->pAttribute);
-        myFree(d->pOrder);
-        myFree((void*)d->lpszName);
+        myFreeArray(a,d->pAttribute);
+        myFreeArray(a,d->pOrder);
+        myFreeString(a,d->lpszName);
         d->nChild=0;    d->nText=0;    d->nClear=0;    d->nAttribute=0;
         d->pChild=NULL; d->pText=NULL; d->pClear=NULL; d->pAttribute=NULL;
         d->pOrder=NULL; d->lpszName=NULL; d->pParent=NULL;
     }
     if (d->ref_count==0)
     {
-        free(d);
+        if (d->pArena) { if (--(d->pArena->ref_count)==0) destroyArena(d->pArena); }
+        else free(d);
         d=NULL;
     }
 }
@@ -2127,9 +2320,9 @@ void XMLNode::deleteAttribute(int i)
     if ((!d)||(i<0)||(i>=d->nAttribute)) return;
     d->nAttribute--;
     XMLAttribute *p=d->pAttribute+i;
-    free((void*)p->lpszName);
-    if (p->lpszValue) free((void*)p->lpszValue);
-    if (d->nAttribute) memmove(p,p+1,(d->nAttribute-i)*sizeof(XMLAttribute)); else { free(p); d->pAttribute=NULL; }
+    myFreeString(d->pArena,p->lpszName);
+    myFreeString(d->pArena,p->lpszValue);
+    if (d->nAttribute) memmove(p,p+1,(d->nAttribute-i)*sizeof(XMLAttribute)); else { myFreeArray(d->pArena,p); d->pAttribute=NULL; }
 }
 
 void XMLNode::deleteAttribute(XMLAttribute *a){ if (a) deleteAttribute(a->lpszName); }
@@ -2149,9 +2342,9 @@ XMLAttribute *XMLNode::updateAttribute_WOSD(XMLSTR lpszNewValue, XMLSTR lpszNewN
         return NULL;
     }
     XMLAttribute *p=d->pAttribute+i;
-    if (p->lpszValue&&p->lpszValue!=lpszNewValue) free((void*)p->lpszValue);
+    if (p->lpszValue&&p->lpszValue!=lpszNewValue) myFreeString(d->pArena,p->lpszValue);
     p->lpszValue=lpszNewValue;
-    if (lpszNewName&&p->lpszName!=lpszNewName) { free((void*)p->lpszName); p->lpszName=lpszNewName; };
+    if (lpszNewName&&p->lpszName!=lpszNewName) { myFreeString(d->pArena,p->lpszName); p->lpszName=lpszNewName; };
     return p;
 }
 
@@ -2188,8 +2381,8 @@ void XMLNode::deleteText(int i)
     if ((!d)||(i<0)||(i>=d->nText)) return;
     d->nText--;
     XMLCSTR *p=d->pText+i;
-    free((void*)*p);
-    if (d->nText) memmove(p,p+1,(d->nText-i)*sizeof(XMLCSTR)); else { free(p); d->pText=NULL; }
+    myFreeString(d->pArena,*p);
+    if (d->nText) memmove(p,p+1,(d->nText-i)*sizeof(XMLCSTR)); else { myFreeArray(d->pArena,p); d->pText=NULL; }
     removeOrderElement(d,eNodeText,i);
 }
 
@@ -2200,7 +2393,7 @@ XMLCSTR XMLNode::updateText_WOSD(XMLSTR lpszNewValue, int i)
     if (!d) { if (lpszNewValue) free(lpszNewValue); return NULL; }
     if (i>=d->nText) return addText_WOSD(lpszNewValue);
     XMLCSTR *p=d->pText+i;
-    if (*p!=lpszNewValue) { free((void*)*p); *p=lpszNewValue; }
+    if (*p!=lpszNewValue) { myFreeString(d->pArena,*p); *p=lpszNewValue; }
     return lpszNewValue;
 }
 
@@ -2217,8 +2410,8 @@ void XMLNode::deleteClear(int i)
     if ((!d)||(i<0)||(i>=d->nClear)) return;
     d->nClear--;
     XMLClear *p=d->pClear+i;
-    free((void*)p->lpszValue);
-    if (d->nClear) memmove(p,p+1,(d->nClear-i)*sizeof(XMLClear)); else { free(p); d->pClear=NULL; }
+    myFreeString(d->pArena,p->lpszValue);
+    if (d->nClear) memmove(p,p+1,(d->nClear-i)*sizeof(XMLClear)); else { myFreeArray(d->pArena,p); d->pClear=NULL; }
     removeOrderElement(d,eNodeClear,i);
 }
 
@@ -2240,7 +2433,7 @@ XMLClear *XMLNode::updateClear_WOSD(XMLSTR lpszNewContent, int i)
     if (!d) { if (lpszNewContent) free(lpszNewContent); return NULL; }
     if (i>=d->nClear) return addClear_WOSD(lpszNewContent);
     XMLClear *p=d->pClear+i;
-    if (lpszNewContent!=p->lpszValue) { free((void*)p->lpszValue); p->lpszValue=lpszNewContent; }
+    if (lpszNewContent!=p->lpszValue) { myFreeString(d->pArena,p->lpszValue); p->lpszValue=lpszNewContent; }
     return p;
 }
 
@@ -169,6 +169,7 @@ typedef struct XMLAttribute {
 typedef int XMLElementPosition;
 
 struct XMLNodeContents;
+struct XMLArena;
 
 typedef struct XMLDLLENTRY XMLNode
 {
@@ -181,7 +182,7 @@ typedef struct XMLDLLENTRY XMLNode
     //  - parseFile
     //  - openFileHelper
     //  - createXMLTopNode
-    XMLNode(struct XMLNodeDataTag *pParent, XMLSTR lpszName, char isDeclaration);
+    XMLNode(struct XMLNodeDataTag *pParent, XMLSTR lpszName, char isDeclaration, struct XMLArena *pArena=NULL);
     XMLNode(struct XMLNodeDataTag *p);
 
   public:
@@ -213,6 +214,21 @@ typedef struct XMLDLLENTRY XMLNode
     //     can be used to trace the error.
     //   * If you still want to parse the file, you can use the APPROXIMATE_PARSING option as
     //     explained inside the note at the beginning of the "xmlParser.cpp" file.
+
+    // Arena mode: the following 3 functions build the same tree as parseString/parseFile, but all the
+    // nodes, arrays and strings of the document are bump-allocated inside a few large memory blocks
+    // instead of one malloc per item. The blocks are released together once the last XMLNode of the
+    // document has been destroyed. Attribute names and values, texts and clear fields without character
+    // entities are not duplicated: they point directly into the source buffer, which gets zero
+    // terminated in place after parsing.
+    //   * parseStringArena copies the source string into the arena first, so it can be freed at once.
+    //   * parseStringInSitu uses the given buffer directly: its content is modified and the buffer
+    //     must stay valid as long as any node of the document is in use.
+    // Nodes of an arena document can still be modified with the add/update/delete functions below.
+    static XMLNode parseStringArena (XMLCSTR lpXMLString, XMLCSTR tag=NULL, XMLResults *pResults=NULL);
+    static XMLNode parseStringInSitu(XMLSTR  lpXMLString, XMLCSTR tag=NULL, XMLResults *pResults=NULL);
+    static XMLNode parseFileArena   (XMLCSTR    filename, XMLCSTR tag=NULL, XMLResults *pResults=NULL);
+
     // You can have a user-friendly explanation of the parsing error with this function:
     static XMLCSTR getError(XMLError error);
     static XMLCSTR getVersion();
@@ -436,9 +452,11 @@ typedef struct XMLDLLENTRY XMLNode
           XMLAttribute           *pAttribute;     // Array of attributes
           int                    *pOrder;         // order of the child_nodes,text_fields,clear_fields
           int                    ref_count;       // for garbage collection (smart pointers)
+          struct XMLArena        *pArena;         // memory blocks holding the node (=NULL if allocated with malloc)
       } XMLNodeData;
       XMLNodeData *d;
 
+      static XMLNode parseString_priv(XMLCSTR lpszXML, XMLCSTR tag, XMLResults *pResults, struct XMLArena *pArena);
       char parseClearTag(void *px, void *pa);
       char maybeAddTxT(void *pa, XMLCSTR tokenPStr);
       int ParseXMLElement(void *pXML);
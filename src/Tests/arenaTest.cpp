@@ -0,0 +1,206 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+
+#include "utXMLParser.h"
+#include "testing.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	enum Mode { Heap, Arena, InSitu, NumModes };
+
+	const char* document =
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<Scene name=\"Test &amp; more\">\n"
+		"\t<!-- comment -->\n"
+		"\t<Model name='Box' tx=\"1\" ty=\"2\" >text &lt; 3<![CDATA[ <raw> ]]>\n"
+		"\t\t<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Box\" x=\"1\" /></Attachment>\n"
+		"\t</Model>\n"
+		"\t<Model name=\"Sphere\" />\n"
+		"\t<Light name=\"Sun\">on</Light>\n"
+		"</Scene>\n";
+
+	/// The in situ parser modifies its input, the buffer has to outlive the returned document
+	XMLNode parse(Mode mode, const char* text, vector<char>& buffer)
+	{
+		XMLResults results;
+		XMLNode node;
+		switch (mode)
+		{
+		case Arena:
+			node = XMLNode::parseStringArena(text, 0, &results);
+			break;
+		case InSitu:
+			buffer.assign(text, text + strlen(text) + 1);
+			node = XMLNode::parseStringInSitu(&buffer[0], 0, &results);
+			break;
+		default:
+			node = XMLNode::parseString(text, 0, &results);
+			break;
+		}
+		CHECK(results.error == eXMLErrorNone);
+		return node;
+	}
+
+	string toString(const XMLNode& node)
+	{
+		char* xml = node.createXMLString(0);
+		const string result = xml ? xml : "";
+		free(xml);
+		return result;
+	}
+
+	/// Edits every kind of content, so the arena modes have to free and reallocate like the heap mode
+	void modify(XMLNode root)
+	{
+		XMLNode scene = root.getChildNode("Scene");
+		scene.updateAttribute("A much longer name than the one that was parsed", 0, "name");
+		scene.addAttribute("version", "2");
+		scene.deleteClear(0);
+
+		XMLNode box = scene.getChildNode("Model");
+		box.deleteAttribute("tx");
+		box.updateText("text > 4");
+		box.addText(" appended");
+		box.deleteClear(0);
+		box.getChildNode("Attachment").getChildNode("BulletPhysics").updateAttribute("Sphere", 0, "shape");
+
+		XMLNode sphere = scene.getChildNode("Model", 1);
+		for (int i = 0; i < 20; ++i)
+			sphere.addChild("Mesh").addAttribute("index", "i");
+		sphere.getChildNode("Mesh", 3).deleteNodeContent();
+
+		// moving a node between parents keeps it alive
+		XMLNode light = scene.getChildNode("Light");
+		box.addChild(light);
+		light.deleteText();
+		scene.addChild("Camera", FALSE, 0).addText("front");
+	}
+
+	void testEquality()
+	{
+		vector<char> buffer;
+		const string reference = toString(parse(Heap, document, buffer));
+		CHECK(!reference.empty());
+		for (int mode = Arena; mode < NumModes; ++mode)
+			CHECK(toString(parse(static_cast<Mode>(mode), document, buffer)) == reference);
+
+		XMLNode arena = parse(Arena, document, buffer);
+		XMLNode scene = arena.getChildNode("Scene");
+		CHECK(strcmp(scene.getAttribute("name"), "Test & more") == 0);
+		CHECK(strcmp(scene.getChildNode("Model").getText(), "text < 3") == 0);
+		CHECK(strcmp(scene.getChildNode("Model").getClear().lpszValue, " <raw> ") == 0);
+		CHECK(strcmp(scene.getChildNode("Light").getText(), "on") == 0);
+		CHECK(scene.nChildNode("Model") == 2);
+	}
+
+	void testModification()
+	{
+		vector<char> buffer;
+		XMLNode heap = parse(Heap, document, buffer);
+		modify(heap);
+		const string reference = toString(heap);
+		CHECK(reference.find("Camera") != string::npos && reference.find("tx=") == string::npos);
+		for (int mode = Arena; mode < NumModes; ++mode)
+		{
+			XMLNode node = parse(static_cast<Mode>(mode), document, buffer);
+			modify(node);
+			CHECK(toString(node) == reference);
+		}
+	}
+
+	void testDeleteNodeContent()
+	{
+		// a forced delete of a child has to drop the reference of the parent, else the arena is never released
+		XMLNode::parseStringArena("<a><b/><c/></a>", "a").getChildNode("c").deleteNodeContent();
+
+		for (int mode = Heap; mode < NumModes; ++mode)
+		{
+			vector<char> buffer;
+			XMLNode root = parse(static_cast<Mode>(mode), document, buffer);
+			XMLNode scene = root.getChildNode("Scene");
+			XMLNode box = scene.getChildNode("Model");
+			XMLNode attachment = box.getChildNode("Attachment");
+			box.deleteNodeContent();
+			CHECK(!box.getName() && box.nChildNode() == 0 && box.nAttribute() == 0);
+			CHECK(scene.nChildNode("Model") == 1);
+			// the child of a deleted node is emptied as well, but its handle stays valid
+			CHECK(attachment.nChildNode() == 0 && attachment.getParentNode().isEmpty());
+			root.deleteNodeContent();
+			CHECK(scene.nChildNode() == 0);
+		}
+	}
+
+	void testDestructionOrder()
+	{
+		for (int mode = Heap; mode < NumModes; ++mode)
+		{
+			vector<char> buffer;
+			XMLNode physics, light;
+			{
+				XMLNode root = parse(static_cast<Mode>(mode), document, buffer);
+				XMLNode scene = root.getChildNode("Scene");
+				physics = scene.getChildNode("Model").getChildNode("Attachment").getChildNode("BulletPhysics");
+				light = scene.getChildNode("Light");
+			}
+			// the document is gone, the nodes referenced from outside keep their content and the arena
+			CHECK(strcmp(physics.getAttribute("shape"), "Box") == 0);
+			CHECK(strcmp(light.getText(), "on") == 0);
+			physics.updateAttribute("Sphere", 0, "shape");
+			CHECK(strcmp(physics.getAttribute("shape"), "Sphere") == 0);
+			// the parents weren't referenced, so they are released with the document
+			CHECK(physics.getParentNode().isEmpty());
+			physics = XMLNode();
+			CHECK(strcmp(light.getName(), "Light") == 0);
+		}
+
+		// a detached subtree outlives the document it came from
+		XMLNode scene;
+		{
+			XMLNode root = XMLNode::parseStringArena(document);
+			scene = root.getChildNode("Scene");
+			XMLNode copy = scene.deepCopy();
+			root = XMLNode();
+			CHECK(toString(copy) == toString(scene));
+		}
+		CHECK(scene.nChildNode("Model") == 2);
+	}
+}
+
+int main()
+{
+	testEquality();
+	testModification();
+	testDeleteNodeContent();
+	testDestructionOrder();
+	return Testing::result("arenaTest");
+}
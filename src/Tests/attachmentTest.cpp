@@ -0,0 +1,240 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egAttachment.h"
+#include "testing.h"
+
+#include <cstring>
+
+namespace
+{
+	float parse(const char* text)
+	{
+		return AttachmentParser::parseFloat(text, text + strlen(text));
+	}
+
+	void testParseFloat()
+	{
+		CHECK(parse("0") == 0.0f);
+		CHECK(parse("1") == 1.0f);
+		CHECK(parse("-2.5") == -2.5f);
+		CHECK(parse("+0.125") == 0.125f);
+		CHECK(parse(" \t3") == 3.0f);
+		CHECK(parse(".5") == 0.5f);
+		CHECK(parse("1e3") == 1000.0f);
+		CHECK(parse("2.5E-2") == 0.025f);
+		CHECK(parse("1.42379") == 1.42379f);
+		CHECK(parse("0.20715") == 0.20715f);
+		CHECK(parse("-105") == -105.0f);
+		CHECK(parse("3.4028234e38") == 3.4028234e38f);
+		// more than 19 significant digits only shift the exponent
+		CHECK(parse("12345678901234567890123") == 12345678901234567890123.0f);
+		CHECK(parse("0.000000000000000000000000000001") == 1e-30f);
+		// no number at all
+		CHECK(parse("") == 0.0f);
+		CHECK(parse("abc") == 0.0f);
+		CHECK(parse("-") == 0.0f);
+
+		// the end pointer limits the number, the text doesn't have to be zero terminated
+		const char text[] = "12345";
+		CHECK(AttachmentParser::parseFloat(text, text + 2) == 12.0f);
+	}
+
+	void testBox()
+	{
+		const char* xml = 
+			"<Attachment type=\"GameEngine\" name=\"DominoStein_1\" >\n"
+			"  <BulletPhysics x=\"0.20715\" y=\"1.42379\" z=\"1.02134\" mass=\"2\" shape=\"Box\" />\n"
+			"</Attachment>";
+		CollisionShape shape;
+		CHECK(AttachmentParser::parse(xml, shape));
+		CHECK(shape.type == CollisionShape::Box);
+		CHECK(shape.extents[0] == 0.20715f && shape.extents[1] == 1.42379f && shape.extents[2] == 1.02134f);
+		CHECK(shape.mass == 2.0f);
+		CHECK(!shape.kinematic && !shape.compound && !shape.trigger);
+		CHECK(shape.friction == 0.5f && shape.restitution == 0.0f);
+	}
+
+	void testShapes()
+	{
+		CollisionShape sphere;
+		CHECK(AttachmentParser::parse("<?xml version=\"1.0\"?><!-- comment --><Attachment type='gameengine'>"
+			"<BulletPhysics shape='sphere' radius='0.5' kinematic='TRUE' friction='0.8' restitution='0.3' trigger='1' /></Attachment>", sphere));
+		CHECK(sphere.type == CollisionShape::Sphere);
+		CHECK(sphere.radius == 0.5f);
+		CHECK(sphere.kinematic && sphere.trigger);
+		CHECK(sphere.friction == 0.8f && sphere.restitution == 0.3f);
+
+		CollisionShape mesh;
+		CHECK(AttachmentParser::parse("<Attachment type=\"GameEngine\"><BulletPhysics mass=\"0\" compound=\"true\"></BulletPhysics></Attachment>", mesh));
+		CHECK(mesh.type == CollisionShape::Mesh);
+		CHECK(mesh.compound);
+
+		CollisionShape ragdoll;
+		CHECK(AttachmentParser::parse("<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Ragdoll\" radius=\"0.1\" mass=\"70\" "
+			"limit=\"45\" motor=\"0.2\" /></Attachment>", ragdoll));
+		CHECK(ragdoll.type == CollisionShape::Ragdoll);
+		CHECK(ragdoll.radius == 0.1f && ragdoll.mass == 70.0f && ragdoll.jointLimit == 45.0f && ragdoll.jointMotor == 0.2f);
+	}
+
+	void testInvalid()
+	{
+		CollisionShape shape;
+		CHECK(!AttachmentParser::parse(0, shape));
+		CHECK(!AttachmentParser::parse("", shape));
+		// other attachment types and attachments without physics
+		CHECK(!AttachmentParser::parse("<Attachment type=\"Sound\"><BulletPhysics shape=\"Box\" /></Attachment>", shape));
+		CHECK(!AttachmentParser::parse("<Attachment type=\"GameEngine\"><Sound file=\"a.wav\" /></Attachment>", shape));
+		CHECK(!AttachmentParser::parse("<Attachment type=\"GameEngine\" />", shape));
+		// malformed text
+		CHECK(!AttachmentParser::parse("<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Box />", shape));
+		CHECK(!AttachmentParser::parse("<Attachment type=\"GameEngine\"><BulletPhysics shape=Box /></Attachment>", shape));
+		CHECK(!AttachmentParser::parse("<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Box\" >", shape));
+	}
+
+	void testSkippedElements()
+	{
+		// unknown elements with content are skipped, also if they contain elements named like the physics elements
+		const char* xml = "<Attachment type=\"GameEngine\"><Script><BulletPhysics shape=\"Sphere\" /><![CDATA[ <a> ]]></Script>"
+			"<BulletPhysics shape=\"Box\" x=\"1\" y=\"2\" z=\"3\" /></Attachment>";
+		CollisionShape shape;
+		CHECK(AttachmentParser::parse(xml, shape));
+		CHECK(shape.type == CollisionShape::Box);
+		CHECK(shape.extents[2] == 3.0f);
+	}
+
+	void testNameCase()
+	{
+		// XMLNode matched element and attribute names case insensitive, attachments written for it have to keep working
+		const char* xml = "<attachment Type=\"GameEngine\"><script><bulletphysics /></SCRIPT>"
+			"<bulletPhysics Shape=\"box\" X=\"1\" Y=\"2\" Z=\"3\" MASS=\"4\" /><constraint TYPE=\"hinge\" Target=\"Frame\" />"
+			"<VEHICLE Stiffness=\"20\"><wheel Node=\"Left\" Radius=\"0.4\" /></vehicle></ATTACHMENT>";
+		CollisionShape shape;
+		ConstraintDefinition constraint;
+		int numConstraints = 0;
+		VehicleDefinition vehicle;
+		CHECK(AttachmentParser::parse(xml, shape, &constraint, 1, &numConstraints, &vehicle));
+		CHECK(shape.type == CollisionShape::Box);
+		CHECK(shape.extents[0] == 1.0f && shape.extents[1] == 2.0f && shape.extents[2] == 3.0f && shape.mass == 4.0f);
+		CHECK(numConstraints == 1 && constraint.type == ConstraintDefinition::Hinge);
+		CHECK(strcmp(constraint.target, "Frame") == 0);
+		CHECK(vehicle.numWheels == 1 && vehicle.stiffness == 20.0f);
+		CHECK(strcmp(vehicle.wheels[0].node, "Left") == 0 && vehicle.wheels[0].radius == 0.4f);
+	}
+
+	void testConstraints()
+	{
+		const char* xml = "<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Box\" x=\"1\" y=\"1\" z=\"1\" mass=\"1\" />"
+			"<Constraint type=\"Hinge\" target=\"DoorFrame\" x=\"0.5\" axisX=\"0\" axisY=\"1\" low=\"0\" high=\"90\" breaking=\"100\" collide=\"true\" />"
+			"<Constraint type=\"Spring\" y=\"-1\" stiffness=\"20\" damping=\"0.5\" />"
+			"<Constraint type=\"Point\" /></Attachment>";
+		CollisionShape shape;
+		ConstraintDefinition constraints[2];
+		int numConstraints = -1;
+		CHECK(AttachmentParser::parse(xml, shape, constraints, 2, &numConstraints));
+		// the third constraint doesn't fit into the array
+		CHECK(numConstraints == 2);
+		CHECK(constraints[0].type == ConstraintDefinition::Hinge);
+		CHECK(strcmp(constraints[0].target, "DoorFrame") == 0);
+		CHECK(constraints[0].pivot[0] == 0.5f && constraints[0].pivot[1] == 0.0f);
+		CHECK(constraints[0].axis[0] == 0.0f && constraints[0].axis[1] == 1.0f && constraints[0].axis[2] == 0.0f);
+		CHECK(constraints[0].low == 0.0f && constraints[0].high == 90.0f);
+		CHECK(constraints[0].breakingImpulse == 100.0f && constraints[0].collide);
+		CHECK(constraints[1].type == ConstraintDefinition::Spring);
+		CHECK(constraints[1].target[0] == 0);
+		CHECK(constraints[1].pivot[1] == -1.0f);
+		CHECK(constraints[1].stiffness == 20.0f && constraints[1].damping == 0.5f);
+		// defaults of attributes that are not given
+		CHECK(constraints[1].low > constraints[1].high && !constraints[1].collide);
+
+		// unknown types and names that don't fit fail the whole attachment
+		char tooLong[ConstraintDefinition::MaxNameLength + 128];
+		sprintf(tooLong, "<Attachment type=\"GameEngine\"><BulletPhysics /><Constraint target=\"%0*d\" /></Attachment>", 
+			(int) ConstraintDefinition::MaxNameLength, 0);
+		CHECK(!AttachmentParser::parse(tooLong, shape, constraints, 2, &numConstraints));
+		CHECK(!AttachmentParser::parse("<Attachment type=\"GameEngine\"><BulletPhysics /><Constraint type=\"Rope\" /></Attachment>", 
+			shape, constraints, 2, &numConstraints));
+		CHECK(numConstraints == 0);
+	}
+
+	void testVehicle()
+	{
+		const char* xml = "<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Box\" x=\"1\" y=\"0.5\" z=\"2\" mass=\"800\" />"
+			"<Vehicle stiffness=\"20\" travel=\"300\" rollInfluence=\"0\">"
+			"<Wheel node=\"FrontLeft\" radius=\"0.4\" suspension=\"0.6\" front=\"true\" />"
+			"<!-- rear --><Wheel node=\"RearLeft\"></Wheel><Light /></Vehicle></Attachment>";
+		CollisionShape shape;
+		VehicleDefinition vehicle;
+		CHECK(AttachmentParser::parse(xml, shape, 0, 0, 0, &vehicle));
+		CHECK(vehicle.numWheels == 2);
+		CHECK(vehicle.stiffness == 20.0f && vehicle.maxTravel == 300.0f && vehicle.rollInfluence == 0.0f);
+		// defaults of btVehicleTuning
+		CHECK(vehicle.compression == 0.83f && vehicle.damping == 0.88f);
+		CHECK(strcmp(vehicle.wheels[0].node, "FrontLeft") == 0);
+		CHECK(vehicle.wheels[0].radius == 0.4f && vehicle.wheels[0].suspension == 0.6f && vehicle.wheels[0].front);
+		CHECK(strcmp(vehicle.wheels[1].node, "RearLeft") == 0);
+		CHECK(vehicle.wheels[1].radius == 0.5f && !vehicle.wheels[1].front);
+
+		// a vehicle without a BulletPhysics element is dropped with the attachment
+		CHECK(!AttachmentParser::parse("<Attachment type=\"GameEngine\"><Vehicle><Wheel node=\"A\" /></Vehicle></Attachment>", 
+			shape, 0, 0, 0, &vehicle));
+		CHECK(vehicle.numWheels == 0);
+	}
+
+	void testLayers()
+	{
+		const short debris = CollisionLayers::find("Debris", "Debris" + 6);
+		const short character = CollisionLayers::find("Character", "Character" + 9);
+		CHECK(debris != 0 && character != 0 && debris != character);
+		CHECK(CollisionLayers::find("Unknown", "Unknown" + 7) == 0);
+
+		const short doors = CollisionLayers::define("Doors");
+		CHECK(doors != 0);
+		CHECK(CollisionLayers::define("Doors") == doors);
+		CHECK(CollisionLayers::find("Doors", "Doors" + 5) == doors);
+
+		CollisionShape shape;
+		CHECK(AttachmentParser::parse("<Attachment type=\"GameEngine\"><BulletPhysics group=\"Debris\" mask=\"!Debris | !Doors\" /></Attachment>", shape));
+		CHECK(shape.group == debris);
+		CHECK(shape.mask == (short) ~(debris | doors));
+		CHECK(AttachmentParser::parse("<Attachment type=\"GameEngine\"><BulletPhysics group=\"Doors|Character\" mask=\"All\" /></Attachment>", shape));
+		CHECK(shape.group == (doors | character));
+		CHECK(shape.mask == -1);
+	}
+}
+
+int main()
+{
+	testParseFloat();
+	testBox();
+	testShapes();
+	testInvalid();
+	testSkippedElements();
+	testNameCase();
+	testConstraints();
+	testVehicle();
+	testLayers();
+	return Testing::result("attachmentTest");
+}
@@ -0,0 +1,325 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egPhysicsBlob.h"
+#include "horde3DStub.h"
+#include "testing.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	const char* blobFile = "blobTest.physics";
+
+	const char* boxAttachment = "<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Box\" x=\"0.2\" y=\"1.4\" z=\"1\" mass=\"2\" /></Attachment>";
+	const char* sphereAttachment = "<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Sphere\" radius=\"0.5\" mass=\"1\" friction=\"0.8\" />"
+		"<Constraint type=\"Hinge\" target=\"Box\" y=\"1\" axisZ=\"1\" low=\"-45\" high=\"45\" /></Attachment>";
+	const char* carAttachment = "<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Box\" x=\"1\" y=\"0.5\" z=\"2\" mass=\"800\" kinematic=\"true\" />"
+		"<Vehicle stiffness=\"20\"><Wheel node=\"Wheel\" radius=\"0.4\" front=\"1\" /></Vehicle></Attachment>";
+
+	/// Nodes of the test scene that carry attachments, in traversal order
+	struct Scene
+	{
+		int	root, box, sphere, car, wheel;
+	};
+
+	/// Builds a branch with three attachments below the given parent
+	Scene buildScene(int parent)
+	{
+		Scene scene;
+		scene.root = SceneStub::addNode(parent, "Level", H3DNodeTypes::Group);
+		scene.box = SceneStub::addNode(scene.root, "Box", H3DNodeTypes::Mesh, boxAttachment);
+		const int props = SceneStub::addNode(scene.root, "Props", H3DNodeTypes::Group);
+		scene.sphere = SceneStub::addNode(props, "Sphere", H3DNodeTypes::Mesh, sphereAttachment);
+		scene.car = SceneStub::addNode(scene.root, "Car", H3DNodeTypes::Model, carAttachment);
+		scene.wheel = SceneStub::addNode(scene.car, "Wheel", H3DNodeTypes::Mesh);
+		return scene;
+	}
+
+	bool readFile(const char* fileName, vector<char>& content)
+	{
+		content.clear();
+		FILE* file = fopen(fileName, "rb");
+		if (!file)
+			return false;
+		char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			content.insert(content.end(), buffer, buffer + read);
+		fclose(file);
+		return true;
+	}
+
+	void writeFile(const char* fileName, const vector<char>& content)
+	{
+		FILE* file = fopen(fileName, "wb");
+		if (content.size())
+			fwrite(&content[0], 1, content.size(), file);
+		fclose(file);
+	}
+
+	/// Overwrites an unsigned int of the file at the given offset and checks that the blob is rejected
+	void checkRejected(const vector<char>& original, size_t offset, unsigned int value)
+	{
+		vector<char> modified(original);
+		memcpy(&modified[offset], &value, sizeof(value));
+		writeFile(blobFile, modified);
+		PhysicsBlob blob;
+		CHECK(!blob.open(blobFile));
+		CHECK(blob.numDescriptors() == 0);
+	}
+
+	/// Fills a name buffer of the file without a terminator and checks that the blob is rejected
+	void checkUnterminated(const vector<char>& original, size_t offset, size_t size)
+	{
+		vector<char> modified(original);
+		memset(&modified[offset], 'x', size);
+		writeFile(blobFile, modified);
+		PhysicsBlob blob;
+		CHECK(!blob.open(blobFile));
+		CHECK(blob.numDescriptors() == 0);
+	}
+
+	void testRoundTrip()
+	{
+		SceneStub::clear();
+		const Scene scene = buildScene(H3DRootNode);
+		CHECK(PhysicsBlob::bake(scene.root, blobFile));
+
+		PhysicsBlob blob;
+		CHECK(blob.open(blobFile));
+		CHECK(blob.numDescriptors() == 3);
+		if (blob.numDescriptors() != 3)
+			return;
+		const PhysicsDescriptor* descriptors = blob.descriptors();
+		CHECK(strcmp(descriptors[0].path, "Box") == 0);
+		CHECK(strcmp(descriptors[1].path, "Props/Sphere") == 0);
+		CHECK(strcmp(descriptors[2].path, "Car") == 0);
+
+		CollisionShape box;
+		PhysicsBlob::toCollisionShape(descriptors[0], box);
+		CHECK(box.type == CollisionShape::Box);
+		CHECK(box.extents[0] == 0.2f && box.extents[1] == 1.4f && box.extents[2] == 1.0f);
+		CHECK(box.mass == 2.0f && !box.kinematic);
+		CollisionShape sphere;
+		PhysicsBlob::toCollisionShape(descriptors[1], sphere);
+		CHECK(sphere.type == CollisionShape::Sphere);
+		CHECK(sphere.radius == 0.5f && sphere.friction == 0.8f);
+		CollisionShape car;
+		PhysicsBlob::toCollisionShape(descriptors[2], car);
+		CHECK(car.kinematic && car.mass == 800.0f);
+
+		CHECK(blob.numConstraints() == 1);
+		CHECK(blob.constraints()[0].descriptor == 1);
+		CHECK(blob.constraints()[0].definition.type == ConstraintDefinition::Hinge);
+		CHECK(strcmp(blob.constraints()[0].definition.target, "Box") == 0);
+		CHECK(blob.constraints()[0].definition.low == -45.0f && blob.constraints()[0].definition.high == 45.0f);
+		CHECK(blob.numVehicles() == 1);
+		CHECK(blob.vehicles()[0].descriptor == 2);
+		CHECK(blob.vehicles()[0].definition.numWheels == 1);
+		CHECK(strcmp(blob.vehicles()[0].definition.wheels[0].node, "Wheel") == 0);
+		CHECK(blob.vehicles()[0].definition.wheels[0].front);
+
+		int hordeIDs[3];
+		CHECK(blob.resolveNodes(scene.root, hordeIDs) == 3);
+		CHECK(hordeIDs[0] == scene.box && hordeIDs[1] == scene.sphere && hordeIDs[2] == scene.car);
+		CHECK(blob.isCurrent(scene.root));
+
+		// another instance of the same branch resolves to its own nodes
+		const Scene copy = buildScene(H3DRootNode);
+		CHECK(blob.resolveNodes(copy.root, hordeIDs) == 3);
+		CHECK(hordeIDs[0] == copy.box && hordeIDs[1] == copy.sphere && hordeIDs[2] == copy.car);
+		CHECK(blob.isCurrent(copy.root));
+
+		// a branch missing a node stops at the first descriptor that isn't found
+		SceneStub::setName(copy.sphere, "Ball");
+		CHECK(blob.resolveNodes(copy.root, hordeIDs) == 1);
+		blob.close();
+		CHECK(blob.numDescriptors() == 0);
+	}
+
+	void testStaleBlob()
+	{
+		SceneStub::clear();
+		const Scene scene = buildScene(H3DRootNode);
+		CHECK(PhysicsBlob::bake(scene.root, blobFile));
+		PhysicsBlob blob;
+		CHECK(blob.open(blobFile));
+
+		// nodes without attachments don't matter
+		SceneStub::addNode(scene.root, "Decoration", H3DNodeTypes::Mesh);
+		CHECK(blob.isCurrent(scene.root));
+
+		SceneStub::setAttachment(scene.box, "<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Box\" x=\"0.2\" y=\"1.4\" z=\"1\" mass=\"3\" /></Attachment>");
+		CHECK(!blob.isCurrent(scene.root));
+		SceneStub::setAttachment(scene.box, boxAttachment);
+		CHECK(blob.isCurrent(scene.root));
+
+		const int added = SceneStub::addNode(scene.root, "Crate", H3DNodeTypes::Mesh, boxAttachment);
+		CHECK(!blob.isCurrent(scene.root));
+		SceneStub::setAttachment(added, "");
+		CHECK(blob.isCurrent(scene.root));
+
+		SceneStub::setAttachment(scene.sphere, "");
+		CHECK(!blob.isCurrent(scene.root));
+		SceneStub::setAttachment(scene.sphere, sphereAttachment);
+
+		// renaming a node with an attachment changes its path
+		SceneStub::setName(scene.box, "Crate");
+		CHECK(!blob.isCurrent(scene.root));
+	}
+
+	void testValidation()
+	{
+		const char* invalid[] = {
+			"<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Box\" x=\"1\" y=\"1\" z=\"1\" mass=\"-1\" /></Attachment>",
+			"<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Box\" x=\"1\" y=\"0\" z=\"1\" /></Attachment>",
+			"<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Sphere\" radius=\"1\" restitution=\"2\" /></Attachment>",
+			"<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Sphere\" radius=\"0\" /></Attachment>",
+			"<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Sphere\" radius=\"1\" compound=\"true\" trigger=\"true\" /></Attachment>",
+			"<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Ragdoll\" radius=\"0.1\" mass=\"1\" /></Attachment>",
+			"<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Sphere\" radius=\"1\" />"
+				"<Constraint type=\"Hinge\" axisY=\"0\" /></Attachment>",
+			"<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Sphere\" radius=\"1\" />"
+				"<Constraint type=\"Hinge\" low=\"-270\" high=\"90\" /></Attachment>",
+			"<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Sphere\" radius=\"1\" />"
+				"<Vehicle><Wheel node=\"Wheel\" radius=\"0\" /></Vehicle></Attachment>",
+			"<Attachment type=\"GameEngine\"><BulletPhysics shape=\"Sphere\" radius=\"1\" />"
+				"<Vehicle><Wheel radius=\"1\" /></Vehicle></Attachment>"
+		};
+		for (unsigned int i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+		{
+			SceneStub::clear();
+			const int root = SceneStub::addNode(H3DRootNode, "Level", H3DNodeTypes::Group);
+			SceneStub::addNode(root, "Valid", H3DNodeTypes::Mesh, boxAttachment);
+			SceneStub::addNode(root, "Invalid", H3DNodeTypes::Mesh, invalid[i]);
+			remove(blobFile);
+			CHECK(!PhysicsBlob::bake(root, blobFile));
+			FILE* file = fopen(blobFile, "rb");
+			CHECK(file == 0);
+			if (file)
+			{
+				printf("attachment %u has been baked\n", i);
+				fclose(file);
+			}
+		}
+
+		// mesh shapes need geometry, compound shapes a model
+		SceneStub::clear();
+		int root = SceneStub::addNode(H3DRootNode, "Level", H3DNodeTypes::Group, "<Attachment type=\"GameEngine\"><BulletPhysics /></Attachment>");
+		CHECK(!PhysicsBlob::bake(root, blobFile));
+		SceneStub::clear();
+		root = SceneStub::addNode(H3DRootNode, "Level", H3DNodeTypes::Mesh, "<Attachment type=\"GameEngine\"><BulletPhysics compound=\"1\" /></Attachment>");
+		CHECK(!PhysicsBlob::bake(root, blobFile));
+		SceneStub::clear();
+		root = SceneStub::addNode(H3DRootNode, "Level", H3DNodeTypes::Model, "<Attachment type=\"GameEngine\"><BulletPhysics compound=\"1\" /></Attachment>");
+		CHECK(PhysicsBlob::bake(root, blobFile));
+
+		// paths that don't fit into a descriptor
+		SceneStub::clear();
+		root = SceneStub::addNode(H3DRootNode, "Level", H3DNodeTypes::Group);
+		const string longName(PhysicsDescriptor::MaxPathLength, 'n');
+		SceneStub::addNode(root, longName.c_str(), H3DNodeTypes::Mesh, boxAttachment);
+		CHECK(!PhysicsBlob::bake(root, blobFile));
+	}
+
+	void testVersioning()
+	{
+		SceneStub::clear();
+		const Scene scene = buildScene(H3DRootNode);
+		CHECK(PhysicsBlob::bake(scene.root, blobFile));
+		vector<char> original;
+		CHECK(readFile(blobFile, original));
+		CHECK(original.size() == sizeof(PhysicsBlobHeader) + 3 * sizeof(PhysicsDescriptor) + sizeof(ConstraintDescriptor) + sizeof(VehicleDescriptor));
+		if (original.size() < sizeof(PhysicsBlobHeader))
+			return;
+
+		PhysicsBlobHeader header;
+		memcpy(&header, &original[0], sizeof(header));
+		CHECK(memcmp(header.magic, "H3PB", 4) == 0);
+		CHECK(header.version == PhysicsBlob::Version);
+
+		checkRejected(original, offsetof(PhysicsBlobHeader, magic), 0x42503349);
+		checkRejected(original, offsetof(PhysicsBlobHeader, version), PhysicsBlob::Version - 1);
+		checkRejected(original, offsetof(PhysicsBlobHeader, version), PhysicsBlob::Version + 1);
+		checkRejected(original, offsetof(PhysicsBlobHeader, descriptorSize), sizeof(PhysicsDescriptor) + 4);
+		checkRejected(original, offsetof(PhysicsBlobHeader, constraintSize), sizeof(ConstraintDescriptor) - 4);
+		checkRejected(original, offsetof(PhysicsBlobHeader, vehicleSize), sizeof(VehicleDescriptor) + 4);
+		checkRejected(original, offsetof(PhysicsBlobHeader, numDescriptors), 4);
+		checkRejected(original, offsetof(PhysicsBlobHeader, numConstraints), 2);
+		checkRejected(original, offsetof(PhysicsBlobHeader, numVehicles), 0x40000000);
+		// constraints and vehicles referencing a descriptor that doesn't exist
+		checkRejected(original, sizeof(PhysicsBlobHeader) + 3 * sizeof(PhysicsDescriptor) + offsetof(ConstraintDescriptor, descriptor), 3);
+		checkRejected(original, original.size() - sizeof(VehicleDescriptor) + offsetof(VehicleDescriptor, descriptor), 7);
+		checkRejected(original, original.size() - sizeof(VehicleDescriptor) + offsetof(VehicleDescriptor, definition) + 
+			offsetof(VehicleDefinition, numWheels), VehicleDefinition::MaxWheels + 1);
+		checkRejected(original, original.size() - sizeof(VehicleDescriptor) + offsetof(VehicleDescriptor, definition) + 
+			offsetof(VehicleDefinition, numWheels), (unsigned int) -1);
+		// enum values out of range and names running past their buffers
+		const size_t constraint = sizeof(PhysicsBlobHeader) + 3 * sizeof(PhysicsDescriptor) + offsetof(ConstraintDescriptor, definition);
+		const size_t wheel = original.size() - sizeof(VehicleDescriptor) + offsetof(VehicleDescriptor, definition) + 
+			offsetof(VehicleDefinition, wheels);
+		checkRejected(original, sizeof(PhysicsBlobHeader) + offsetof(PhysicsDescriptor, type), CollisionShape::Ragdoll + 1);
+		checkRejected(original, sizeof(PhysicsBlobHeader) + 2 * sizeof(PhysicsDescriptor) + offsetof(PhysicsDescriptor, type), 0x80000000);
+		checkRejected(original, constraint + offsetof(ConstraintDefinition, type), ConstraintDefinition::Spring + 1);
+		checkUnterminated(original, sizeof(PhysicsBlobHeader) + offsetof(PhysicsDescriptor, path), PhysicsDescriptor::MaxPathLength);
+		checkUnterminated(original, sizeof(PhysicsBlobHeader) + 2 * sizeof(PhysicsDescriptor) + offsetof(PhysicsDescriptor, path), 
+			PhysicsDescriptor::MaxPathLength);
+		checkUnterminated(original, constraint + offsetof(ConstraintDefinition, target), ConstraintDefinition::MaxNameLength);
+		checkUnterminated(original, wheel + offsetof(WheelDefinition, node), ConstraintDefinition::MaxNameLength);
+
+		// truncated files
+		vector<char> truncated(original.begin(), original.end() - 1);
+		writeFile(blobFile, truncated);
+		PhysicsBlob blob;
+		CHECK(!blob.open(blobFile));
+		truncated.resize(sizeof(PhysicsBlobHeader) - 1);
+		writeFile(blobFile, truncated);
+		CHECK(!blob.open(blobFile));
+		remove(blobFile);
+		CHECK(!blob.open(blobFile));
+
+		// the unmodified file is still accepted
+		writeFile(blobFile, original);
+		CHECK(blob.open(blobFile));
+		CHECK(blob.numDescriptors() == 3 && blob.numConstraints() == 1 && blob.numVehicles() == 1);
+	}
+}
+
+int main()
+{
+	testRoundTrip();
+	testStaleBlob();
+	testValidation();
+	testVersioning();
+	remove(blobFile);
+	return Testing::result("blobTest");
+}
@@ -0,0 +1,136 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egCommandQueue.h"
+#include "testing.h"
+
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	void testFifo()
+	{
+		CommandQueue queue;
+		CHECK(queue.pop() == 0);
+
+		// the queue runs empty and is refilled several times, which moves the stub around
+		for (int round = 0; round < 3; ++round)
+		{
+			for (int i = 0; i < 5; ++i)
+			{
+				PhysicsCommand* command = new PhysicsCommand(PhysicsCommand::ApplyImpulse, round * 10 + i);
+				command->values[0] = (float) i;
+				queue.push(command);
+			}
+			for (int i = 0; i < 5; ++i)
+			{
+				PhysicsCommand* command = queue.pop();
+				CHECK(command != 0);
+				if (!command)
+					break;
+				CHECK(command->type == PhysicsCommand::ApplyImpulse);
+				CHECK(command->hordeID == round * 10 + i);
+				CHECK(command->values[0] == (float) i);
+				delete command;
+			}
+			CHECK(queue.pop() == 0);
+		}
+
+		// single commands alternating with pops
+		for (int i = 0; i < 10; ++i)
+		{
+			PhysicsCommand* command = new PhysicsCommand(PhysicsCommand::CreateNode, i);
+			command->xmlText = "<Attachment />";
+			queue.push(command);
+			PhysicsCommand* popped = queue.pop();
+			CHECK(popped == command);
+			CHECK(popped && popped->xmlText == "<Attachment />");
+			delete popped;
+			CHECK(queue.pop() == 0);
+		}
+	}
+
+	void testRemainingCommands()
+	{
+		// the destructor deletes the commands that have not been popped
+		CommandQueue queue;
+		for (int i = 0; i < 3; ++i)
+			queue.push(new PhysicsCommand(PhysicsCommand::RemoveNode, i));
+		delete queue.pop();
+	}
+
+	void testProducers()
+	{
+		const int numProducers = 4, numCommands = 20000;
+		CommandQueue queue;
+		vector<thread> producers;
+		for (int p = 0; p < numProducers; ++p)
+		{
+			producers.push_back(thread([&queue, p]()
+			{
+				for (int i = 0; i < numCommands; ++i)
+				{
+					PhysicsCommand* command = new PhysicsCommand(PhysicsCommand::Teleport, p);
+					command->values[0] = (float) i;
+					queue.push(command);
+				}
+			}));
+		}
+
+		// commands of each producer arrive in the order they have been pushed
+		vector<int> next(numProducers, 0);
+		int received = 0, errors = 0;
+		while (received < numProducers * numCommands)
+		{
+			PhysicsCommand* command = queue.pop();
+			if (!command)
+			{
+				this_thread::yield();
+				continue;
+			}
+			if (command->hordeID < 0 || command->hordeID >= numProducers || command->values[0] != (float) next[command->hordeID]++)
+				++errors;
+			++received;
+			delete command;
+		}
+		for (int p = 0; p < numProducers; ++p)
+			producers[p].join();
+		CHECK(errors == 0);
+		CHECK(queue.pop() == 0);
+		for (int p = 0; p < numProducers; ++p)
+			CHECK(next[p] == numCommands);
+	}
+}
+
+int main()
+{
+	testFifo();
+	testRemainingCommands();
+	testProducers();
+	return Testing::result("commandQueueTest");
+}
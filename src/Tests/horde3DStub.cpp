@@ -0,0 +1,111 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "horde3DStub.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	struct Node
+	{
+		string		name;
+		int			type;
+		string		attachment;
+		vector<int>	children;
+	};
+
+	/// Nodes indexed by their handle, handle 0 is invalid
+	vector<Node>& nodes()
+	{
+		static vector<Node> list;
+		if (list.empty())
+		{
+			list.resize(2);
+			list[H3DRootNode].name = "RootNode";
+			list[H3DRootNode].type = H3DNodeTypes::Group;
+		}
+		return list;
+	}
+
+	bool valid(int node)
+	{
+		return node > 0 && node < (int) nodes().size();
+	}
+}
+
+void SceneStub::clear()
+{
+	nodes().resize(H3DRootNode + 1);
+	nodes()[H3DRootNode].children.clear();
+}
+
+int SceneStub::addNode(int parent, const char* name, int type, const char* attachment)
+{
+	Node node;
+	node.name = name;
+	node.type = type;
+	node.attachment = attachment;
+	nodes().push_back(node);
+	const int handle = (int) nodes().size() - 1;
+	nodes()[parent].children.push_back(handle);
+	return handle;
+}
+
+void SceneStub::setName(int node, const char* name)
+{
+	nodes()[node].name = name;
+}
+
+void SceneStub::setAttachment(int node, const char* attachment)
+{
+	nodes()[node].attachment = attachment;
+}
+
+int h3dGetNodeType(H3DNode node)
+{
+	return valid(node) ? nodes()[node].type : H3DNodeTypes::Undefined;
+}
+
+H3DNode h3dGetNodeChild(H3DNode node, int index)
+{
+	if (!valid(node) || index < 0 || index >= (int) nodes()[node].children.size())
+		return 0;
+	return nodes()[node].children[index];
+}
+
+const char* h3dGetNodeParamStr(H3DNode node, int param)
+{
+	if (!valid(node))
+		return "";
+	if (param == H3DNodeParams::NameStr)
+		return nodes()[node].name.c_str();
+	if (param == H3DNodeParams::AttachmentStr)
+		return nodes()[node].attachment.c_str();
+	return "";
+}
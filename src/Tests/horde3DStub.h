@@ -0,0 +1,56 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <Horde3D/Horde3D.h>
+
+/**
+ * \brief Scene graph standing in for Horde3D in the tests
+ *
+ * Implements the node functions of the Horde3D API used by the tested sources on a plain node list, so
+ * scenes can be built without a render device. clear() leaves only the root node H3DRootNode.
+ */
+namespace SceneStub
+{
+	/// Removes all nodes but the root node
+	void clear();
+
+	/**
+	 * Adds a node
+	 * @param parent the parent node
+	 * @param name the name of the node
+	 * @param type the H3DNodeTypes of the node
+	 * @param attachment the attachment string
+	 * @return the handle of the new node
+	 */
+	int addNode(int parent, const char* name, int type, const char* attachment = "");
+
+	/// Replaces the name of a node
+	void setName(int node, const char* name);
+
+	/// Replaces the attachment string of a node
+	void setAttachment(int node, const char* attachment);
+}
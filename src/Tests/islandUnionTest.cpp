@@ -0,0 +1,139 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egIslandUnion.h"
+#include "testing.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	/// Island touching a body
+	typedef pair<int, int> Contact;
+
+	/// Groups of the islands computed by a flood fill over the shared bodies
+	vector<int> expectedGroups(int numIslands, const vector<Contact>& contacts)
+	{
+		vector<int> groups(numIslands);
+		for (int i = 0; i < numIslands; ++i)
+			groups[i] = i;
+		// merge until nothing changes, every group takes the smallest island index
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+			for (unsigned int a = 0; a < contacts.size(); ++a)
+			{
+				for (unsigned int b = 0; b < contacts.size(); ++b)
+				{
+					if (contacts[a].second != contacts[b].second)
+						continue;
+					const int group = min(groups[contacts[a].first], groups[contacts[b].first]);
+					for (int i = 0; i < numIslands; ++i)
+					{
+						if ((groups[i] == groups[contacts[a].first] || groups[i] == groups[contacts[b].first]) && groups[i] != group)
+						{
+							groups[i] = group;
+							changed = true;
+						}
+					}
+				}
+			}
+		}
+		return groups;
+	}
+
+	vector<int> unionGroups(int numIslands, const vector<Contact>& contacts, const vector<int>& bodies)
+	{
+		IslandUnion islandUnion;
+		islandUnion.reset(numIslands);
+		for (unsigned int i = 0; i < contacts.size(); ++i)
+			islandUnion.share(contacts[i].first, &bodies[contacts[i].second]);
+		vector<int> groups(numIslands);
+		for (int i = 0; i < numIslands; ++i)
+			groups[i] = islandUnion.find(i);
+		return groups;
+	}
+
+	void testSimple()
+	{
+		IslandUnion islandUnion;
+		int bodies[2];
+		islandUnion.reset(5);
+		for (int i = 0; i < 5; ++i)
+			CHECK(islandUnion.find(i) == i);
+
+		// islands 4 and 1 share a body, 3 and 4 another one
+		islandUnion.share(4, &bodies[0]);
+		islandUnion.share(3, &bodies[1]);
+		islandUnion.share(1, &bodies[0]);
+		islandUnion.share(4, &bodies[1]);
+		CHECK(islandUnion.find(0) == 0);
+		CHECK(islandUnion.find(1) == 1);
+		CHECK(islandUnion.find(2) == 2);
+		CHECK(islandUnion.find(3) == 1);
+		CHECK(islandUnion.find(4) == 1);
+
+		// reset forgets the islands and the bodies
+		islandUnion.reset(3);
+		islandUnion.share(2, &bodies[0]);
+		CHECK(islandUnion.find(1) == 1);
+		CHECK(islandUnion.find(2) == 2);
+	}
+
+	void testOrderIndependence()
+	{
+		mt19937 random(1);
+		for (int run = 0; run < 200; ++run)
+		{
+			const int numIslands = 1 + random() % 40;
+			const int numBodies = 1 + random() % 20;
+			vector<int> bodies(numBodies);
+			vector<Contact> contacts;
+			const int numContacts = random() % 60;
+			for (int i = 0; i < numContacts; ++i)
+				contacts.push_back(Contact(random() % numIslands, random() % numBodies));
+
+			const vector<int> expected = expectedGroups(numIslands, contacts);
+			// the worker that collects the contacts of an island may report them in any order
+			for (int order = 0; order < 5; ++order)
+			{
+				shuffle(contacts.begin(), contacts.end(), random);
+				CHECK(unionGroups(numIslands, contacts, bodies) == expected);
+			}
+		}
+	}
+}
+
+int main()
+{
+	testSimple();
+	testOrderIndependence();
+	return Testing::result("islandUnionTest");
+}
@@ -0,0 +1,118 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egPendingManifold.h"
+#include "testing.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	/// Stands in for the manifolds, which are only compared by address
+	char manifolds[4096];
+
+	btPersistentManifold* manifold(int index)
+	{
+		return reinterpret_cast<btPersistentManifold*>(&manifolds[index]);
+	}
+
+	void testOrder()
+	{
+		vector<PendingManifold> a, b;
+		const PendingManifold changes[] = { { 3, 0, manifold(0) }, { 1, 1, manifold(1) }, { 3, 1, manifold(2) }, { 1, 0, manifold(3) } };
+		a.push_back(changes[0]);
+		a.push_back(changes[2]);
+		b.push_back(changes[1]);
+		b.push_back(changes[3]);
+		vector<vector<PendingManifold>*> lists;
+		lists.push_back(&a);
+		lists.push_back(&b);
+		vector<PendingManifold> merged(5);
+		mergePendingManifolds(lists, merged);
+		CHECK(a.empty() && b.empty());
+		CHECK(merged.size() == 4);
+		if (merged.size() == 4)
+			CHECK(merged[0].manifold == manifold(3) && merged[1].manifold == manifold(1) && merged[2].manifold == manifold(0) && merged[3].manifold == manifold(2));
+	}
+
+	void testDistribution()
+	{
+		mt19937 random(7);
+		for (int run = 0; run < 100; ++run)
+		{
+			// manifold changes of the pairs as a single thread would make them
+			const int numPairs = 1 + random() % 300;
+			vector<vector<PendingManifold> > pairChanges(numPairs);
+			vector<PendingManifold> expected;
+			int next = 0;
+			for (int pair = 0; pair < numPairs; ++pair)
+			{
+				const int count = random() % 4;
+				for (int sequence = 0; sequence < count && next < (int) sizeof(manifolds); ++sequence)
+				{
+					PendingManifold change = { pair, sequence, manifold(next++) };
+					pairChanges[pair].push_back(change);
+					expected.push_back(change);
+				}
+			}
+
+			// chunks of pairs are processed by random threads in random order, like stolen tasks
+			const int numThreads = 1 + random() % 8;
+			const int grainSize = 1 + random() % 32;
+			vector<int> chunks;
+			for (int begin = 0; begin < numPairs; begin += grainSize)
+				chunks.push_back(begin);
+			shuffle(chunks.begin(), chunks.end(), random);
+			vector<vector<PendingManifold> > threadChanges(numThreads);
+			for (unsigned int i = 0; i < chunks.size(); ++i)
+			{
+				vector<PendingManifold>& changes = threadChanges[random() % numThreads];
+				for (int pair = chunks[i]; pair < min(chunks[i] + grainSize, numPairs); ++pair)
+					changes.insert(changes.end(), pairChanges[pair].begin(), pairChanges[pair].end());
+			}
+
+			vector<vector<PendingManifold>*> lists;
+			for (int i = 0; i < numThreads; ++i)
+				lists.push_back(&threadChanges[i]);
+			vector<PendingManifold> merged;
+			mergePendingManifolds(lists, merged);
+			bool equal = merged.size() == expected.size();
+			for (unsigned int i = 0; equal && i < merged.size(); ++i)
+				equal = merged[i].manifold == expected[i].manifold;
+			CHECK(equal);
+		}
+	}
+}
+
+int main()
+{
+	testOrder();
+	testDistribution();
+	return Testing::result("pendingManifoldTest");
+}
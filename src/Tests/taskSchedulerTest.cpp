@@ -0,0 +1,232 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#include "egTaskScheduler.h"
+#include "testing.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	/// Records how often each index has been processed and checks the arguments of every range
+	struct Coverage
+	{
+		TaskScheduler*			scheduler;
+		int						grainSize;
+		vector<atomic<int> >	counts;
+		/// Set while a thread index executes a range, two threads must never share an index
+		vector<atomic<int> >	busy;
+		atomic<int>				errors;
+
+		Coverage(TaskScheduler* scheduler, int count, int grainSize) : scheduler(scheduler), grainSize(grainSize), counts(count), 
+			busy(scheduler->numThreadIndices()), errors(0)
+		{
+			for (int i = 0; i < count; ++i)
+				counts[i] = 0;
+			for (int i = 0; i < scheduler->numThreadIndices(); ++i)
+				busy[i] = 0;
+		}
+
+		void operator()(int begin, int end, int threadIndex)
+		{
+			if (begin < 0 || end > (int) counts.size() || begin >= end || end - begin > grainSize || 
+				threadIndex < 0 || threadIndex >= scheduler->numThreadIndices() || threadIndex != scheduler->threadIndex())
+			{
+				++errors;
+				return;
+			}
+			if (busy[threadIndex].exchange(1) != 0)
+				++errors;
+			for (int i = begin; i < end; ++i)
+				++counts[i];
+			this_thread::yield();
+			busy[threadIndex] = 0;
+		}
+
+		/// Runs the parallelFor the coverage has been created for
+		void run(int count)
+		{
+			parallelFor(scheduler, count, grainSize, [this](int begin, int end, int threadIndex) { (*this)(begin, end, threadIndex); });
+		}
+
+		bool complete() const
+		{
+			for (unsigned int i = 0; i < counts.size(); ++i)
+			{
+				if (counts[i] != 1)
+					return false;
+			}
+			return errors == 0;
+		}
+	};
+
+	void testRanges()
+	{
+		TaskScheduler scheduler(3);
+		CHECK(scheduler.numThreads() == 3);
+		CHECK(scheduler.numThreadIndices() == 4);
+		CHECK(scheduler.threadIndex() == 3);
+
+		const int sizes[][2] = { { 0, 1 }, { 1, 1 }, { 7, 100 }, { 100, 1 }, { 1000, 7 }, { 1000, 64 }, { 4096, 1000 } };
+		for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+		{
+			Coverage coverage(&scheduler, sizes[i][0], sizes[i][1]);
+			coverage.run(sizes[i][0]);
+			CHECK(coverage.complete());
+		}
+	}
+
+	void testSerialFallback()
+	{
+		int calls = 0, covered = 0;
+		parallelFor(0, 100, 10, [&](int begin, int end, int threadIndex)
+		{
+			++calls;
+			covered += end - begin;
+			CHECK(threadIndex == 0);
+		});
+		CHECK(calls == 1 && covered == 100);
+	}
+
+	atomic<int> tasksDone;
+
+	void countTask(void*)
+	{
+		++tasksDone;
+	}
+
+	void testSubmit()
+	{
+		tasksDone = 0;
+		{
+			TaskScheduler scheduler(2);
+			for (int i = 0; i < 1000; ++i)
+				scheduler.submit(countTask, 0);
+		}
+		// the destructor waits for all tasks
+		CHECK(tasksDone == 1000);
+	}
+
+	struct SlowTask
+	{
+		thread::id	caller;
+		atomic<int>	onCaller;
+		atomic<int>	done;
+	};
+
+	void slowTask(void* data)
+	{
+		SlowTask* task = static_cast<SlowTask*>(data);
+		if (this_thread::get_id() == task->caller)
+			++task->onCaller;
+		this_thread::sleep_for(chrono::milliseconds(20));
+		++task->done;
+	}
+
+	void testForeignTasks()
+	{
+		// long background work like mesh cooking must not be picked up by a thread waiting for its parallelFor
+		SlowTask task;
+		task.caller = this_thread::get_id();
+		task.onCaller = 0;
+		task.done = 0;
+		{
+			TaskScheduler scheduler(2);
+			for (int i = 0; i < 16; ++i)
+				scheduler.submit(slowTask, &task);
+			for (int i = 0; i < 200; ++i)
+			{
+				Coverage coverage(&scheduler, 500, 10);
+				coverage.run(500);
+				CHECK(coverage.complete());
+			}
+			CHECK(task.onCaller == 0);
+		}
+		CHECK(task.done == 16);
+	}
+
+	void testNested()
+	{
+		TaskScheduler scheduler(3);
+		Coverage inner(&scheduler, 64 * 100, 16);
+		atomic<int> outerErrors(0);
+		parallelFor(&scheduler, 64, 4, [&](int begin, int end, int threadIndex)
+		{
+			if (threadIndex != scheduler.threadIndex())
+				++outerErrors;
+			for (int i = begin; i < end; ++i)
+			{
+				parallelFor(&scheduler, 100, 16, [&](int innerBegin, int innerEnd, int innerThread)
+				{
+					inner(i * 100 + innerBegin, i * 100 + innerEnd, innerThread);
+				});
+			}
+		});
+		CHECK(outerErrors == 0);
+		// inner ranges are offset, so the grain size check still applies
+		CHECK(inner.complete());
+	}
+
+	void testExternalThreads()
+	{
+		// threads that are not workers share a thread index, their calls must not overlap
+		TaskScheduler scheduler(2);
+		atomic<int> failures(0);
+		vector<thread> threads;
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.push_back(thread([&]()
+			{
+				for (int i = 0; i < 50; ++i)
+				{
+					Coverage coverage(&scheduler, 300, 5);
+					coverage.run(300);
+					if (!coverage.complete())
+						++failures;
+				}
+			}));
+		}
+		for (unsigned int t = 0; t < threads.size(); ++t)
+			threads[t].join();
+		CHECK(failures == 0);
+	}
+}
+
+int main()
+{
+	testRanges();
+	testSerialFallback();
+	testSubmit();
+	testForeignTasks();
+	testNested();
+	testExternalThreads();
+	return Testing::result("taskSchedulerTest");
+}
@@ -0,0 +1,64 @@
+// *************************************************************************************************
+//
+// Bullet Physics Integration into Horde3D
+// --------------------------------------
+// Copyright (C) 2007 Volker Wiendl
+//
+// Updated to Horde3D v1.0 beta4 by Afanasyev Alexei and Giatsintov Alexander
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+/**
+ * \brief Minimal checks for the library tests
+ *
+ * A failed CHECK reports the expression and continues, so a test reports all of its failures at once.
+ * Each test program returns Testing::result() from main, which is non zero if any check failed.
+ */
+namespace Testing
+{
+	inline int& failures()
+	{
+		static int count = 0;
+		return count;
+	}
+
+	inline bool close(double a, double b, double tolerance)
+	{
+		return std::fabs(a - b) <= tolerance;
+	}
+
+	inline int result(const char* name)
+	{
+		if (failures() == 0)
+			printf("%s: all checks passed\n", name);
+		else
+			printf("%s: %d checks failed\n", name, failures());
+		return failures() == 0 ? 0 : 1;
+	}
+}
+
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++Testing::failures(); } } while (0)
+
+#define CHECK_CLOSE(a, b, tolerance) \
+	CHECK(Testing::close((a), (b), (tolerance)))